@@ -0,0 +1,356 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate a 1-many association which scales: a University with a growable, indexed student body.
+// In Chp10-Ex2.cpp, a University holds at most MAX (25) Student *'s in a fixed array; EnrollStudent() writes past
+// its end when a 26th Student enrolls, and finding a Student means walking the array. Here, the student body is a
+// vector (which grows as needed), with two secondary indexes: by student id (unique -- a duplicate enrollment throws)
+// and by last name. The indexes' keys are string_views of the Student's own id and last name, so that they hold no
+// copies of the strings. EnrollStudents() enrolls a batch, sizing each container once (O(n), expected).
+// A Student withdraws from its University when it is destroyed, and a University's destructor clears the back links
+// of those still enrolled, so that neither is left with a dangling pointer to the other.
+// Compile with: g++ -std=c++17 -O2 Chp10-Ex3.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <string_view>
+#include <stdexcept>
+#include <chrono>
+#include <cstdlib>
+
+using std::cout;
+using std::endl;
+using std::setprecision;
+using std::string;
+using std::string_view;
+using std::to_string;
+using std::vector;
+using std::deque;
+using std::unordered_map;
+using std::unordered_multimap;
+
+class Student; // forward declaration
+
+class University
+{
+private:
+   string name;
+   // Association to many students
+   vector<Student *> studentBody;
+   unordered_map<string_view, size_t> byId;   // student id -> position in studentBody
+   unordered_multimap<string_view, Student *> byLastName;
+   void Unlink(Student *);
+public:
+   University() = default;
+   University(const string &n) : name(n) { }
+   University(const University &) = delete;  // prohibit copies
+   University &operator=(const University &) = delete;
+   ~University();
+   void EnrollStudent(Student *);
+   void EnrollStudents(const vector<Student *> &);
+   void WithdrawStudent(Student *);
+   Student *FindStudent(string_view id) const;   // nullptr if no Student with this id is enrolled
+   vector<Student *> FindStudentsByLastName(string_view) const;
+   const string &GetName() const { return name; }
+   size_t GetNumStudents() const { return studentBody.size(); }
+   void PrintStudents() const;
+};
+
+
+class Id final
+{
+private:
+   string idNumber;
+public:
+   Id() = default;
+   Id(const string &id) : idNumber(id) { }
+   const string &GetId() const { return idNumber; }
+};
+
+
+class Person
+{
+private:
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+protected:
+    void ModifyTitle(const string &);
+public:
+    Person() = default;   // default constructor
+    Person(const string &, const string &, char, const string &);
+    virtual ~Person() = default;  // virtual destructor
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+    virtual void Print() const;
+};
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) :
+               firstName(fn), lastName(ln), middleInitial(mi), title(t)
+{
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+    title = newTitle;
+}
+
+void Person::Print() const
+{
+    cout << title << " " << firstName << " ";
+    cout << middleInitial << ". " << lastName << endl;
+}
+
+
+class Student : public Person  // whole
+{
+private:
+    float gpa = 0.0;    // in-class initialization
+    string currentCourse;
+    static int numStudents;
+    Id studentId;  // part
+    University *univ = nullptr;  // Association to University object, set with in-class initialization
+    friend class University;     // which sets and clears univ as the Student enrolls and withdraws
+public:
+    Student() = delete;   // every Student needs a unique id
+    // univ may be nullptr, for a Student to be enrolled later (e.g., with University::EnrollStudents())
+    Student(const string &, const string &, char, const string &, float, const string &, const string &, University * = nullptr);
+    Student(const Student &) = delete;  // a copy would duplicate the original's (unique) id
+    Student &operator=(const Student &) = delete;
+    ~Student() override;  // destructor
+    void EarnPhD() { ModifyTitle("Dr."); }
+    float GetGpa() const { return gpa; }
+    const string &GetCurrentCourse() const { return currentCourse; }
+    void Print() const override;
+    static int GetNumberStudents() { return numStudents; }
+    const string &GetStudentId() const { return studentId.GetId(); }
+    const string &GetUniversity() const { return univ->GetName(); }
+    bool IsEnrolled() const { return univ != nullptr; }
+};
+
+int Student::numStudents = 0;  // definition of static data member
+
+Student::Student(const string &fn, const string &ln, char mi, const string &t, float avg, const string &course,
+                 const string &id, University *u) : Person(fn, ln, mi, t), gpa(avg), currentCourse(course), studentId(id)
+{
+    if (u != nullptr)
+        u->EnrollStudent(this);  // sets our forward link, and creates the back link (throws if id is already enrolled)
+    numStudents++;
+}
+
+Student::~Student()
+{
+    numStudents--;
+    if (univ != nullptr)
+        univ->WithdrawStudent(this);  // a Student does not delete its University, but must leave it
+}
+
+void Student::Print() const
+{
+    cout << GetTitle() << " " << GetFirstName() << " ";
+    cout << GetMiddleInitial() << ". " << GetLastName();
+    cout << " with id: " << studentId.GetId() << " GPA: ";
+    cout << setprecision(3) <<  " " << gpa;
+    cout << " Course: " << currentCourse << endl;
+}
+
+
+University::~University()
+{
+   // The students will be deleted by whatever means they were created; we clear their links to us
+   for (Student *s : studentBody)
+      s->univ = nullptr;
+}
+
+void University::EnrollStudent(Student *s)
+{
+   if (s->univ != nullptr)
+      throw std::invalid_argument(s->GetStudentId() + " is already enrolled at " + s->univ->GetName());
+   if (!byId.emplace(s->GetStudentId(), studentBody.size()).second)
+      throw std::invalid_argument(s->GetStudentId() + " is already enrolled at " + name);
+   studentBody.push_back(s);
+   byLastName.emplace(s->GetLastName(), s);
+   s->univ = this;
+}
+
+// All or nothing: if any Student in the batch is already enrolled (or appears twice), none of the batch is enrolled
+void University::EnrollStudents(const vector<Student *> &batch)
+{
+   size_t first = studentBody.size();
+   byId.reserve(first + batch.size());
+   byLastName.reserve(first + batch.size());
+   studentBody.reserve(first + batch.size());
+   for (size_t i = 0; i < batch.size(); i++)
+   {
+      if (batch[i]->univ != nullptr || !byId.emplace(batch[i]->GetStudentId(), first + i).second)
+      {
+         for (size_t j = 0; j < i; j++)   // undo this batch's insertions
+            byId.erase(batch[j]->GetStudentId());
+         throw std::invalid_argument(batch[i]->GetStudentId() + " is already enrolled");
+      }
+   }
+   for (Student *s : batch)
+   {
+      studentBody.push_back(s);
+      byLastName.emplace(s->GetLastName(), s);
+      s->univ = this;
+   }
+}
+
+void University::WithdrawStudent(Student *s)
+{
+   if (s->univ != this)
+      throw std::invalid_argument(s->GetStudentId() + " is not enrolled at " + name);
+   Unlink(s);
+   s->univ = nullptr;
+}
+
+// Remove s from the student body (moving the last Student into its place) and from both indexes: O(1), expected,
+// plus the number of enrolled Students who share s's last name
+void University::Unlink(Student *s)
+{
+   auto id = byId.find(s->GetStudentId());
+   size_t position = id->second;
+   byId.erase(id);
+   if (position != studentBody.size() - 1)
+   {
+      studentBody[position] = studentBody.back();
+      byId[studentBody[position]->GetStudentId()] = position;
+   }
+   studentBody.pop_back();
+   auto range = byLastName.equal_range(s->GetLastName());
+   for (auto iter = range.first; iter != range.second; ++iter)
+      if (iter->second == s)
+      {
+         byLastName.erase(iter);
+         break;
+      }
+}
+
+Student *University::FindStudent(string_view id) const
+{
+   auto iter = byId.find(id);
+   return iter == byId.end() ? nullptr : studentBody[iter->second];
+}
+
+vector<Student *> University::FindStudentsByLastName(string_view lastName) const
+{
+   vector<Student *> found;
+   auto range = byLastName.equal_range(lastName);
+   for (auto iter = range.first; iter != range.second; ++iter)
+      found.push_back(iter->second);
+   return found;
+}
+
+void University::PrintStudents() const
+{
+   cout << name << " has the following students:" << endl;
+   for (const Student *s : studentBody)
+      cout << "\t" << s->GetFirstName() << " " << s->GetLastName() << endl;
+}
+
+
+// Benchmark: enroll numStudents Students one at a time, then (at another University) as one batch; then look them up
+// by id and by last name. About four Students share each last name.
+void Benchmark(int numStudents)
+{
+   using Clock = std::chrono::steady_clock;
+   auto nsEach = [](Clock::time_point start, long n) {
+      return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / n;
+   };
+   vector<string> ids, lastNames;
+   ids.reserve(numStudents);
+   lastNames.reserve(numStudents);
+   for (int i = 0; i < numStudents; i++)
+   {
+      ids.push_back(to_string(i) + "GWU");
+      lastNames.push_back("Doone" + to_string(i % (numStudents / 4 + 1)));
+   }
+
+   double oneAtATime = 0, batch = 0, byId = 0, byLastName = 0;
+   size_t checksum = 0;
+   {
+      University u("The George Washington University");
+      deque<Student> students;   // a deque never moves its elements (Students cannot be copied or moved)
+      auto start = Clock::now();
+      for (int i = 0; i < numStudents; i++)
+         students.emplace_back("Gabby", lastNames[i], 'A', "Miss", 3.85, "C++", ids[i], &u);
+      oneAtATime = nsEach(start, numStudents);
+   }   // u is destroyed first, clearing the Students' links; then the Students are destroyed
+   {
+      University u("The George Washington University");
+      deque<Student> students;
+      for (int i = 0; i < numStudents; i++)
+         students.emplace_back("Gabby", lastNames[i], 'A', "Miss", 3.85, "C++", ids[i]);
+      vector<Student *> pointers;
+      pointers.reserve(numStudents);
+      for (Student &s : students)
+         pointers.push_back(&s);
+      auto start = Clock::now();
+      u.EnrollStudents(pointers);
+      batch = nsEach(start, numStudents);
+
+      const long lookups = 1000000;
+      unsigned long x = 88172645463325252ul;
+      start = Clock::now();
+      for (long i = 0; i < lookups; i++)
+      {
+         x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+         checksum += u.FindStudent(ids[x % numStudents])->GetMiddleInitial();
+      }
+      byId = nsEach(start, lookups);
+      start = Clock::now();
+      for (long i = 0; i < lookups; i++)
+      {
+         x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+         checksum += u.FindStudentsByLastName(lastNames[x % numStudents]).size();
+      }
+      byLastName = nsEach(start, lookups);
+   }   // here, the Students are destroyed first, each withdrawing from u
+   cout << std::fixed << setprecision(0);
+   cout << "  " << std::setw(9) << numStudents << std::setw(12) << oneAtATime << std::setw(12) << batch
+        << std::setw(12) << byId << std::setw(15) << byLastName << "    (checksum " << checksum << ")" << endl;
+   cout.unsetf(std::ios::fixed);
+   cout << setprecision(6);
+}
+
+
+int main(int argc, char *argv[])
+{
+    University u1("The George Washington University");
+    Student s1("Gabby", "Doone", 'A', "Miss", 3.85, "C++", "4225GWU", &u1);
+    Student s2("Giselle", "LeBrun", 'A', "Ms.", 3.45, "C++", "1227GWU", &u1);
+    Student s3("Eve", "Kendall", 'B', "Ms.", 3.71, "C++", "5542GWU", &u1);
+
+    cout << s1.GetFirstName() << " " << s1.GetLastName() << " attends ";
+    cout << s1.GetUniversity() << endl;
+
+    u1.PrintStudents();
+    cout << "Student 1227GWU is ";
+    u1.FindStudent("1227GWU")->Print();
+
+    try
+    {
+        Student s4("Gabby", "Doone", 'A', "Miss", 3.85, "C++", "4225GWU", &u1);   // a duplicate id
+    }
+    catch (const std::invalid_argument &e)
+    {
+        cout << "Could not enroll: " << e.what() << endl;
+    }
+    {
+        Student s5("Hana", "Sato", 'U', "Miss", 3.8, "C++", "178GWU", &u1);
+        cout << "Number of students: " << u1.GetNumStudents() << endl;
+    }   // s5 withdraws as it is destroyed
+    cout << "Number of students: " << u1.GetNumStudents() << endl;
+
+    int largest = argc > 1 ? std::atoi(argv[1]) : 1000000;   // 10000000 needs several GB of memory
+    cout << endl << "Benchmark (ns per Student enrolled, or per lookup):" << endl;
+    cout << "   students  one-by-one       batch       by id   by last name" << endl;
+    for (int numStudents = 10000; numStudents <= largest; numStudents *= 10)
+        Benchmark(numStudents);
+    return 0;
+}
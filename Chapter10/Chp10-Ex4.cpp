@@ -0,0 +1,415 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate a 1-many association kept by a separate manager, in index tables, with checked handles.
+// In Chp10-Ex2.cpp, a University holds raw Student *'s and each Student holds a University *. A Student cannot
+// withdraw, and when either is destroyed the other is left holding a dangling pointer (~University only nulls out
+// its own array). Here, a Registrar owns the Universities and Students, and keeps the association itself, in both
+// directions: for each Student, its University and its position in that University's list; for each University,
+// a dense array of its Students. Enroll, withdraw (swap the last Student into the vacated position), and the
+// traversal of a University's Students are all O(1) per Student. Universities and Students are referred to by
+// handles -- an index and a generation. Removing an object bumps its slot's generation, so a stale handle is
+// detected with one comparison (and the slot may be reused by a new object without confusing the two).
+// Compile with: g++ -std=c++17 -O2 Chp10-Ex4.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <optional>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+
+using std::cout;
+using std::endl;
+using std::setprecision;
+using std::string;
+using std::to_string;
+using std::vector;
+using std::optional;
+
+class University
+{
+private:
+   string name;
+public:
+   University(const string &n) : name(n) { }
+   const string &GetName() const { return name; }
+};
+
+class Person
+{
+private:
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+protected:
+    void ModifyTitle(const string &newTitle) { title = newTitle; }
+public:
+    Person() = default;   // default constructor
+    Person(const string &fn, const string &ln, char mi, const string &t) :
+           firstName(fn), lastName(ln), middleInitial(mi), title(t) { }
+    virtual ~Person() = default;  // virtual destructor
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+};
+
+// A Student no longer holds a University *: the Registrar knows which University each Student attends
+class Student : public Person
+{
+private:
+    float gpa = 0.0;    // in-class initialization
+    string currentCourse;
+    string studentId;
+public:
+    Student(const string &fn, const string &ln, char mi, const string &t, float avg, const string &course,
+            const string &id) : Person(fn, ln, mi, t), gpa(avg), currentCourse(course), studentId(id) { }
+    void EarnPhD() { ModifyTitle("Dr."); }
+    float GetGpa() const { return gpa; }
+    const string &GetCurrentCourse() const { return currentCourse; }
+    const string &GetStudentId() const { return studentId; }
+};
+
+
+// A handle to a T in a SlotMap<T>. A default-constructed Handle refers to nothing.
+template <class T>
+struct Handle
+{
+    static constexpr uint32_t NONE = UINT32_MAX;
+    uint32_t index = NONE;
+    uint32_t generation = 0;
+};
+
+// Objects in a vector of slots, each slot with a generation; erased slots are reused. Pointers returned by Find()
+// remain valid until the next Emplace() (which may grow the vector); handles remain valid until their object is erased.
+template <class T>
+class SlotMap
+{
+private:
+    struct Slot
+    {
+        optional<T> value;
+        uint32_t generation = 0;
+    };
+    vector<Slot> slots;
+    vector<uint32_t> freeSlots;
+public:
+    template <class... Args>
+    Handle<T> Emplace(Args &&...args)
+    {
+        uint32_t index = 0;
+        if (freeSlots.empty())
+        {
+            index = uint32_t(slots.size());
+            slots.emplace_back();
+        }
+        else
+        {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        slots[index].value.emplace(std::forward<Args>(args)...);
+        return Handle<T>{ index, slots[index].generation };
+    }
+    bool IsValid(Handle<T> h) const
+    {
+        return h.index < slots.size() && slots[h.index].generation == h.generation && slots[h.index].value;
+    }
+    T *Find(Handle<T> h) { return IsValid(h) ? &*slots[h.index].value : nullptr; }
+    const T *Find(Handle<T> h) const { return IsValid(h) ? &*slots[h.index].value : nullptr; }
+    T &operator[](uint32_t index) { return *slots[index].value; }   // for the Registrar's own (already checked) indices
+    void Erase(Handle<T> h)
+    {
+        slots[h.index].value.reset();
+        slots[h.index].generation++;   // every existing handle to this slot is now stale
+        freeSlots.push_back(h.index);
+    }
+    uint32_t Capacity() const { return uint32_t(slots.size()); }
+};
+
+using StudentHandle = Handle<Student>;
+using UniversityHandle = Handle<University>;
+
+
+class Registrar
+{
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    struct Enrollment   // per Student slot
+    {
+        uint32_t university = NONE;   // a University slot index, or NONE
+        uint32_t position = 0;        // this Student's position in that University's students
+    };
+    SlotMap<Student> students;
+    SlotMap<University> universities;
+    vector<Enrollment> enrollment;           // indexed by Student slot
+    vector<vector<uint32_t>> studentBodies;  // indexed by University slot: Student slot indices
+    void CheckStudent(StudentHandle s) const
+    {
+        if (!students.IsValid(s))
+            throw std::invalid_argument("Registrar: stale or invalid StudentHandle");
+    }
+    void CheckUniversity(UniversityHandle u) const
+    {
+        if (!universities.IsValid(u))
+            throw std::invalid_argument("Registrar: stale or invalid UniversityHandle");
+    }
+public:
+    UniversityHandle AddUniversity(const string &name);
+    template <class... Args> StudentHandle AddStudent(Args &&...args);
+    void RemoveStudent(StudentHandle);        // withdraws the Student first, if enrolled
+    void RemoveUniversity(UniversityHandle);  // withdraws all its Students
+    void Enroll(StudentHandle, UniversityHandle);
+    void Withdraw(StudentHandle);
+    void Transfer(StudentHandle, UniversityHandle);   // a failed Transfer() changes nothing
+    Student *Find(StudentHandle s) { return students.Find(s); }   // nullptr for a stale handle
+    University *Find(UniversityHandle u) { return universities.Find(u); }
+    University *GetUniversity(StudentHandle);   // nullptr if the Student is not enrolled
+    size_t GetNumStudents(UniversityHandle u) const { CheckUniversity(u); return studentBodies[u.index].size(); }
+    template <class Function> void ForEachStudent(UniversityHandle, Function);
+    void PrintStudents(UniversityHandle);
+};
+
+UniversityHandle Registrar::AddUniversity(const string &name)
+{
+    UniversityHandle u = universities.Emplace(name);
+    if (studentBodies.size() < universities.Capacity())
+        studentBodies.resize(universities.Capacity());
+    return u;
+}
+
+template <class... Args>
+StudentHandle Registrar::AddStudent(Args &&...args)
+{
+    StudentHandle s = students.Emplace(std::forward<Args>(args)...);
+    if (enrollment.size() < students.Capacity())
+        enrollment.resize(students.Capacity());
+    return s;
+}
+
+void Registrar::RemoveStudent(StudentHandle s)
+{
+    CheckStudent(s);
+    if (enrollment[s.index].university != NONE)
+        Withdraw(s);
+    students.Erase(s);
+}
+
+void Registrar::RemoveUniversity(UniversityHandle u)
+{
+    CheckUniversity(u);
+    for (uint32_t student : studentBodies[u.index])
+        enrollment[student].university = NONE;
+    studentBodies[u.index].clear();
+    universities.Erase(u);
+}
+
+void Registrar::Enroll(StudentHandle s, UniversityHandle u)
+{
+    CheckStudent(s);
+    CheckUniversity(u);
+    Enrollment &e = enrollment[s.index];
+    if (e.university != NONE)
+        throw std::invalid_argument(students[s.index].GetStudentId() + " is already enrolled at " +
+                                    universities[e.university].GetName());
+    vector<uint32_t> &body = studentBodies[u.index];
+    e.university = u.index;
+    e.position = uint32_t(body.size());
+    body.push_back(s.index);
+}
+
+void Registrar::Withdraw(StudentHandle s)
+{
+    CheckStudent(s);
+    Enrollment &e = enrollment[s.index];
+    if (e.university == NONE)
+        throw std::invalid_argument(students[s.index].GetStudentId() + " is not enrolled");
+    vector<uint32_t> &body = studentBodies[e.university];
+    uint32_t last = body.back();
+    body[e.position] = last;   // move the last Student into the vacated position (a no-op if s was last)
+    enrollment[last].position = e.position;
+    body.pop_back();
+    e.university = NONE;
+}
+
+void Registrar::Transfer(StudentHandle s, UniversityHandle u)
+{
+    CheckStudent(s);      // validate both handles before Withdraw(), so that a bad University can not leave
+    CheckUniversity(u);   // the Student enrolled nowhere
+    Withdraw(s);
+    Enroll(s, u);
+}
+
+University *Registrar::GetUniversity(StudentHandle s)
+{
+    CheckStudent(s);
+    uint32_t u = enrollment[s.index].university;
+    return u == NONE ? nullptr : &universities[u];
+}
+
+template <class Function>
+void Registrar::ForEachStudent(UniversityHandle u, Function f)
+{
+    CheckUniversity(u);
+    for (uint32_t student : studentBodies[u.index])
+        f(students[student]);
+}
+
+void Registrar::PrintStudents(UniversityHandle u)
+{
+    cout << Find(u)->GetName() << " has the following students:" << endl;
+    ForEachStudent(u, [](const Student &s) { cout << "\t" << s.GetFirstName() << " " << s.GetLastName() << endl; });
+}
+
+
+// For comparison: Chp10-Ex2.cpp's pointers both ways, with a vector in place of the fixed array. Withdrawing must
+// search the University's vector for the Student.
+struct PointerUniversity;
+struct PointerStudent
+{
+    Student student;
+    PointerUniversity *univ = nullptr;
+};
+struct PointerUniversity
+{
+    vector<PointerStudent *> studentBody;
+    void Enroll(PointerStudent *s) { studentBody.push_back(s); s->univ = this; }
+    void Withdraw(PointerStudent *s)
+    {
+        auto iter = std::find(studentBody.begin(), studentBody.end(), s);
+        *iter = studentBody.back();
+        studentBody.pop_back();
+        s->univ = nullptr;
+    }
+};
+
+
+// Benchmark: enroll numStudents Students across numUniversities Universities; then churn -- each operation transfers
+// a random Student to a random University, and every tenth replaces a Student with a new one (reusing the slot, so
+// that the old handle goes stale) -- then traverse every University's Students
+void Benchmark(int numStudents, int numUniversities, long churn)
+{
+    using Clock = std::chrono::steady_clock;
+    auto nsEach = [](Clock::time_point start, long n) {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / n;
+    };
+    unsigned long x = 88172645463325252ul;
+    auto random = [&x](unsigned long n) { x ^= x << 13; x ^= x >> 7; x ^= x << 17; return x % n; };
+    double sum = 0;
+
+    Registrar registrar;
+    vector<UniversityHandle> universities;
+    vector<StudentHandle> studentHandles;
+    for (int i = 0; i < numUniversities; i++)
+        universities.push_back(registrar.AddUniversity("University " + to_string(i)));
+    for (int i = 0; i < numStudents; i++)
+    {
+        studentHandles.push_back(registrar.AddStudent("Gabby", "Doone", 'A', "Miss", 3.85f, "C++", to_string(i) + "GWU"));
+        registrar.Enroll(studentHandles.back(), universities[i % numUniversities]);
+    }
+    long staleDetected = 0;
+    auto start = Clock::now();
+    for (long i = 0; i < churn; i++)
+    {
+        size_t which = random(numStudents);
+        if (i % 10 == 9)
+        {
+            StudentHandle old = studentHandles[which];
+            registrar.RemoveStudent(old);
+            studentHandles[which] = registrar.AddStudent("Gabby", "Doone", 'A', "Miss", 3.85f, "C++", to_string(i) + "New");
+            registrar.Enroll(studentHandles[which], universities[random(numUniversities)]);
+            staleDetected += registrar.Find(old) == nullptr;   // the slot is reused, but the old handle is refused
+        }
+        else
+            registrar.Transfer(studentHandles[which], universities[random(numUniversities)]);
+    }
+    double registrarChurn = nsEach(start, churn);
+    start = Clock::now();
+    for (UniversityHandle u : universities)
+        registrar.ForEachStudent(u, [&sum](const Student &s) { sum += s.GetGpa(); });
+    double registrarTraverse = nsEach(start, numStudents);
+
+    vector<PointerUniversity> pointerUniversities(numUniversities);
+    vector<PointerStudent> pointerStudents;
+    pointerStudents.reserve(numStudents);
+    for (int i = 0; i < numStudents; i++)
+    {
+        pointerStudents.push_back({ Student("Gabby", "Doone", 'A', "Miss", 3.85f, "C++", to_string(i) + "GWU") });
+        pointerUniversities[i % numUniversities].Enroll(&pointerStudents.back());
+    }
+    start = Clock::now();
+    for (long i = 0; i < churn; i++)
+    {
+        PointerStudent *s = &pointerStudents[random(numStudents)];
+        s->univ->Withdraw(s);
+        pointerUniversities[random(numUniversities)].Enroll(s);
+    }
+    double pointerChurn = nsEach(start, churn);
+    start = Clock::now();
+    for (auto &u : pointerUniversities)
+        for (PointerStudent *s : u.studentBody)
+            sum += s->student.GetGpa();
+    double pointerTraverse = nsEach(start, numStudents);
+
+    cout << std::fixed << setprecision(1);
+    cout << "  Churn:     Registrar " << std::setw(8) << registrarChurn << " ns/op;  pointers both ways "
+         << std::setw(8) << pointerChurn << " ns/op (transfers only; search to withdraw)" << endl;
+    cout << "  Traverse:  Registrar " << std::setw(8) << registrarTraverse << " ns/Student; pointers both ways "
+         << std::setw(8) << pointerTraverse << " ns/Student" << endl;
+    cout.unsetf(std::ios::fixed);
+    cout << setprecision(6) << "  Stale handles detected: " << staleDetected << " of " << churn / 10
+         << " (checksum " << sum << ")" << endl;
+}
+
+
+int main(int argc, char *argv[])
+{
+    Registrar registrar;
+    UniversityHandle u1 = registrar.AddUniversity("The George Washington University");
+    UniversityHandle u2 = registrar.AddUniversity("Temple University");
+    StudentHandle s1 = registrar.AddStudent("Gabby", "Doone", 'A', "Miss", 3.85f, "C++", "4225GWU");
+    StudentHandle s2 = registrar.AddStudent("Giselle", "LeBrun", 'A', "Ms.", 3.45f, "C++", "1227GWU");
+    StudentHandle s3 = registrar.AddStudent("Eve", "Kendall", 'B', "Ms.", 3.71f, "C++", "5542GWU");
+    registrar.Enroll(s1, u1);
+    registrar.Enroll(s2, u1);
+    registrar.Enroll(s3, u1);
+
+    cout << registrar.Find(s1)->GetFirstName() << " " << registrar.Find(s1)->GetLastName() << " attends ";
+    cout << registrar.GetUniversity(s1)->GetName() << endl;
+    registrar.PrintStudents(u1);
+
+    registrar.Transfer(s2, u2);   // un-enrolling is supported
+    registrar.PrintStudents(u1);
+    registrar.PrintStudents(u2);
+
+    registrar.RemoveUniversity(u2);   // s2 is no longer enrolled anywhere; no one holds a dangling pointer
+    cout << registrar.Find(s2)->GetFirstName() << " is " << (registrar.GetUniversity(s2) ? "" : "not ") << "enrolled" << endl;
+    try
+    {
+        registrar.Enroll(s2, u2);   // u2 is a stale handle
+    }
+    catch (const std::invalid_argument &e)
+    {
+        cout << e.what() << endl;
+    }
+    try
+    {
+        registrar.Transfer(s3, u2);   // fails, and leaves s3 where it was
+    }
+    catch (const std::invalid_argument &e)
+    {
+        cout << e.what() << "; " << registrar.Find(s3)->GetFirstName() << " still attends "
+             << registrar.GetUniversity(s3)->GetName() << endl;
+    }
+
+    int numStudents = argc > 1 ? std::atoi(argv[1]) : 200000;
+    int numUniversities = argc > 2 ? std::atoi(argv[2]) : 100;
+    long churn = argc > 3 ? std::atol(argv[3]) : 1000000;
+    cout << endl << "Benchmark: " << numStudents << " Students, " << numUniversities << " Universities, "
+         << churn << " churn operations" << endl;
+    Benchmark(numStudents, numUniversities, churn);
+    return 0;
+}
@@ -0,0 +1,228 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate reporting an expected failure as a value, with the throwing interface as a thin wrapper.
+// In Chp11-Ex1.cpp through Chp11-Ex6.cpp, Student::Validate() reports a Student who does not meet the standards
+// by throwing (a string, or a StudentException carrying an error code and details). That is the right tool for a
+// failure the caller cannot handle locally -- but when validating a batch of records, failing records are routine,
+// and unwinding the stack for each costs far more than the validation. Here, TryValidate() returns an
+// Expected<void, StudentError>: either success, or the same errCode and details a StudentException would carry.
+// Validate() keeps the throwing interface: it calls TryValidate() and throws a StudentException on failure.
+// Compile with: g++ -std=c++17 -O2 Chp11-Ex7.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <variant>
+#include <optional>
+#include <utility>
+#include <chrono>
+#include <cstdlib>
+
+using std::cout;    // preferred to: using namespace std;
+using std::endl;
+using std::setprecision;
+using std::string;
+using std::to_string;
+using std::vector;
+using std::exception;
+
+// What a StudentException carries, as a plain value
+struct StudentError
+{
+    int errCode = 0;
+    string details;
+};
+
+class StudentException: public exception
+{
+private:
+    int errCode = 0;  // in-class initialization (will be over written with bonified value after successful alt constructor)
+    string details;
+public:
+    StudentException(const string &det, int num): errCode(num), details(det) { }
+    explicit StudentException(const StudentError &err): errCode(err.errCode), details(err.details) { }
+    const char *what() const noexcept override
+    {
+        return "Student Exception";
+    }
+    int GetCode() const { return errCode; }
+    const string &GetDetails() const { return details; }
+};
+
+
+// Either a T, or an error E (in the manner of C++23's std::expected). Expected<void, E> is either success, or an E.
+template <class T, class E>
+class Expected
+{
+private:
+    std::variant<T, E> contents;
+public:
+    Expected(const T &value) : contents(std::in_place_index<0>, value) { }
+    Expected(T &&value) : contents(std::in_place_index<0>, std::move(value)) { }
+    static Expected Failure(E error) { return Expected(std::in_place_index<1>, std::move(error)); }
+    bool HasValue() const noexcept { return contents.index() == 0; }
+    explicit operator bool() const noexcept { return HasValue(); }
+    const T &Value() const { return std::get<0>(contents); }   // throws bad_variant_access if this holds an error
+    const E &Error() const { return std::get<1>(contents); }
+private:
+    template <class... Args>
+    Expected(std::in_place_index_t<1> tag, Args &&...args) : contents(tag, std::forward<Args>(args)...) { }
+};
+
+template <class E>
+class Expected<void, E>
+{
+private:
+    std::optional<E> error;   // empty on success
+public:
+    Expected() = default;
+    static Expected Failure(E err) { Expected e; e.error.emplace(std::move(err)); return e; }
+    bool HasValue() const noexcept { return !error.has_value(); }
+    explicit operator bool() const noexcept { return HasValue(); }
+    const E &Error() const { return *error; }   // only when !HasValue()
+};
+
+
+class Person
+{
+private:
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+protected:
+    void ModifyTitle(const string &newTitle) { title = newTitle; }
+public:
+    Person() = default;   // default constructor
+    Person(const string &fn, const string &ln, char mi, const string &t) :
+           firstName(fn), lastName(ln), middleInitial(mi), title(t) { }
+    virtual ~Person() = default;  // virtual destructor
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+};
+
+class Student : public Person
+{
+private:
+    float gpa = 0.0;
+    string currentCourse;
+    string studentId;
+public:
+    // Error codes reported by TryValidate() (and so by Validate()'s StudentException)
+    enum { MISSING_ID = 1, GPA_OUT_OF_RANGE = 2, GPA_TOO_LOW = 3, MISSING_COURSE = 4 };
+    static constexpr float MIN_GPA = 2.0;
+    Student() = default;
+    Student(const string &fn, const string &ln, char mi, const string &t, float avg, const string &course,
+            const string &id) : Person(fn, ln, mi, t), gpa(avg), currentCourse(course), studentId(id) { }
+    float GetGpa() const { return gpa; }
+    const string &GetCurrentCourse() const { return currentCourse; }
+    const string &GetStudentId() const { return studentId; }
+    // check Student instance to see if standards are met; derived classes may add their own checks
+    virtual Expected<void, StudentError> TryValidate() const;
+    void Validate() const;   // the throwing interface: throws StudentException if TryValidate() fails
+};
+
+Expected<void, StudentError> Student::TryValidate() const
+{
+    using Result = Expected<void, StudentError>;
+    if (studentId.empty())
+        return Result::Failure({ MISSING_ID, "Missing student id" });
+    if (gpa < 0.0 || gpa > 4.0)
+        return Result::Failure({ GPA_OUT_OF_RANGE, "GPA out of range" });
+    if (gpa < MIN_GPA)
+        return Result::Failure({ GPA_TOO_LOW, "Student does not meet prerequisites" });
+    if (currentCourse.empty())
+        return Result::Failure({ MISSING_COURSE, "No current course" });
+    return Result();
+}
+
+void Student::Validate() const
+{
+    Expected<void, StudentError> result = TryValidate();
+    if (!result)
+        throw StudentException(result.Error());
+}
+
+
+// Benchmark: validate a batch of Students, failurePercent of whom have too low a GPA, through each interface
+void Benchmark(int batchSize, int rounds)
+{
+    using Clock = std::chrono::steady_clock;
+    cout << "  failing   Validate() (throws)   TryValidate() (returns)" << endl;
+    for (int failurePercent : { 0, 1, 5, 10, 25, 50 })
+    {
+        vector<Student> batch;
+        batch.reserve(batchSize);
+        for (int i = 0; i < batchSize; i++)
+        {
+            bool fails = (i * 7919L) % 100 < failurePercent;   // spread the failures through the batch
+            batch.emplace_back("Gabby", "Doone", 'A', "Miss", fails ? 1.5f : 3.5f, "C++", to_string(i) + "GWU");
+        }
+
+        long thrownCodes = 0, returnedCodes = 0;
+        auto start = Clock::now();
+        for (int r = 0; r < rounds; r++)
+            for (const Student &s : batch)
+            {
+                try
+                {
+                    s.Validate();
+                }
+                catch (const StudentException &e)
+                {
+                    thrownCodes += e.GetCode();
+                }
+            }
+        double throwingNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (double(rounds) * batchSize);
+
+        start = Clock::now();
+        for (int r = 0; r < rounds; r++)
+            for (const Student &s : batch)
+            {
+                auto result = s.TryValidate();
+                if (!result)
+                    returnedCodes += result.Error().errCode;
+            }
+        double returningNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (double(rounds) * batchSize);
+
+        cout << std::fixed << setprecision(1);
+        cout << "  " << std::setw(6) << failurePercent << "%" << std::setw(15) << throwingNs << " ns/record"
+             << std::setw(17) << returningNs << " ns/record" << (thrownCodes == returnedCodes ? "" : "  (mismatch!)") << endl;
+        cout.unsetf(std::ios::fixed);
+        cout << setprecision(6);
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    Student s1("Alexandra", "Doone", 'G', "Miss", 3.95, "C++", "231GWU");
+    Student s2("Giselle", "LeBrun", 'R', "Ms.", 1.85, "C++", "299TU");
+
+    try    // the throwing interface, as before
+    {
+        s2.Validate();
+    }
+    catch (const StudentException &e)  // catch the exception by ref
+    {
+        cout << e.what() << endl;
+        cout << e.GetCode() << " " << e.GetDetails() << endl;
+    }
+
+    for (const Student *s : { &s1, &s2 })   // the same check, with no exception
+    {
+        auto result = s->TryValidate();
+        cout << s->GetFirstName() << ": ";
+        if (result)
+            cout << "valid" << endl;
+        else
+            cout << "error " << result.Error().errCode << " " << result.Error().details << endl;
+    }
+
+    int batchSize = argc > 1 ? std::atoi(argv[1]) : 10000;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 100;
+    cout << endl << "Benchmark: " << rounds << " passes over " << batchSize << " Students" << endl;
+    Benchmark(batchSize, rounds);
+    return 0;
+}
@@ -0,0 +1,584 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate the Observer Pattern with an asynchronous, batched Notify() pipeline.
+// In Chp16-Ex1.cpp, Course::Open() calls Notify(), which runs every Student::Update() on the caller's thread.
+// Here, Subject::Notify() may instead post a state-change event to a NotificationQueue and return immediately.
+// Worker threads in the queue then deliver the Update() calls to the Observers in batches.
+// The ordering guarantee is configurable: Delivery::AsyncOrdered keeps waitlist (FIFO) order per Subject,
+// whereas Delivery::AsyncUnordered spreads the batches of one Subject over all of the workers.
+// Compile with: g++ -std=c++17 -O2 -pthread Chp16-Ex2.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <list>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+using std::cout;   // prefered to: using namespace std;
+using std::endl;
+using std::setprecision;
+using std::string;
+using std::to_string;
+using std::list;
+using std::vector;
+using std::deque;
+using std::thread;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::condition_variable;
+using std::atomic;
+using std::unique_ptr;
+using std::make_unique;
+using std::uint64_t;
+using std::uintptr_t;
+
+constexpr int MAXCOURSES = 5, MAXSTUDENTS = 5;
+
+enum State { Initial = 0, Success = 1, Failure = 2 };
+enum StudentState { AddSuccess = State::Success, AddFailure = State::Failure };
+enum CourseState { OpenForEnrollment = State::Success, NewSpaceAvailable = State::Success, Full = State::Failure };
+
+// How a Subject delivers its Update() calls to its Observers
+enum class Delivery { Synchronous, AsyncOrdered, AsyncUnordered };
+
+class Subject;  // forward declarations
+class Student;
+class NotificationQueue;
+
+class Observer
+{
+private:
+    atomic<int> observerState {State::Initial};   // atomic, as Update() may now run on a worker thread
+protected:
+    Observer() = default;
+    Observer(int s): observerState(s) { }
+    void SetState(int s) { observerState = s; }
+public:
+    int GetState() const { return observerState; }
+    virtual ~Observer() = default;
+    virtual void Update() = 0;
+};
+
+class Subject
+{
+private:
+    list<Observer *> observers;  // List of Observers (in our application, this will be Students on wait-list)
+    int numObservers = 0;
+    atomic<int> subjectState {State::Initial};
+    mutable mutex observerLock;  // guards observers and numObservers; Update() may Release() from a worker thread
+    NotificationQueue *queue = nullptr;   // only used for the asynchronous Delivery modes
+    Delivery delivery = Delivery::Synchronous;
+protected:
+    Subject() = default;
+    Subject(int s): subjectState(s) { }
+    void SetState(int s) { subjectState = s; }
+    NotificationQueue *GetQueue() const { return queue; }
+public:
+    int GetState() const { return subjectState; }
+    int GetNumObservers() const { lock_guard<mutex> lock(observerLock); return numObservers; }
+    Delivery GetDelivery() const { return delivery; }
+    void SetDelivery(Delivery d, NotificationQueue *q = nullptr) { delivery = d; queue = q; }
+    vector<Observer *> Snapshot() const;   // copy of the waitlist, in FIFO order
+    virtual ~Subject()  = default;
+    virtual void Register(Observer *);
+    virtual void Release(Observer *);
+    virtual void Notify();
+};
+
+// NotificationQueue delivers Update() calls on a fixed set of worker threads. Each worker owns its own
+// queue of tasks. A Notify() posts one (cheap) event task; the worker which picks it up takes a snapshot of
+// the waitlist and splits it into batches. For AsyncOrdered, all tasks for a Subject hash to the same worker
+// (a "strand"), which delivers the batches itself, in order. For AsyncUnordered, the batches are re-posted
+// round-robin to all workers, which deliver them concurrently.
+class NotificationQueue
+{
+private:
+    struct Worker
+    {
+        deque<std::function<void()>> tasks;
+        mutex lock;
+        condition_variable ready;
+        thread runner;
+    };
+    vector<unique_ptr<Worker>> workers;
+    size_t batchSize = 0;
+    atomic<size_t> nextWorker {0};  // round-robin index for unordered batches
+    atomic<long> pending {0};       // tasks posted but not yet completed
+    atomic<long> delivered {0};     // total number of Update() calls delivered
+    atomic<long> batches {0};       // total number of batches delivered
+    mutex drainLock;
+    condition_variable drained;
+    atomic<bool> stopping {false};
+
+    void Post(size_t, std::function<void()>);
+    void Run(Worker &);
+    void DeliverBatch(const vector<Observer *> &, size_t, size_t);
+    static size_t StrandFor(const Subject *);
+public:
+    NotificationQueue(int numWorkers, size_t batch);
+    NotificationQueue(const NotificationQueue &) = delete;
+    NotificationQueue &operator=(const NotificationQueue &) = delete;
+    ~NotificationQueue();
+    void Enqueue(Subject *, Delivery);
+    void Drain();    // wait until every posted event has been delivered
+    long GetDelivered() const { return delivered; }
+    long GetBatches() const { return batches; }
+};
+
+NotificationQueue::NotificationQueue(int numWorkers, size_t batch) : batchSize(batch > 0 ? batch : 1)
+{
+    for (int i = 0; i < numWorkers; i++)
+        workers.push_back(make_unique<Worker>());
+    for (auto &w : workers)   // start threads only once the vector is complete
+    {
+        Worker *worker = w.get();
+        worker->runner = thread([this, worker] { Run(*worker); });
+    }
+}
+
+NotificationQueue::~NotificationQueue()
+{
+    Drain();
+    stopping = true;
+    for (auto &w : workers)
+    {
+        {
+            lock_guard<mutex> lock(w->lock);   // so that a worker can not miss the wake-up below
+        }
+        w->ready.notify_one();
+    }
+    for (auto &w : workers)
+        w->runner.join();
+}
+
+void NotificationQueue::Post(size_t index, std::function<void()> task)
+{
+    Worker &w = *workers[index % workers.size()];
+    pending++;
+    {
+        lock_guard<mutex> lock(w.lock);
+        w.tasks.push_back(std::move(task));
+    }
+    w.ready.notify_one();
+}
+
+void NotificationQueue::Run(Worker &w)
+{
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            unique_lock<mutex> lock(w.lock);
+            w.ready.wait(lock, [&w, this] { return stopping || !w.tasks.empty(); });
+            if (w.tasks.empty())   // stopping, and nothing left to do
+                return;
+            task = std::move(w.tasks.front());
+            w.tasks.pop_front();
+        }
+        task();
+        if (--pending == 0)
+        {
+            lock_guard<mutex> lock(drainLock);   // lock so that Drain() can not miss the notification
+            drained.notify_all();
+        }
+    }
+}
+
+void NotificationQueue::DeliverBatch(const vector<Observer *> &waitList, size_t first, size_t last)
+{
+    for (size_t i = first; i < last; i++)
+        waitList[i]->Update();
+    delivered += last - first;
+    batches++;
+}
+
+// std::hash of a pointer may be the address itself, whose low bits are zero for every (aligned) heap object; taken
+// modulo a small number of workers, that would put every Subject on worker 0. So mix the bits first (Fibonacci
+// hashing: multiply by 2^64 / golden ratio and keep the high bits).
+size_t NotificationQueue::StrandFor(const Subject *subject)
+{
+    uint64_t bits = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(subject)) >> 4;
+    return static_cast<size_t>((bits * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+void NotificationQueue::Enqueue(Subject *subject, Delivery mode)
+{
+    Post(StrandFor(subject), [this, subject, mode]
+    {
+        // The snapshot is taken on the worker, so that Notify() itself stays O(1)
+        auto waitList = std::make_shared<const vector<Observer *>>(subject->Snapshot());
+        for (size_t first = 0; first < waitList->size(); first += batchSize)
+        {
+            size_t last = std::min(first + batchSize, waitList->size());
+            if (mode == Delivery::AsyncOrdered)
+                DeliverBatch(*waitList, first, last);    // stay on this Subject's strand -- FIFO order is kept
+            else
+                Post(nextWorker++, [this, waitList, first, last] { DeliverBatch(*waitList, first, last); });
+        }
+    });
+}
+
+void NotificationQueue::Drain()
+{
+    unique_lock<mutex> lock(drainLock);
+    drained.wait(lock, [this] { return pending == 0; });
+}
+
+vector<Observer *> Subject::Snapshot() const
+{
+    lock_guard<mutex> lock(observerLock);
+    return vector<Observer *>(observers.begin(), observers.end());
+}
+
+void Subject::Register(Observer *ob)
+{
+    lock_guard<mutex> lock(observerLock);
+    observers.push_back(ob);
+    numObservers++;
+}
+
+void Subject::Release(Observer *ob)
+{
+    lock_guard<mutex> lock(observerLock);
+    for (auto iter = observers.begin(); iter != observers.end(); ++iter)
+    {
+        if (*iter == ob)    // if we found observer which we seek
+        {
+            observers.erase(iter);
+            numObservers--;
+            break;   // no need to loop after we've found our desired observer
+        }
+    }
+}
+
+void Subject::Notify()
+{
+    if (delivery != Delivery::Synchronous && queue)
+    {
+        queue->Enqueue(this, delivery);   // return right away; the workers will call Update()
+        return;
+    }
+    // Synchronous delivery: iterate over a snapshot, as Update() may Release() the Observer from our list.
+    // This replaces the saved 'newIter' technique used in Chp16-Ex1.cpp
+    for (auto *ob : Snapshot())
+        ob->Update();
+}
+
+
+class Course: public Subject   // over-simplified Course class
+{
+private:
+    string title;
+    int number = 0;
+    Student *students[MAXSTUDENTS] = { };  // List of Students enrolled in Course
+    int totalStudents = 0;
+    mutable mutex enrollLock;   // AddStudent() may be called from several delivery workers at once
+public:
+    Course(const string &title, int num, Delivery d = Delivery::Synchronous, NotificationQueue *q = nullptr) :
+           title(title), number(num)
+    {
+        SetDelivery(d, q);
+    }
+    // Make sure that no queued Update() still refers to this Course before it goes away
+    ~Course() override { if (GetQueue()) GetQueue()->Drain(); }
+    int GetCourseNum() const { return number; }
+    const string &GetTitle() const { return title; }
+    bool AddStudent(Student *);
+    void Open()
+    {
+        SetState(CourseState::OpenForEnrollment);
+        Notify();  // With an asynchronous Delivery, this returns before any Student has been updated
+    }
+    void PrintStudents() const;
+};
+
+bool Course::AddStudent(Student *s)
+{
+    lock_guard<mutex> lock(enrollLock);
+    if (totalStudents < MAXSTUDENTS)  // make sure Course is not full
+    {
+        students[totalStudents++] = s;
+        return true;
+    }
+    else
+        return false;
+}
+
+class Person
+{
+private:
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+protected:
+    void ModifyTitle(const string &);
+public:
+    Person() = default;
+    Person(const string &, const string &, char, const string &);
+    Person(const Person &) = default;
+    virtual ~Person() = default;
+
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+
+    virtual void Print() const;
+    virtual void IsA() const;
+    virtual void Greeting(const string &) const;
+};
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) :
+               firstName(fn), lastName(ln), middleInitial(mi), title(t)
+{
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+    title = newTitle;
+}
+
+void Person::Print() const
+{
+    cout << title << " " << firstName << " ";
+    cout << middleInitial << ". " << lastName << endl;
+}
+
+void Person::IsA() const
+{
+    cout << "Person" << endl;
+}
+
+void Person::Greeting(const string &msg) const
+{
+    cout << msg << endl;
+}
+
+class Student : public Person, public Observer
+{
+private:
+    float gpa = 0.0;
+    const string studentId;
+    int currentNumCourses = 0;
+    Course *courses[MAXCOURSES] = { };
+    Course *waitListedCourse = nullptr;  // our Subject in specialized form
+    mutex updateLock;   // serializes Update() with AddCourse(), which may now be called from a delivery worker
+    static atomic<int> numStudents;
+    static atomic<bool> announce;   // print a message when added from the waitlist (off for the benchmark)
+    bool AddCourseLocked(Course *);
+    bool EnrollLocked(Course *);   // add the Course if it accepts us; never touches the waitlist
+public:
+    Student(const string &, const string &, char, const string &, float, const string &, Course *);
+    Student(const string &, const string &, char, const string &, float, const string &);
+    Student(const Student &) = delete;
+    ~Student() override;
+
+    float GetGpa() const { return gpa; }
+    const string &GetStudentId() const { return studentId; }
+
+    void Print() const override;
+    void IsA() const override;
+    void Update() override;       // overridden from Observer
+    bool AddCourse(Course *);
+    void PrintCourses() const;
+
+    static int GetNumberStudents() { return numStudents; }
+    static void SetAnnounce(bool a) { announce = a; }
+};
+
+atomic<int> Student::numStudents {0};
+atomic<bool> Student::announce {true};
+
+Student::Student(const string &fn, const string &ln, char mi, const string &t, float avg, const string &id, Course *c) :
+                 Person(fn, ln, mi, t), gpa(avg), studentId(id), waitListedCourse(c)
+{
+    c->Register(this); // Add the Student (Observer) to the Subject's list
+    numStudents++;
+}
+
+Student::Student(const string &fn, const string &ln, char mi, const string &t, float avg, const string &id) :
+                 Person(fn, ln, mi, t), gpa(avg), studentId(id)
+{
+    numStudents++;
+}
+
+Student::~Student()
+{
+    numStudents--;
+}
+
+void Student::Print() const
+{
+    cout << GetTitle() << " " << GetFirstName() << " ";
+    cout << GetMiddleInitial() << ". " << GetLastName();
+    cout << " with id: " << studentId << " GPA: ";
+    cout << setprecision(3) <<  " " << gpa;
+}
+
+void Student::IsA() const
+{
+    cout << "Student" << endl;
+}
+
+bool Student::AddCourse(Course *c)
+{
+    lock_guard<mutex> lock(updateLock);
+    return AddCourseLocked(c);
+}
+
+bool Student::EnrollLocked(Course *c)
+{
+    if (currentNumCourses < MAXCOURSES && c->AddStudent(this))
+    {
+        courses[currentNumCourses++] = c;
+        return true;
+    }
+    return false;
+}
+
+// Unlike Chp16-Ex1.cpp, we check whether the Course itself accepted the Student; if not, wait-list once
+bool Student::AddCourseLocked(Course *c)
+{
+    if (EnrollLocked(c))
+        return true;
+    if (waitListedCourse == nullptr)
+    {
+        c->Register(this);   // Add Student (Observer) to the Course's Waitlist (in the Subject base class)
+        waitListedCourse = c;
+    }
+    return false;
+}
+
+void Student::Update()
+{
+    lock_guard<mutex> lock(updateLock);
+    if (waitListedCourse && ((waitListedCourse->GetState() == CourseState::OpenForEnrollment) ||
+       (waitListedCourse->GetState() == CourseState::NewSpaceAvailable)))
+    {
+        Course *c = waitListedCourse;
+        if (EnrollLocked(c))   // we are already on the waitlist, so do not go through AddCourseLocked()
+        {
+            waitListedCourse = nullptr;
+            if (announce)
+                cout << GetFirstName() << " " << GetLastName() << " removed from waitlist and added to " << c->GetTitle() << endl;
+            SetState(StudentState::AddSuccess);
+            c->Release(this);  // Remove Observer (Student = this) from Subject (Course's waitlist)
+        }
+        // else the Course is full; we remain on its waitlist (exactly once)
+    }
+}
+
+void Student::PrintCourses() const
+{
+    cout << "Student: (" << GetFirstName() << " " << GetLastName() << ") enrolled in: " << endl;
+    for (int i = 0; i < MAXCOURSES && courses[i] != nullptr; i++)
+        cout << "\t" << courses[i]->GetTitle() << endl;
+}
+
+void Course::PrintStudents() const
+{
+    lock_guard<mutex> lock(enrollLock);
+    cout << "Course: (" << GetTitle() << ") has the following students: " << endl;
+    for (int i = 0; i < MAXSTUDENTS && students[i] != nullptr; i++)
+        cout << "\t" << students[i]->GetFirstName() << " " << students[i]->GetLastName() << endl;
+}
+
+// Benchmark: a number of Courses, each with a long waitlist. We measure how long Open() takes to return
+// (the latency seen by the registration request thread) and how long until every Update() has been delivered.
+void Benchmark(const string &label, Delivery mode, int numCourses, int waitListSize)
+{
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::duration;
+    NotificationQueue queue(4, 1024);   // 4 delivery workers, batches of 1024 Update() calls
+    vector<unique_ptr<Course>> courses;
+    vector<unique_ptr<Student>> students;
+    for (int c = 0; c < numCourses; c++)
+    {
+        courses.push_back(make_unique<Course>("Course" + to_string(c), c, mode, &queue));
+        for (int s = 0; s < waitListSize; s++)
+            students.push_back(make_unique<Student>("First", "Last", 'M', "Ms.", 3.5, to_string(s) + "ID", courses.back().get()));
+    }
+
+    auto start = Clock::now();
+    double maxOpen = 0.0;
+    for (auto &c : courses)
+    {
+        auto before = Clock::now();
+        c->Open();
+        maxOpen = std::max(maxOpen, duration<double, std::micro>(Clock::now() - before).count());
+    }
+    auto opened = Clock::now();
+    queue.Drain();
+    auto done = Clock::now();
+
+    double openUs = duration<double, std::micro>(opened - start).count() / numCourses;
+    double totalSec = duration<double>(done - start).count();
+    long updates = mode == Delivery::Synchronous ? static_cast<long>(numCourses) * waitListSize : queue.GetDelivered();
+    cout << std::fixed << setprecision(1);
+    cout << std::left << std::setw(16) << label << " Open() avg: " << std::setw(10) << openUs << " us  max: "
+         << std::setw(10) << maxOpen << " us  delivery: " << setprecision(0) << updates / totalSec << " Update()/sec" << endl;
+    cout.unsetf(std::ios::fixed);
+    cout << std::right << setprecision(6);
+    courses.clear();   // Course destructors Drain() the queue before students go away
+}
+
+
+int main()
+{
+    NotificationQueue notifier(2, 2);   // 2 workers, tiny batches -- just to show the mechanics
+    Course *c1 = new Course("C++", 230, Delivery::AsyncOrdered, &notifier);
+    Course *c2 = new Course("Advanced C++", 430, Delivery::AsyncOrdered, &notifier);
+    Course *c3 = new Course("C++ Design Patterns", 550, Delivery::AsyncOrdered, &notifier);
+    Student s1("Anne", "Chu", 'M', "Ms.", 3.9, "66TU", c1);
+    Student s2("Joley", "Putt", 'I', "Ms.", 3.1, "585UD", c1);
+    Student s3("Goeff", "Curt", 'K', "Mr.", 3.1, "667UD", c1);
+    Student s4("Ling", "Mau", 'I', "Ms.", 3.1, "55TU", c1);
+    Student s5("Jiang", "Wu", 'Q', "Dr.", 3.8, "88TU", c1);
+    Student s6("Bea", "Ruiz", 'T', "Ms.", 3.6, "99TU", c1);   // c1 only has room for 5; Bea stays on the waitlist
+
+    cout << "Registration is Open" << "\n";
+    cout << "Waitlist Students to be added to Courses" << endl;
+    c1->Open();   // posts an event and returns; the waitlist is processed, in FIFO order, by a worker
+    c2->Open();
+    c3->Open();
+    notifier.Drain();   // wait for the waitlist to be processed before we print
+
+    cout << "During open registration, Students now adding more courses" << endl;
+    s1.AddCourse(c2);
+    s2.AddCourse(c2);
+    s4.AddCourse(c2);
+    s5.AddCourse(c2);
+    s1.AddCourse(c3);
+    s3.AddCourse(c3);
+    s5.AddCourse(c3);
+
+    cout << "Registration complete" << endl;
+    c1->PrintStudents();
+    c2->PrintStudents();
+    c3->PrintStudents();
+    cout << "Still on the waitlist for " << c1->GetTitle() << ": " << c1->GetNumObservers() << endl;
+
+    s1.PrintCourses();
+    s6.PrintCourses();
+
+    delete c1;
+    delete c2;
+    delete c3;
+
+    cout << endl << "Benchmark: 8 Courses, 100000 waitlisted Students each" << endl;
+    Student::SetAnnounce(false);
+    Benchmark("Synchronous", Delivery::Synchronous, 8, 100000);
+    Benchmark("AsyncOrdered", Delivery::AsyncOrdered, 8, 100000);
+    Benchmark("AsyncUnordered", Delivery::AsyncUnordered, 8, 100000);
+
+    return 0;
+}
@@ -0,0 +1,512 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate a waitlist-aware variation of the Observer Pattern.
+// In Chp16-Ex1.cpp, a Course holds a fixed array of MAXSTUDENTS Students, and Notify() wakes every
+// Observer on the waitlist, even when only a single seat has opened. Here, a Course has a dynamic capacity,
+// seats are reserved atomically (so that many Students may call AddCourse() concurrently), and when k seats
+// open, Notify(k) wakes exactly k Observers from the front of the waitlist.
+// Compile with: g++ -std=c++17 -O2 -pthread Chp16-Ex3.cpp
+// Run with: ./a.out [numCourses numStudents]   (the benchmark defaults to 10000 Courses and 1000000 Students)
+
+#include <iostream>
+#include <iomanip>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <algorithm>
+
+using std::cout;   // prefered to: using namespace std;
+using std::endl;
+using std::setprecision;
+using std::string;
+using std::to_string;
+using std::deque;
+using std::vector;
+using std::thread;
+using std::mutex;
+using std::lock_guard;
+using std::atomic;
+using std::unique_ptr;
+using std::make_unique;
+
+enum State { Initial = 0, Success = 1, Failure = 2 };
+enum StudentState { AddSuccess = State::Success, AddFailure = State::Failure };
+enum CourseState { OpenForEnrollment = State::Success, NewSpaceAvailable = State::Success, Full = State::Failure };
+
+class Subject;  // forward declarations
+class Student;
+
+class Observer
+{
+private:
+    atomic<int> observerState {State::Initial};
+protected:
+    Observer() = default;
+    Observer(int s): observerState(s) { }
+    void SetState(int s) { observerState = s; }
+public:
+    int GetState() const { return observerState; }
+    virtual ~Observer() = default;
+    virtual void Update() = 0;
+};
+
+class Subject
+{
+private:
+    deque<Observer *> observers;  // the waitlist, in FIFO order
+    atomic<int> subjectState {State::Initial};
+    mutable mutex observerLock;
+    atomic<long> wakeups {0};     // number of Update() calls made by Notify()
+protected:
+    Subject() = default;
+    Subject(int s): subjectState(s) { }
+    void SetState(int s) { subjectState = s; }
+public:
+    int GetState() const { return subjectState; }
+    int GetNumObservers() const { lock_guard<mutex> lock(observerLock); return static_cast<int>(observers.size()); }
+    long GetWakeups() const { return wakeups; }
+    virtual ~Subject() = default;
+    virtual void Register(Observer *);
+    virtual void Release(Observer *);
+    virtual void Notify();        // wake every Observer (broadcast)
+    virtual void Notify(int);     // wake at most k Observers, from the front of the waitlist
+};
+
+void Subject::Register(Observer *ob)
+{
+    lock_guard<mutex> lock(observerLock);
+    observers.push_back(ob);
+}
+
+void Subject::Release(Observer *ob)
+{
+    lock_guard<mutex> lock(observerLock);
+    auto iter = std::find(observers.begin(), observers.end(), ob);
+    if (iter != observers.end())
+        observers.erase(iter);
+}
+
+void Subject::Notify()
+{
+    Notify(GetNumObservers());
+}
+
+// Each Observer is removed from the waitlist before its Update() is called. An Observer signals that it
+// has taken the opening by setting its state to Success. If it could not (another Student reserved the
+// seat first), it is put back at the front of the waitlist -- keeping its place -- and we stop waking others.
+void Subject::Notify(int k)
+{
+    for (int i = 0; i < k; i++)
+    {
+        Observer *ob = nullptr;
+        {
+            lock_guard<mutex> lock(observerLock);
+            if (observers.empty())
+                return;
+            ob = observers.front();
+            observers.pop_front();
+        }
+        wakeups++;
+        ob->Update();   // no lock is held while the Observer runs; it may call back into this Subject
+        if (ob->GetState() != State::Success)
+        {
+            lock_guard<mutex> lock(observerLock);
+            observers.push_front(ob);
+            return;
+        }
+    }
+}
+
+
+class Course: public Subject
+{
+private:
+    string title;
+    int number = 0;
+    atomic<int> capacity {0};
+    atomic<int> seatsTaken {0};
+    vector<Student *> students;   // Students enrolled in Course; grows as needed
+    mutable mutex rosterLock;
+public:
+    Course(const string &title, int num, int cap): title(title), number(num), capacity(cap)
+    {
+        students.reserve(cap);
+    }
+    ~Course() override = default;
+    int GetCourseNum() const { return number; }
+    const string &GetTitle() const { return title; }
+    int GetCapacity() const { return capacity; }
+    int GetSeatsTaken() const { return seatsTaken; }
+    int GetOpenSeats() const { return std::max(0, capacity - seatsTaken); }
+    bool ReserveSeat();
+    bool AddStudent(Student *);
+    bool DropStudent(Student *);
+    void AddSeats(int);
+    void Open()
+    {
+        SetState(CourseState::OpenForEnrollment);
+        Notify(GetOpenSeats());   // wake only as many waitlisted Students as there are open seats
+    }
+    void PrintStudents() const;
+};
+
+// A seat is claimed with a compare-and-swap on seatsTaken; no lock is needed to decide who gets the seat
+bool Course::ReserveSeat()
+{
+    int taken = seatsTaken.load(std::memory_order_relaxed);
+    do
+    {
+        if (taken >= capacity.load(std::memory_order_acquire))
+            return false;
+    } while (!seatsTaken.compare_exchange_weak(taken, taken + 1, std::memory_order_acq_rel));
+    return true;
+}
+
+bool Course::AddStudent(Student *s)
+{
+    if (!ReserveSeat())
+        return false;
+    lock_guard<mutex> lock(rosterLock);   // only recording the Student in the roster is serialized
+    students.push_back(s);
+    return true;
+}
+
+bool Course::DropStudent(Student *s)
+{
+    {
+        lock_guard<mutex> lock(rosterLock);
+        auto iter = std::find(students.begin(), students.end(), s);
+        if (iter == students.end())
+            return false;
+        students.erase(iter);
+    }
+    seatsTaken--;
+    SetState(CourseState::NewSpaceAvailable);
+    Notify(1);   // exactly one seat opened, so wake exactly one waitlisted Student
+    return true;
+}
+
+void Course::AddSeats(int k)
+{
+    capacity += k;
+    SetState(CourseState::NewSpaceAvailable);
+    Notify(k);
+}
+
+class Person
+{
+private:
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+protected:
+    void ModifyTitle(const string &);
+public:
+    Person() = default;
+    Person(const string &, const string &, char, const string &);
+    Person(const Person &) = default;
+    virtual ~Person() = default;
+
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+
+    virtual void Print() const;
+    virtual void IsA() const;
+    virtual void Greeting(const string &) const;
+};
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) :
+               firstName(fn), lastName(ln), middleInitial(mi), title(t)
+{
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+    title = newTitle;
+}
+
+void Person::Print() const
+{
+    cout << title << " " << firstName << " ";
+    cout << middleInitial << ". " << lastName << endl;
+}
+
+void Person::IsA() const
+{
+    cout << "Person" << endl;
+}
+
+void Person::Greeting(const string &msg) const
+{
+    cout << msg << endl;
+}
+
+class Student : public Person, public Observer
+{
+private:
+    float gpa = 0.0;
+    const string studentId;
+    vector<Course *> courses;            // no longer limited to MAXCOURSES
+    Course *waitListedCourse = nullptr;  // our Subject in specialized form
+    static atomic<int> numStudents;
+    static atomic<bool> announce;
+public:
+    Student(const string &, const string &, char, const string &, float, const string &, Course *);
+    Student(const string &, const string &, char, const string &, float, const string &);
+    Student(const Student &) = delete;
+    ~Student() override;
+
+    float GetGpa() const { return gpa; }
+    const string &GetStudentId() const { return studentId; }
+    bool IsWaitListed() const { return waitListedCourse != nullptr; }
+
+    void Print() const override;
+    void IsA() const override;
+    void Update() override;       // overridden from Observer
+    bool AddCourse(Course *);
+    bool DropCourse(Course *);
+    void PrintCourses() const;
+
+    static int GetNumberStudents() { return numStudents; }
+    static void SetAnnounce(bool a) { announce = a; }
+};
+
+atomic<int> Student::numStudents {0};
+atomic<bool> Student::announce {true};
+
+Student::Student(const string &fn, const string &ln, char mi, const string &t, float avg, const string &id, Course *c) :
+                 Person(fn, ln, mi, t), gpa(avg), studentId(id), waitListedCourse(c)
+{
+    c->Register(this);
+    numStudents++;
+}
+
+Student::Student(const string &fn, const string &ln, char mi, const string &t, float avg, const string &id) :
+                 Person(fn, ln, mi, t), gpa(avg), studentId(id)
+{
+    numStudents++;
+}
+
+Student::~Student()
+{
+    if (waitListedCourse)
+        waitListedCourse->Release(this);
+    numStudents--;
+}
+
+void Student::Print() const
+{
+    cout << GetTitle() << " " << GetFirstName() << " ";
+    cout << GetMiddleInitial() << ". " << GetLastName();
+    cout << " with id: " << studentId << " GPA: ";
+    cout << setprecision(3) <<  " " << gpa;
+}
+
+void Student::IsA() const
+{
+    cout << "Student" << endl;
+}
+
+// Many Students may call AddCourse() at once; the Course decides atomically whether a seat is available.
+// A Student may be on at most one waitlist at a time (as in Chp16-Ex1.cpp), and may not take a Course twice.
+bool Student::AddCourse(Course *c)
+{
+    if (std::find(courses.begin(), courses.end(), c) != courses.end())
+        return false;   // already enrolled; neither take a second seat nor wait for one
+    if (c->AddStudent(this))
+    {
+        courses.push_back(c);
+        if (c == waitListedCourse)   // we got a seat directly; leave the waitlist, or a wakeup would add us again
+        {
+            waitListedCourse = nullptr;
+            c->Release(this);
+        }
+        return true;
+    }
+    if (waitListedCourse == nullptr)
+    {
+        waitListedCourse = c;
+        c->Register(this);
+    }
+    return false;
+}
+
+bool Student::DropCourse(Course *c)
+{
+    auto iter = std::find(courses.begin(), courses.end(), c);
+    if (iter == courses.end())
+        return false;
+    courses.erase(iter);
+    return c->DropStudent(this);
+}
+
+// Called by Notify(k) after we have been taken off the front of the waitlist
+void Student::Update()
+{
+    Course *c = waitListedCourse;
+    if (c && ((c->GetState() == CourseState::OpenForEnrollment) || (c->GetState() == CourseState::NewSpaceAvailable)) &&
+        c->AddStudent(this))
+    {
+        courses.push_back(c);
+        waitListedCourse = nullptr;
+        SetState(StudentState::AddSuccess);
+        if (announce)
+            cout << GetFirstName() << " " << GetLastName() << " removed from waitlist and added to " << c->GetTitle() << endl;
+    }
+    else
+        SetState(StudentState::AddFailure);   // Notify() will return us to the front of the waitlist
+}
+
+void Student::PrintCourses() const
+{
+    cout << "Student: (" << GetFirstName() << " " << GetLastName() << ") enrolled in: " << endl;
+    for (auto *c : courses)
+        cout << "\t" << c->GetTitle() << endl;
+}
+
+void Course::PrintStudents() const
+{
+    lock_guard<mutex> lock(rosterLock);
+    cout << "Course: (" << GetTitle() << ") has the following students: " << endl;
+    for (auto *s : students)
+        cout << "\t" << s->GetFirstName() << " " << s->GetLastName() << endl;
+}
+
+// Simulation: every Student tries to add a few random Courses, from several threads at once. Students who find
+// a Course full join its waitlist. Then seats open up, in small groups, across random Courses; each opening
+// of k seats wakes at most k Students. We compare the wakeups to what a broadcast Notify() would have cost.
+void Simulate(int numCourses, int numStudents)
+{
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::duration;
+    constexpr int coursesPerStudent = 3, seatsPerCourse = 20;
+    int numThreads = std::max(2u, thread::hardware_concurrency());
+
+    vector<unique_ptr<Course>> courses;
+    courses.reserve(numCourses);
+    for (int c = 0; c < numCourses; c++)
+        courses.push_back(make_unique<Course>("Course" + to_string(c), c, seatsPerCourse));
+    vector<unique_ptr<Student>> students;
+    students.reserve(numStudents);
+    for (int s = 0; s < numStudents; s++)
+        students.push_back(make_unique<Student>("First", "Last", 'M', "Ms.", 3.5, to_string(s)));
+    for (auto &c : courses)
+        c->Open();
+
+    atomic<long> enrolled {0};
+    auto start = Clock::now();
+    vector<thread> workers;
+    for (int t = 0; t < numThreads; t++)
+        workers.emplace_back([&, t]
+        {
+            std::mt19937 rng(t);
+            std::uniform_int_distribution<int> pick(0, numCourses - 1);
+            long mine = 0;
+            for (int s = t; s < numStudents; s += numThreads)
+            {
+                int chosen[coursesPerStudent];   // distinct Courses (sampled without replacement)
+                int numChosen = std::min(coursesPerStudent, numCourses);
+                for (int i = 0; i < numChosen; i++)
+                {
+                    do
+                        chosen[i] = pick(rng);
+                    while (std::find(chosen, chosen + i, chosen[i]) != chosen + i);
+                    mine += students[s]->AddCourse(courses[chosen[i]].get());
+                }
+            }
+            enrolled += mine;
+        });
+    for (auto &w : workers)
+        w.join();
+    double addSec = duration<double>(Clock::now() - start).count();
+
+    long waitListed = 0;
+    for (auto &c : courses)
+        waitListed += c->GetNumObservers();
+
+    // Open 1-3 seats at a time in random Courses, until roughly a quarter of the waitlisted Students have been served
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> pick(0, numCourses - 1), howMany(1, 3);
+    long seatsOpened = 0, broadcastWakeups = 0, wakeupsBefore = 0;
+    for (auto &c : courses)
+        wakeupsBefore += c->GetWakeups();
+    start = Clock::now();
+    while (seatsOpened < waitListed / 4)
+    {
+        Course *c = courses[pick(rng)].get();
+        int k = howMany(rng);
+        broadcastWakeups += c->GetNumObservers();   // what Notify() to everyone would have done
+        c->AddSeats(k);
+        seatsOpened += k;
+    }
+    double wakeSec = duration<double>(Clock::now() - start).count();
+    long wakeups = -wakeupsBefore, seatsTaken = 0;
+    for (auto &c : courses)
+    {
+        wakeups += c->GetWakeups();
+        seatsTaken += c->GetSeatsTaken();
+    }
+
+    cout << std::fixed << setprecision(0);
+    cout << numCourses << " Courses, " << numStudents << " Students, " << numThreads << " threads" << endl;
+    cout << "  concurrent AddCourse(): " << enrolled << " enrollments, " << enrolled / addSec << " enrollments/sec, "
+         << waitListed << " Students waitlisted" << endl;
+    cout << "  seat openings: " << seatsOpened << " seats opened, " << wakeups << " wakeups (broadcast would be "
+         << broadcastWakeups << "), " << seatsOpened / wakeSec << " seats filled/sec" << endl;
+    cout << "  seats taken: " << seatsTaken << endl;
+    cout.unsetf(std::ios::fixed);
+    cout << setprecision(6);
+    students.clear();   // Students release themselves from waitlists, so destroy them before the Courses
+}
+
+
+int main(int argc, char *argv[])
+{
+    // Courses are declared before the Students, so that they outlive them (a Student leaves its waitlist when destroyed)
+    Course c1("C++", 230, 3);  // Courses now have a capacity of our choosing
+    Course c2("Advanced C++", 430, 2);
+    Student s1("Anne", "Chu", 'M', "Ms.", 3.9, "66TU", &c1);
+    Student s2("Joley", "Putt", 'I', "Ms.", 3.1, "585UD", &c1);
+    Student s3("Goeff", "Curt", 'K', "Mr.", 3.1, "667UD", &c1);
+    Student s4("Ling", "Mau", 'I', "Ms.", 3.1, "55TU", &c1);
+    Student s5("Jiang", "Wu", 'Q', "Dr.", 3.8, "88TU", &c1);
+
+    cout << "Registration is Open" << endl;
+    c1.Open();   // 3 seats, so exactly 3 Students are woken; 2 remain on the waitlist
+    c2.Open();   // nobody waiting
+    cout << "Waitlist for " << c1.GetTitle() << ": " << c1.GetNumObservers() << ", wakeups: " << c1.GetWakeups() << endl;
+
+    s1.AddCourse(&c2);
+    s2.AddCourse(&c2);
+    s3.AddCourse(&c2);   // c2 is now full, so Goeff joins its waitlist
+    s4.AddCourse(&c2);   // Ling is already on c1's waitlist, so she can not wait for c2 as well
+    cout << "Joley adds " << c2.GetTitle() << " again: " << (s2.AddCourse(&c2) ? "added" : "rejected, already enrolled") << endl;
+    cout << "Waitlist for " << c2.GetTitle() << ": " << c2.GetNumObservers() << endl;
+
+    cout << "Anne drops " << c1.GetTitle() << " -- one seat opens, one Student is woken" << endl;
+    s1.DropCourse(&c1);
+    cout << "Two more seats are added to " << c2.GetTitle() << " -- only one Student is waiting" << endl;
+    c2.AddSeats(2);
+    cout << "Waitlist for " << c1.GetTitle() << ": " << c1.GetNumObservers() << ", wakeups: " << c1.GetWakeups() << endl;
+    cout << "Waitlist for " << c2.GetTitle() << ": " << c2.GetNumObservers() << ", wakeups: " << c2.GetWakeups() << endl;
+
+    c1.PrintStudents();
+    c2.PrintStudents();
+    s1.PrintCourses();
+    s3.PrintCourses();
+
+    int numCourses = argc > 2 ? std::stoi(argv[1]) : 10000;
+    int numStudents = argc > 2 ? std::stoi(argv[2]) : 1000000;
+    cout << endl << "Simulation (run as: ./a.out 100000 10000000 for the full-size run)" << endl;
+    Student::SetAnnounce(false);
+    Simulate(numCourses, numStudents);
+
+    return 0;
+}
@@ -0,0 +1,419 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate the Observer Pattern with typed events and filtered (topic) subscriptions.
+// In Chp16-Ex1.cpp, Observer::Update() takes no arguments, so every Observer must call back into its
+// Subject (GetState()) to find out what changed, and every Observer is notified on every state change.
+// Here, Update() receives an Event which carries the new state, and an Observer subscribes only to the
+// kinds of Event it is interested in (e.g. only NewSpaceAvailable). Notify() visits only those Observers.
+// Compile with: g++ -std=c++17 -O2 Chp16-Ex4.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <algorithm>
+
+using std::cout;   // prefered to: using namespace std;
+using std::endl;
+using std::setprecision;
+using std::string;
+using std::to_string;
+using std::vector;
+using std::unique_ptr;
+using std::make_unique;
+
+// Unlike Chp16-Ex1.cpp, each kind of Course state change has its own value, so that it may be subscribed to separately
+enum class CourseEvent { OpenForEnrollment = 0, NewSpaceAvailable, Full, Cancelled, NumEvents };
+constexpr int NUMEVENTS = static_cast<int>(CourseEvent::NumEvents);
+
+// A subscription filter is a bit mask of the CourseEvents an Observer wants to receive
+using Interest = unsigned int;
+constexpr Interest InterestIn(CourseEvent e) { return 1u << static_cast<int>(e); }
+constexpr Interest AllEvents = (1u << NUMEVENTS) - 1;
+
+enum State { Initial = 0, Success = 1, Failure = 2 };
+enum StudentState { AddSuccess = State::Success, AddFailure = State::Failure };
+
+class Subject;  // forward declarations
+class Student;
+
+// The typed event delivered to Observers -- the new state travels with the notification
+struct Event
+{
+    Subject *source = nullptr;
+    CourseEvent state = CourseEvent::OpenForEnrollment;
+    int openSeats = 0;
+};
+
+class Observer
+{
+private:
+    int observerState = State::Initial;
+protected:
+    Observer() = default;
+    Observer(int s): observerState(s) { }
+    void SetState(int s) { observerState = s; }
+public:
+    int GetState() const { return observerState; }
+    virtual ~Observer() = default;
+    virtual void Update(const Event &) = 0;
+};
+
+class Subject
+{
+private:
+    vector<Observer *> subscribers[NUMEVENTS];  // one subscriber list per kind of Event (topic)
+    int numObservers = 0;
+    CourseEvent subjectState = CourseEvent::OpenForEnrollment;
+    long numUpdates = 0;   // Update() calls made by Notify(), for comparison in the benchmark
+protected:
+    Subject() = default;
+    void SetState(CourseEvent s) { subjectState = s; }
+public:
+    CourseEvent GetState() const { return subjectState; }
+    int GetNumObservers() const { return numObservers; }
+    long GetNumUpdates() const { return numUpdates; }
+    virtual ~Subject() = default;
+    virtual void Register(Observer *, Interest = AllEvents);
+    virtual void Release(Observer *);
+    virtual void Notify(const Event &);
+};
+
+void Subject::Register(Observer *ob, Interest interest)
+{
+    for (int e = 0; e < NUMEVENTS; e++)
+        if (interest & InterestIn(static_cast<CourseEvent>(e)))
+            subscribers[e].push_back(ob);
+    numObservers++;
+}
+
+void Subject::Release(Observer *ob)
+{
+    bool found = false;
+    for (auto &topic : subscribers)
+    {
+        auto iter = std::find(topic.begin(), topic.end(), ob);
+        if (iter != topic.end())
+        {
+            topic.erase(iter);   // erase (not swap-and-pop), so that FIFO order of the waitlist is kept
+            found = true;
+        }
+    }
+    if (found)
+        numObservers--;
+}
+
+// Only the Observers subscribed to this kind of Event are visited. We iterate over a copy of the topic,
+// as an Observer's Update() may Release() it from this Subject
+void Subject::Notify(const Event &e)
+{
+    SetState(e.state);
+    const vector<Observer *> topic = subscribers[static_cast<int>(e.state)];
+    for (auto *ob : topic)
+    {
+        numUpdates++;
+        ob->Update(e);
+    }
+}
+
+
+class Course: public Subject   // over-simplified Course class
+{
+private:
+    string title;
+    int number = 0;
+    int capacity = 0;
+    vector<Student *> students;   // Students enrolled in Course
+public:
+    Course(const string &title, int num, int cap): title(title), number(num), capacity(cap) { }
+    ~Course() override = default;
+    int GetCourseNum() const { return number; }
+    const string &GetTitle() const { return title; }
+    int GetOpenSeats() const { return capacity - static_cast<int>(students.size()); }
+    bool AddStudent(Student *);
+    void DropStudent(Student *);
+    void Open() { Notify({this, CourseEvent::OpenForEnrollment, GetOpenSeats()}); }
+    void PrintStudents() const;
+};
+
+bool Course::AddStudent(Student *s)
+{
+    if (GetOpenSeats() <= 0)
+        return false;
+    students.push_back(s);
+    if (GetOpenSeats() == 0)
+        Notify({this, CourseEvent::Full, 0});
+    return true;
+}
+
+void Course::DropStudent(Student *s)
+{
+    auto iter = std::find(students.begin(), students.end(), s);
+    if (iter != students.end())
+    {
+        students.erase(iter);
+        Notify({this, CourseEvent::NewSpaceAvailable, GetOpenSeats()});
+    }
+}
+
+class Person
+{
+private:
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+protected:
+    void ModifyTitle(const string &);
+public:
+    Person() = default;
+    Person(const string &, const string &, char, const string &);
+    Person(const Person &) = default;
+    virtual ~Person() = default;
+
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+
+    virtual void Print() const;
+    virtual void IsA() const;
+    virtual void Greeting(const string &) const;
+};
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) :
+               firstName(fn), lastName(ln), middleInitial(mi), title(t)
+{
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+    title = newTitle;
+}
+
+void Person::Print() const
+{
+    cout << title << " " << firstName << " ";
+    cout << middleInitial << ". " << lastName << endl;
+}
+
+void Person::IsA() const
+{
+    cout << "Person" << endl;
+}
+
+void Person::Greeting(const string &msg) const
+{
+    cout << msg << endl;
+}
+
+class Student : public Person, public Observer
+{
+private:
+    float gpa = 0.0;
+    const string studentId;
+    vector<Course *> courses;
+    Course *waitListedCourse = nullptr;  // our Subject in specialized form
+public:
+    Student(const string &, const string &, char, const string &, float, const string &, Course *);
+    Student(const string &, const string &, char, const string &, float, const string &);
+    Student(const Student &) = delete;
+    ~Student() override = default;
+
+    float GetGpa() const { return gpa; }
+    const string &GetStudentId() const { return studentId; }
+
+    void Print() const override;
+    void IsA() const override;
+    void Update(const Event &) override;   // overridden from Observer
+    bool AddCourse(Course *);
+    void DropCourse(Course *);
+    void PrintCourses() const;
+};
+
+// A waitlisted Student only cares about Events which could let them in: the Course opening, or a seat freeing up
+constexpr Interest WaitListInterest = InterestIn(CourseEvent::OpenForEnrollment) | InterestIn(CourseEvent::NewSpaceAvailable);
+
+Student::Student(const string &fn, const string &ln, char mi, const string &t, float avg, const string &id, Course *c) :
+                 Person(fn, ln, mi, t), gpa(avg), studentId(id), waitListedCourse(c)
+{
+    c->Register(this, WaitListInterest);
+}
+
+Student::Student(const string &fn, const string &ln, char mi, const string &t, float avg, const string &id) :
+                 Person(fn, ln, mi, t), gpa(avg), studentId(id)
+{
+}
+
+void Student::Print() const
+{
+    cout << GetTitle() << " " << GetFirstName() << " ";
+    cout << GetMiddleInitial() << ". " << GetLastName();
+    cout << " with id: " << studentId << " GPA: ";
+    cout << setprecision(3) <<  " " << gpa;
+}
+
+void Student::IsA() const
+{
+    cout << "Student" << endl;
+}
+
+bool Student::AddCourse(Course *c)
+{
+    if (c->AddStudent(this))
+    {
+        courses.push_back(c);
+        return true;
+    }
+    if (waitListedCourse == nullptr)
+    {
+        c->Register(this, WaitListInterest);   // Add Student (Observer) to the Course's Waitlist
+        waitListedCourse = c;
+    }
+    return false;
+}
+
+void Student::DropCourse(Course *c)
+{
+    auto iter = std::find(courses.begin(), courses.end(), c);
+    if (iter != courses.end())
+    {
+        courses.erase(iter);
+        c->DropStudent(this);
+    }
+}
+
+// The Event tells us what happened -- there is no need to call back into waitListedCourse->GetState()
+void Student::Update(const Event &e)
+{
+    if (e.source == waitListedCourse && e.openSeats > 0 && AddCourse(waitListedCourse))
+    {
+        cout << GetFirstName() << " " << GetLastName() << " removed from waitlist and added to " << waitListedCourse->GetTitle() << endl;
+        SetState(StudentState::AddSuccess);
+        Course *c = waitListedCourse;
+        waitListedCourse = nullptr;
+        c->Release(this);  // Remove Observer (Student = this) from Subject (Course's waitlist)
+    }
+}
+
+void Student::PrintCourses() const
+{
+    cout << "Student: (" << GetFirstName() << " " << GetLastName() << ") enrolled in: " << endl;
+    for (auto *c : courses)
+        cout << "\t" << c->GetTitle() << endl;
+}
+
+void Course::PrintStudents() const
+{
+    cout << "Course: (" << GetTitle() << ") has the following students: " << endl;
+    for (auto *s : students)
+        cout << "\t" << s->GetFirstName() << " " << s->GetLastName() << endl;
+}
+
+// A different kind of Observer: the Registrar only wants to hear when a Course fills up (or is cancelled)
+class Registrar : public Observer
+{
+public:
+    void Update(const Event &e) override
+    {
+        cout << "Registrar: " << static_cast<Course *>(e.source)->GetTitle()
+             << (e.state == CourseEvent::Full ? " is full" : " was cancelled") << endl;
+    }
+};
+
+
+// Benchmark support: a minimal Observer with a random interest in the Events. In broadcast mode (the Chp16-Ex1.cpp
+// behavior) it is subscribed to everything, and must call back to its Subject to filter out what it does not want.
+class CountingObserver : public Observer
+{
+private:
+    Interest interest = 0;
+    bool broadcast = false;
+public:
+    static long backCalls, handled;
+    CountingObserver(Interest i, bool b): interest(i), broadcast(b) { }
+    void Update(const Event &e) override
+    {
+        CourseEvent state = e.state;
+        if (broadcast)
+        {
+            state = e.source->GetState();   // back-call into the Subject to find out what changed
+            backCalls++;
+            if (!(interest & InterestIn(state)))
+                return;
+        }
+        handled++;
+    }
+};
+
+long CountingObserver::backCalls = 0, CountingObserver::handled = 0;
+
+class BenchSubject : public Subject { };
+
+void Benchmark(bool broadcast, int numObservers, int numEvents)
+{
+    using Clock = std::chrono::steady_clock;
+    std::mt19937 rng(7);
+    // mixed workload: each Observer is interested in a single kind of Event (a quarter want NewSpaceAvailable, etc.)
+    std::uniform_int_distribution<int> pickEvent(0, NUMEVENTS - 1);
+    BenchSubject subject;
+    vector<unique_ptr<CountingObserver>> observers;
+    for (int i = 0; i < numObservers; i++)
+    {
+        Interest want = InterestIn(static_cast<CourseEvent>(pickEvent(rng)));
+        observers.push_back(make_unique<CountingObserver>(want, broadcast));
+        subject.Register(observers.back().get(), broadcast ? AllEvents : want);
+    }
+    CountingObserver::backCalls = CountingObserver::handled = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < numEvents; i++)
+        subject.Notify({&subject, static_cast<CourseEvent>(pickEvent(rng)), 1});
+    double sec = std::chrono::duration<double>(Clock::now() - start).count();
+    cout << std::left << std::setw(10) << (broadcast ? "broadcast" : "filtered") << std::right
+         << " Update() calls: " << std::setw(10) << subject.GetNumUpdates()
+         << "  back-calls: " << std::setw(10) << CountingObserver::backCalls
+         << "  handled: " << std::setw(10) << CountingObserver::handled
+         << "  time: " << std::fixed << setprecision(2) << sec * 1000 << " ms" << endl;
+    cout.unsetf(std::ios::fixed);
+    cout << setprecision(6);
+}
+
+
+int main()
+{
+    Registrar registrar;
+    Course *c1 = new Course("C++", 230, 3);
+    Course *c2 = new Course("Advanced C++", 430, 2);
+    c1->Register(&registrar, InterestIn(CourseEvent::Full) | InterestIn(CourseEvent::Cancelled));
+    c2->Register(&registrar, InterestIn(CourseEvent::Full) | InterestIn(CourseEvent::Cancelled));
+    Student s1("Anne", "Chu", 'M', "Ms.", 3.9, "66TU", c1);
+    Student s2("Joley", "Putt", 'I', "Ms.", 3.1, "585UD", c1);
+    Student s3("Goeff", "Curt", 'K', "Mr.", 3.1, "667UD", c1);
+    Student s4("Ling", "Mau", 'I', "Ms.", 3.1, "55TU", c1);
+
+    cout << "Registration is Open" << endl;
+    c1->Open();   // Students hear OpenForEnrollment; the Registrar hears only that C++ is now Full
+    c2->Open();
+
+    cout << "During open registration, Students now adding more courses" << endl;
+    s1.AddCourse(c2);
+    s2.AddCourse(c2);   // c2 becomes Full -- only the Registrar is told
+
+    cout << "Anne drops C++; only the Students waiting for space hear about it" << endl;
+    s1.DropCourse(c1);
+
+    c1->PrintStudents();
+    c2->PrintStudents();
+    s1.PrintCourses();
+    s4.PrintCourses();
+
+    delete c1;
+    delete c2;
+
+    cout << endl << "Benchmark: 10000 Observers, 2000 Events of mixed kinds" << endl;
+    Benchmark(true, 10000, 2000);
+    Benchmark(false, 10000, 2000);
+
+    return 0;
+}
@@ -0,0 +1,553 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate replacing the fixed Course *courses[MAXCOURSES] array in Student (see Chp16-Ex1.cpp)
+// with a compact CourseSet: a sorted, small vector of course numbers which is stored inline in the Student and
+// spills to the heap only when a Student takes more than INLINECOURSES courses. Membership tests are O(log n),
+// which lets AddCourse() reject duplicate enrollments, and two sets can be checked for overlap in O(n + m),
+// which we use to detect conflicting enrollments across the whole student body.
+// Compile with: g++ -std=c++17 -O2 Chp16-Ex5.cpp
+// Run with: ./a.out [numStudents]   (the benchmark defaults to 10000000 Students)
+
+#include <iostream>
+#include <iomanip>
+#include <list>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+#include <random>
+
+using std::cout;   // prefered to: using namespace std;
+using std::endl;
+using std::setprecision;
+using std::string;
+using std::to_string;
+using std::list;
+using std::vector;
+using std::map;
+
+// More enumerators within the states are created here than are currently used; they exist for expansion of example
+enum State { Initial = 0, Success = 1, Failure = 2 };
+enum StudentState { AddSuccess = State::Success, AddFailure = State::Failure };
+enum CourseState { OpenForEnrollment = State::Success, NewSpaceAvailable = State::Success, Full = State::Failure };
+
+constexpr int MAXSTUDENTS = 5;
+
+// CourseSet keeps course numbers in ascending order. Up to INLINECOURSES of them live inside the object itself;
+// beyond that, the numbers move to a heap buffer which doubles as needed. A full-time load fits inline.
+class CourseSet
+{
+private:
+    static constexpr int INLINECOURSES = 10;
+    int size = 0;
+    int capacity = INLINECOURSES;
+    union
+    {
+        int local[INLINECOURSES];
+        int *heap;
+    };
+    bool IsInline() const { return capacity == INLINECOURSES; }
+    int *Data() { return IsInline() ? local : heap; }
+    const int *Data() const { return IsInline() ? local : heap; }
+    const int *LowerBound(int) const;
+    void Grow();
+public:
+    CourseSet() { }   // note: the contents of 'local' need no initialization, as size is 0
+    CourseSet(const CourseSet &);
+    CourseSet(CourseSet &&) noexcept;
+    CourseSet &operator=(const CourseSet &);
+    CourseSet &operator=(CourseSet &&) noexcept;
+    ~CourseSet() { if (!IsInline()) delete [] heap; }
+
+    int Size() const { return size; }
+    bool Empty() const { return size == 0; }
+    const int *begin() const { return Data(); }
+    const int *end() const { return Data() + size; }
+    bool Contains(int num) const { const int *pos = LowerBound(num); return pos != end() && *pos == num; }
+    bool Insert(int);    // returns false if num is already in the set
+    bool Erase(int);     // returns false if num was not in the set
+    bool Intersects(const CourseSet &) const;
+};
+
+// A copy is stored inline whenever it fits, even if the original has spilled to the heap
+CourseSet::CourseSet(const CourseSet &cs) : size(cs.size), capacity(cs.size <= INLINECOURSES ? INLINECOURSES : cs.capacity)
+{
+    if (!IsInline())
+        heap = new int[capacity];
+    std::memcpy(Data(), cs.Data(), size * sizeof(int));
+}
+
+CourseSet::CourseSet(CourseSet &&cs) noexcept : size(cs.size), capacity(cs.capacity)
+{
+    if (IsInline())
+        std::memcpy(local, cs.local, size * sizeof(int));
+    else
+    {
+        heap = cs.heap;   // steal the heap buffer; leave the source as an empty, inline set
+        cs.capacity = INLINECOURSES;
+    }
+    cs.size = 0;
+}
+
+CourseSet &CourseSet::operator=(const CourseSet &cs)
+{
+    if (this != &cs)
+        *this = CourseSet(cs);
+    return *this;
+}
+
+CourseSet &CourseSet::operator=(CourseSet &&cs) noexcept
+{
+    if (this != &cs)
+    {
+        if (!IsInline())
+            delete [] heap;
+        size = cs.size;
+        capacity = cs.capacity;
+        if (IsInline())
+            std::memcpy(local, cs.local, size * sizeof(int));
+        else
+        {
+            heap = cs.heap;
+            cs.capacity = INLINECOURSES;
+        }
+        cs.size = 0;
+    }
+    return *this;
+}
+
+// A branch-free binary search: for sets this small, mispredicted branches cost more than the comparisons
+const int *CourseSet::LowerBound(int num) const
+{
+    const int *base = Data();
+    int len = size;
+    if (len == 0)
+        return base;
+    while (len > 1)
+    {
+        int half = len / 2;
+        base = (base[half] < num) ? base + half : base;
+        len -= half;
+    }
+    return base + (*base < num);
+}
+
+// Heap capacities are always a multiple of 2 * INLINECOURSES, so capacity alone tells us where the numbers live
+void CourseSet::Grow()
+{
+    int newCapacity = capacity * 2;
+    int *buffer = new int[newCapacity];
+    std::memcpy(buffer, Data(), size * sizeof(int));
+    if (!IsInline())
+        delete [] heap;
+    heap = buffer;
+    capacity = newCapacity;
+}
+
+bool CourseSet::Insert(int num)
+{
+    int *pos = Data() + (LowerBound(num) - Data());
+    if (pos != Data() + size && *pos == num)
+        return false;   // duplicate
+    if (size == capacity)
+    {
+        int index = pos - Data();
+        Grow();
+        pos = Data() + index;
+    }
+    std::memmove(pos + 1, pos, (Data() + size - pos) * sizeof(int));
+    *pos = num;
+    size++;
+    return true;
+}
+
+bool CourseSet::Erase(int num)
+{
+    int *pos = Data() + (LowerBound(num) - Data());
+    if (pos == Data() + size || *pos != num)
+        return false;
+    std::memmove(pos, pos + 1, (Data() + size - pos - 1) * sizeof(int));
+    size--;
+    return true;
+}
+
+// Both sets are sorted, so a single merge-style walk finds any common course number
+bool CourseSet::Intersects(const CourseSet &cs) const
+{
+    const int *a = begin(), *b = cs.begin();
+    while (a != end() && b != cs.end())
+    {
+        if (*a < *b)
+            a++;
+        else if (*b < *a)
+            b++;
+        else
+            return true;
+    }
+    return false;
+}
+
+
+class Subject;  // forward declarations
+class Student;
+
+class Observer
+{
+private:
+    int observerState = State::Initial;   // in-class initialization
+protected:
+    Observer() = default;
+    Observer(int s): observerState(s) { }
+    void SetState(int s) { observerState = s; }
+public:
+    int GetState() const { return observerState; }
+    virtual ~Observer() = default;
+    virtual void Update() = 0;
+};
+
+class Subject
+{
+private:
+    list<Observer *> observers;  // List of Observers (in our application, this will be Students on wait-list)
+    int subjectState = State::Initial;
+protected:
+    Subject() = default;
+    Subject(int s): subjectState(s) { }
+    void SetState(int s) { subjectState = s; }
+public:
+    int GetState() const { return subjectState; }
+    int GetNumObservers() const { return static_cast<int>(observers.size()); }
+    virtual ~Subject() = default;
+    virtual void Register(Observer *ob) { observers.push_back(ob); }
+    virtual void Release(Observer *ob) { observers.remove(ob); }
+    virtual void Notify();
+};
+
+void Subject::Notify()
+{
+    // iterate over a copy, as an Observer's Update() may Release() it from our list
+    vector<Observer *> waitList(observers.begin(), observers.end());
+    for (auto *ob : waitList)
+        ob->Update();
+}
+
+
+class Course: public Subject   // over-simplified Course class
+{
+private:
+    string title;
+    int number = 0;
+    Student *students[MAXSTUDENTS] = { };
+    int totalStudents = 0;
+    static map<int, Course *> catalog;   // course number -> Course, so that a Student need only store course numbers
+public:
+    Course(const string &title, int num): title(title), number(num) { catalog[num] = this; }
+    ~Course() override { catalog.erase(number); }
+    int GetCourseNum() const { return number; }
+    const string &GetTitle() const { return title; }
+    bool AddStudent(Student *);
+    void Open()
+    {
+        SetState(CourseState::OpenForEnrollment);
+        Notify();
+    }
+    void PrintStudents() const;
+    static Course *Find(int num)
+    {
+        auto iter = catalog.find(num);
+        return iter == catalog.end() ? nullptr : iter->second;
+    }
+};
+
+map<int, Course *> Course::catalog;
+
+bool Course::AddStudent(Student *s)
+{
+    if (totalStudents < MAXSTUDENTS)  // make sure Course is not full
+    {
+        students[totalStudents++] = s;
+        return true;
+    }
+    else
+        return false;
+}
+
+class Person
+{
+private:
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+protected:
+    void ModifyTitle(const string &);
+public:
+    Person() = default;
+    Person(const string &, const string &, char, const string &);
+    Person(const Person &) = default;
+    virtual ~Person() = default;
+
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+
+    virtual void Print() const;
+    virtual void IsA() const;
+    virtual void Greeting(const string &) const;
+};
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) :
+               firstName(fn), lastName(ln), middleInitial(mi), title(t)
+{
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+    title = newTitle;
+}
+
+void Person::Print() const
+{
+    cout << title << " " << firstName << " ";
+    cout << middleInitial << ". " << lastName << endl;
+}
+
+void Person::IsA() const
+{
+    cout << "Person" << endl;
+}
+
+void Person::Greeting(const string &msg) const
+{
+    cout << msg << endl;
+}
+
+class Student : public Person, public Observer
+{
+private:
+    float gpa = 0.0;
+    const string studentId;
+    CourseSet courses;                   // replaces Course *courses[MAXCOURSES]
+    Course *waitListedCourse = nullptr;  // Course we'd like to take - we're on the waitlist
+public:
+    Student(const string &, const string &, char, const string &, float, const string &, Course *);
+    Student(const string &, const string &, char, const string &, float, const string &);
+    Student(const Student &) = delete;
+    ~Student() override = default;
+
+    float GetGpa() const { return gpa; }
+    const string &GetStudentId() const { return studentId; }
+    const CourseSet &GetCourses() const { return courses; }
+    bool IsEnrolled(const Course *c) const { return courses.Contains(c->GetCourseNum()); }   // O(log n)
+
+    void Print() const override;
+    void IsA() const override;
+    void Update() override;
+    bool AddCourse(Course *);
+    void PrintCourses() const;
+};
+
+Student::Student(const string &fn, const string &ln, char mi, const string &t, float avg, const string &id, Course *c) :
+                 Person(fn, ln, mi, t), gpa(avg), studentId(id), waitListedCourse(c)
+{
+    c->Register(this);
+}
+
+Student::Student(const string &fn, const string &ln, char mi, const string &t, float avg, const string &id) :
+                 Person(fn, ln, mi, t), gpa(avg), studentId(id)
+{
+}
+
+void Student::Print() const
+{
+    cout << GetTitle() << " " << GetFirstName() << " ";
+    cout << GetMiddleInitial() << ". " << GetLastName();
+    cout << " with id: " << studentId << " GPA: ";
+    cout << setprecision(3) <<  " " << gpa;
+}
+
+void Student::IsA() const
+{
+    cout << "Student" << endl;
+}
+
+bool Student::AddCourse(Course *c)
+{
+    if (IsEnrolled(c))   // the check left as a TODO in Chp16-Ex1.cpp
+    {
+        cout << GetFirstName() << " " << GetLastName() << " is already enrolled in " << c->GetTitle() << endl;
+        return false;
+    }
+    if (c->AddStudent(this))
+    {
+        courses.Insert(c->GetCourseNum());
+        if (c == waitListedCourse)   // we got a seat directly; leave the waitlist, or Update() would take a second seat
+        {
+            waitListedCourse = nullptr;
+            c->Release(this);
+        }
+        return true;
+    }
+    if (waitListedCourse == nullptr)
+    {
+        c->Register(this);   // Add Student (Observer) to the Course's Waitlist
+        waitListedCourse = c;
+    }
+    return false;
+}
+
+void Student::Update()
+{
+    if (waitListedCourse && ((waitListedCourse->GetState() == CourseState::OpenForEnrollment) ||
+       (waitListedCourse->GetState() == CourseState::NewSpaceAvailable)))
+    {
+        Course *c = waitListedCourse;
+        if (c->AddStudent(this))
+        {
+            courses.Insert(c->GetCourseNum());
+            cout << GetFirstName() << " " << GetLastName() << " removed from waitlist and added to " << c->GetTitle() << endl;
+            SetState(StudentState::AddSuccess);
+            waitListedCourse = nullptr;
+            c->Release(this);
+        }
+    }
+}
+
+void Student::PrintCourses() const
+{
+    cout << "Student: (" << GetFirstName() << " " << GetLastName() << ") enrolled in: " << endl;
+    for (int num : courses)   // in course number order
+        cout << "\t" << Course::Find(num)->GetTitle() << endl;
+}
+
+void Course::PrintStudents() const
+{
+    cout << "Course: (" << GetTitle() << ") has the following students: " << endl;
+    for (int i = 0; i < MAXSTUDENTS && students[i] != nullptr; i++)
+        cout << "\t" << students[i]->GetFirstName() << " " << students[i]->GetLastName() << endl;
+}
+
+// Conflict detection across the whole student body: report every Student enrolled in more than one of a
+// group of mutually exclusive courses (e.g. sections which meet at the same time)
+int CountConflicts(const vector<const CourseSet *> &body, const CourseSet &exclusive)
+{
+    int conflicts = 0;
+    for (auto *cs : body)
+    {
+        int hits = 0;
+        for (int num : exclusive)
+            hits += cs->Contains(num);
+        conflicts += (hits > 1);
+    }
+    return conflicts;
+}
+
+
+// Benchmark: add 10 random courses (with a duplicate check) to each of numStudents course lists, then run
+// membership tests and a conflict scan. We compare CourseSet to a fixed array scanned linearly, as in Chp16-Ex1.cpp.
+// Note that at 10 entries a linear scan is still very competitive; CourseSet's gains are that it has no fixed limit,
+// keeps lookups logarithmic as the number of courses grows, and keeps courses in order for merge-style comparisons.
+constexpr int BENCHCOURSES = 10, NUMCOURSENUMBERS = 5000;
+
+struct FixedCourses   // the Chp16-Ex1.cpp layout: an array filled in order, searched linearly
+{
+    int courses[BENCHCOURSES];
+    int count = 0;
+    bool Contains(int num) const { return std::find(courses, courses + count, num) != courses + count; }
+    bool Insert(int num)
+    {
+        if (count == BENCHCOURSES || Contains(num))
+            return false;
+        courses[count++] = num;
+        return true;
+    }
+};
+
+template <class Courses>
+void Benchmark(const string &label, int numStudents)
+{
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::duration;
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int> pick(0, NUMCOURSENUMBERS - 1);
+
+    vector<Courses> body(numStudents);
+    auto start = Clock::now();
+    long added = 0;
+    for (auto &cs : body)
+        for (int i = 0; i < BENCHCOURSES; )
+            if (cs.Insert(pick(rng)))   // retry duplicates, so that each Student ends up with 10 courses
+            {
+                added++;
+                i++;
+            }
+    double addSec = duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    long found = 0;
+    for (auto &cs : body)
+        for (int i = 0; i < BENCHCOURSES; i++)
+            found += cs.Contains(pick(rng));
+    double lookupSec = duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    long conflicts = 0;
+    const int exclusive[] = { 230, 231, 232 };   // three sections of the same course, meeting at the same time
+    for (auto &cs : body)
+        conflicts += (cs.Contains(exclusive[0]) + cs.Contains(exclusive[1]) + cs.Contains(exclusive[2])) > 1;
+    double conflictSec = duration<double>(Clock::now() - start).count();
+
+    cout << std::left << std::setw(14) << label << std::right << std::fixed << setprecision(0)
+         << " add: " << std::setw(10) << added / addSec << " courses/sec"
+         << "  lookup: " << std::setw(10) << (static_cast<double>(numStudents) * BENCHCOURSES) / lookupSec << " /sec"
+         << "  conflict scan: " << setprecision(1) << conflictSec * 1000 << " ms (" << conflicts << " found)"
+         << "  " << sizeof(Courses) << " bytes/Student (" << found << " hits)" << endl;
+    cout.unsetf(std::ios::fixed);
+    cout << setprecision(6);
+}
+
+
+int main(int argc, char *argv[])
+{
+    Course *c1 = new Course("C++", 230);
+    Course *c2 = new Course("Advanced C++", 430);
+    Course *c3 = new Course("C++ Design Patterns", 550);
+    Student s1("Anne", "Chu", 'M', "Ms.", 3.9, "66TU", c1);
+    Student s2("Joley", "Putt", 'I', "Ms.", 3.1, "585UD", c1);
+    Student s3("Goeff", "Curt", 'K', "Mr.", 3.1, "667UD", c1);
+
+    cout << "Registration is Open" << endl;
+    c1->Open();
+    c2->Open();
+    c3->Open();
+
+    s1.AddCourse(c3);   // courses are kept in course number order, regardless of the order in which they are added
+    s1.AddCourse(c2);
+    s1.AddCourse(c2);   // duplicate enrollment is now detected
+    s2.AddCourse(c2);
+    Student s4("Ling", "Mau", 'I', "Ms.", 3.1, "55TU", c2);   // joins c2's waitlist, then gets a seat directly
+    s4.AddCourse(c2);   // ... and so leaves the waitlist: re-opening c2 does not add her a second time
+    c2->Open();
+
+    c2->PrintStudents();
+    s1.PrintCourses();
+    s2.PrintCourses();
+
+    CourseSet advanced;   // Students may not take Advanced C++ and C++ Design Patterns in the same term
+    advanced.Insert(c2->GetCourseNum());
+    advanced.Insert(c3->GetCourseNum());
+    vector<const CourseSet *> body { &s1.GetCourses(), &s2.GetCourses(), &s3.GetCourses() };
+    cout << "Students with conflicting enrollments: " << CountConflicts(body, advanced) << endl;
+
+    delete c1;
+    delete c2;
+    delete c3;
+
+    int numStudents = argc > 1 ? std::stoi(argv[1]) : 10000000;
+    cout << endl << "Benchmark: " << BENCHCOURSES << " courses each for " << numStudents << " Students" << endl;
+    Benchmark<FixedCourses>("fixed array", numStudents);
+    Benchmark<CourseSet>("CourseSet", numStudents);
+
+    return 0;
+}
@@ -0,0 +1,612 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate a Subject and Observer which are safe to use from many threads without a global lock.
+// In Chp16-Ex1.cpp, numObservers, subjectState and observerState are plain ints. Here, they are atomics
+// written with release and read with acquire semantics. Each Subject state change is given a sequence number,
+// packed together with the state in a single atomic word, so that an Observer can tell that a notification is
+// stale (it has already seen a newer state) and skip it. Contention counters are kept for monitoring.
+// The observer list itself is guarded by a lock per Subject (there is no lock shared between Subjects).
+// Compile with: g++ -std=c++17 -O2 -pthread Chp16-Ex6.cpp
+// To run the stress test under ThreadSanitizer: g++ -std=c++17 -O1 -g -fsanitize=thread -pthread Chp16-Ex6.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <list>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <algorithm>
+
+using std::cout;   // prefered to: using namespace std;
+using std::endl;
+using std::setprecision;
+using std::string;
+using std::to_string;
+using std::list;
+using std::vector;
+using std::thread;
+using std::mutex;
+using std::atomic;
+using std::uint32_t;
+using std::uint64_t;
+using std::unique_ptr;
+using std::make_unique;
+using std::memory_order_acquire;
+using std::memory_order_release;
+using std::memory_order_relaxed;
+using std::memory_order_acq_rel;
+
+constexpr int MAXCOURSES = 5, MAXSTUDENTS = 5;
+
+enum State { Initial = 0, Success = 1, Failure = 2 };
+enum StudentState { AddSuccess = State::Success, AddFailure = State::Failure };
+enum CourseState { OpenForEnrollment = State::Success, NewSpaceAvailable = State::Success, Full = State::Failure };
+
+// A state together with the sequence number of the change which produced it
+struct StateChange
+{
+    int state = State::Initial;
+    uint32_t sequence = 0;
+};
+
+class Subject;  // forward declarations
+class Student;
+
+class Observer
+{
+private:
+    atomic<int> observerState {State::Initial};
+    atomic<uint32_t> lastSeen {0};     // sequence number of the newest Subject state we have acted upon
+    atomic<long> staleSkipped {0};
+protected:
+    Observer() = default;
+    Observer(int s): observerState(s) { }
+    void SetState(int s) { observerState.store(s, memory_order_release); }
+    bool IsFresh(const StateChange &);   // true (once) for each newer sequence number
+public:
+    int GetState() const { return observerState.load(memory_order_acquire); }
+    uint32_t GetLastSeen() const { return lastSeen.load(memory_order_acquire); }
+    long GetStaleSkipped() const { return staleSkipped.load(memory_order_relaxed); }
+    virtual ~Observer() = default;
+    virtual void Update() = 0;
+};
+
+// Advance lastSeen to the change's sequence number, unless we have already seen it (or something newer).
+// Two racing notifications for the same change can not both succeed, as only one compare-exchange wins.
+bool Observer::IsFresh(const StateChange &change)
+{
+    uint32_t seen = lastSeen.load(memory_order_acquire);
+    do
+    {
+        if (change.sequence <= seen)
+        {
+            staleSkipped.fetch_add(1, memory_order_relaxed);
+            return false;
+        }
+    } while (!lastSeen.compare_exchange_weak(seen, change.sequence, memory_order_acq_rel, memory_order_acquire));
+    return true;
+}
+
+// Counters for monitoring contention on a Subject
+struct ContentionStats
+{
+    long stateUpdates = 0;
+    long stateRetries = 0;     // failed compare-exchange attempts in SetState()
+    long listLocks = 0;
+    long listContended = 0;    // times the observer list lock was already held by another thread
+};
+
+class Subject
+{
+private:
+    list<Observer *> observers;  // List of Observers (in our application, this will be Students on wait-list)
+    atomic<int> numObservers {0};
+    atomic<uint64_t> subjectState {0};   // high 32 bits: sequence number, low 32 bits: state
+    mutable mutex observerLock;          // per Subject; guards the list only
+    mutable atomic<long> stateUpdates {0}, stateRetries {0}, listLocks {0}, listContended {0};
+    void LockList() const;
+    static uint64_t Pack(int s, uint32_t seq) { return (static_cast<uint64_t>(seq) << 32) | static_cast<uint32_t>(s); }
+protected:
+    Subject() = default;
+    Subject(int s): subjectState(Pack(s, 0)) { }
+    uint32_t SetState(int);   // returns the sequence number of this change
+public:
+    int GetState() const { return GetStateChange().state; }
+    StateChange GetStateChange() const
+    {
+        uint64_t packed = subjectState.load(memory_order_acquire);
+        return { static_cast<int>(static_cast<uint32_t>(packed)), static_cast<uint32_t>(packed >> 32) };
+    }
+    int GetNumObservers() const { return numObservers.load(memory_order_acquire); }
+    bool CountMatchesList() const;   // numObservers agrees with the list (checked under the list lock)
+    ContentionStats GetContentionStats() const
+    {
+        return { stateUpdates.load(memory_order_relaxed), stateRetries.load(memory_order_relaxed),
+                 listLocks.load(memory_order_relaxed), listContended.load(memory_order_relaxed) };
+    }
+    virtual ~Subject() = default;
+    virtual void Register(Observer *);
+    virtual void Release(Observer *);
+    virtual void Notify();
+};
+
+// The state and its sequence number change together, in one compare-exchange, so that a reader never sees
+// a new state paired with an old sequence number (or the reverse)
+uint32_t Subject::SetState(int s)
+{
+    uint64_t current = subjectState.load(memory_order_relaxed);
+    uint64_t next = Pack(s, static_cast<uint32_t>(current >> 32) + 1);
+    while (!subjectState.compare_exchange_weak(current, next, memory_order_release, memory_order_relaxed))
+    {
+        stateRetries.fetch_add(1, memory_order_relaxed);   // another thread changed the state first; try again
+        next = Pack(s, static_cast<uint32_t>(current >> 32) + 1);
+    }
+    stateUpdates.fetch_add(1, memory_order_relaxed);
+    return static_cast<uint32_t>(next >> 32);
+}
+
+void Subject::LockList() const
+{
+    listLocks.fetch_add(1, memory_order_relaxed);
+    if (!observerLock.try_lock())
+    {
+        listContended.fetch_add(1, memory_order_relaxed);
+        observerLock.lock();
+    }
+}
+
+void Subject::Register(Observer *ob)
+{
+    LockList();
+    observers.push_back(ob);
+    numObservers.fetch_add(1, memory_order_release);
+    observerLock.unlock();
+}
+
+void Subject::Release(Observer *ob)
+{
+    LockList();
+    auto iter = std::find(observers.begin(), observers.end(), ob);
+    if (iter != observers.end())
+    {
+        observers.erase(iter);
+        numObservers.fetch_sub(1, memory_order_release);
+    }
+    observerLock.unlock();
+}
+
+bool Subject::CountMatchesList() const
+{
+    LockList();
+    bool match = numObservers.load(memory_order_relaxed) == static_cast<int>(observers.size());
+    observerLock.unlock();
+    return match;
+}
+
+void Subject::Notify()
+{
+    // iterate over a snapshot, so that no lock is held during Update() (which may Release() the Observer)
+    LockList();
+    vector<Observer *> waitList(observers.begin(), observers.end());
+    observerLock.unlock();
+    for (auto *ob : waitList)
+        ob->Update();
+}
+
+
+class Course: public Subject   // over-simplified Course class
+{
+private:
+    string title;
+    int number = 0;
+    Student *students[MAXSTUDENTS] = { };
+    atomic<int> totalStudents {0};
+public:
+    Course(const string &title, int num): title(title), number(num) { }
+    ~Course() override = default;
+    int GetCourseNum() const { return number; }
+    const string &GetTitle() const { return title; }
+    bool AddStudent(Student *);
+    void Open()
+    {
+        SetState(CourseState::OpenForEnrollment);
+        Notify();
+    }
+    void Close() { SetState(CourseState::Full); }
+    int GetTotalStudents() const { return std::min(totalStudents.load(memory_order_acquire), MAXSTUDENTS); }
+    const Student *GetStudent(int seat) const { return students[seat]; }
+    void PrintStudents() const;
+};
+
+// A seat is claimed with a compare-exchange on totalStudents; the Student pointer is then published to its seat.
+// (PrintStudents() is only called once registration is over.)
+bool Course::AddStudent(Student *s)
+{
+    int seat = totalStudents.load(memory_order_relaxed);
+    do
+    {
+        if (seat >= MAXSTUDENTS)
+            return false;
+    } while (!totalStudents.compare_exchange_weak(seat, seat + 1, memory_order_acq_rel, memory_order_relaxed));
+    students[seat] = s;
+    return true;
+}
+
+class Person
+{
+private:
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+protected:
+    void ModifyTitle(const string &);
+public:
+    Person() = default;
+    Person(const string &, const string &, char, const string &);
+    Person(const Person &) = default;
+    virtual ~Person() = default;
+
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+
+    virtual void Print() const;
+    virtual void IsA() const;
+    virtual void Greeting(const string &) const;
+};
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) :
+               firstName(fn), lastName(ln), middleInitial(mi), title(t)
+{
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+    title = newTitle;
+}
+
+void Person::Print() const
+{
+    cout << title << " " << firstName << " ";
+    cout << middleInitial << ". " << lastName << endl;
+}
+
+void Person::IsA() const
+{
+    cout << "Person" << endl;
+}
+
+void Person::Greeting(const string &msg) const
+{
+    cout << msg << endl;
+}
+
+class Student : public Person, public Observer
+{
+private:
+    float gpa = 0.0;
+    const string studentId;
+    int currentNumCourses = 0;
+    Course *courses[MAXCOURSES] = { };
+    atomic<Course *> waitListedCourse {nullptr};   // our Subject in specialized form; cleared only once enrolled
+    atomic<bool> claimed {false};   // set while one Update() tries to enroll us in waitListedCourse
+    static atomic<bool> announce;   // print a message when added from the waitlist (off for the stress test)
+public:
+    Student(const string &, const string &, char, const string &, float, const string &, Course *);
+    Student(const Student &) = delete;
+    ~Student() override = default;
+
+    float GetGpa() const { return gpa; }
+    const string &GetStudentId() const { return studentId; }
+
+    void Print() const override;
+    void IsA() const override;
+    void Update() override;       // overridden from Observer
+    bool AddCourse(Course *);
+    void PrintCourses() const;
+    int CountCourse(const Course *) const;   // how many times we are enrolled in the Course (0 or 1)
+    Course *GetWaitListedCourse() const { return waitListedCourse.load(memory_order_acquire); }
+
+    static void SetAnnounce(bool a) { announce = a; }
+};
+
+atomic<bool> Student::announce {true};
+
+Student::Student(const string &fn, const string &ln, char mi, const string &t, float avg, const string &id, Course *c) :
+                 Person(fn, ln, mi, t), gpa(avg), studentId(id), waitListedCourse(c)
+{
+    c->Register(this);
+}
+
+void Student::Print() const
+{
+    cout << GetTitle() << " " << GetFirstName() << " ";
+    cout << GetMiddleInitial() << ". " << GetLastName();
+    cout << " with id: " << studentId << " GPA: ";
+    cout << setprecision(3) <<  " " << gpa;
+}
+
+void Student::IsA() const
+{
+    cout << "Student" << endl;
+}
+
+bool Student::AddCourse(Course *c)
+{
+    if (currentNumCourses < MAXCOURSES && c->AddStudent(this))
+    {
+        courses[currentNumCourses++] = c;
+        return true;
+    }
+    return false;
+}
+
+void Student::Update()
+{
+    Course *c = waitListedCourse.load(memory_order_acquire);
+    if (!c)
+        return;   // no longer waiting
+    StateChange change = c->GetStateChange();
+    if (!IsFresh(change))   // we have already acted on this (or a newer) state of the Course
+        return;
+    if (change.state != CourseState::OpenForEnrollment)
+        return;
+    // Claim the right to enroll us, so that two concurrent notifications can not both add the Course. If another
+    // Update() (for an older state) holds the claim, it may yet fail to get a seat -- so rather than drop our newer
+    // notification, wait for its outcome and then try ourselves, unless it has enrolled us meanwhile.
+    bool expected = false;
+    while (!claimed.compare_exchange_weak(expected, true, memory_order_acquire, memory_order_relaxed))
+    {
+        expected = false;
+        if (!waitListedCourse.load(memory_order_acquire))
+            return;
+        std::this_thread::yield();
+    }
+    if (waitListedCourse.load(memory_order_relaxed) == c && AddCourse(c))
+    {
+        if (announce)
+            cout << GetFirstName() << " " << GetLastName() << " removed from waitlist and added to " << c->GetTitle() << endl;
+        SetState(StudentState::AddSuccess);
+        c->Release(this);
+        waitListedCourse.store(nullptr, memory_order_release);
+    }
+    // else the Course is full (or we were enrolled by the previous claimant); either way, stay as we are
+    claimed.store(false, memory_order_release);
+}
+
+void Student::PrintCourses() const
+{
+    cout << "Student: (" << GetFirstName() << " " << GetLastName() << ") enrolled in: " << endl;
+    for (int i = 0; i < MAXCOURSES && courses[i] != nullptr; i++)
+        cout << "\t" << courses[i]->GetTitle() << endl;
+}
+
+int Student::CountCourse(const Course *c) const
+{
+    return static_cast<int>(std::count(courses, courses + currentNumCourses, c));
+}
+
+void Course::PrintStudents() const
+{
+    cout << "Course: (" << GetTitle() << ") has the following students: " << endl;
+    for (int i = 0; i < MAXSTUDENTS && students[i] != nullptr; i++)
+        cout << "\t" << students[i]->GetFirstName() << " " << students[i]->GetLastName() << endl;
+}
+
+
+// Test and benchmark support: a Subject which anyone may change, and an Observer which checks that the
+// sequence numbers it acts upon only ever increase
+class TestSubject : public Subject
+{
+public:
+    uint32_t Change(int s) { return SetState(s); }
+};
+
+class SequenceObserver : public Observer
+{
+private:
+    const Subject &subject;
+    atomic<long> acted {0};
+    atomic<bool> wentBackwards {false};
+public:
+    SequenceObserver(const Subject &s): subject(s) { }
+    long GetActed() const { return acted; }
+    bool WentBackwards() const { return wentBackwards; }
+    void Update() override
+    {
+        uint32_t before = GetLastSeen();
+        StateChange change = subject.GetStateChange();
+        if (IsFresh(change))
+        {
+            if (change.sequence <= before)
+                wentBackwards = true;
+            acted++;
+            SetState(change.state);
+        }
+    }
+};
+
+// Stress test, part 1: threads concurrently register and release Observers, change the state, and notify, while
+// a checker thread verifies that numObservers always agrees with the list. Afterwards, only the resident Observers
+// may remain registered, and one last Notify() must bring each of them up to the final state change.
+// Run it under -fsanitize=thread to check for data races.
+bool StressRegistration(int numThreads, int iterations)
+{
+    TestSubject subject;
+    vector<unique_ptr<SequenceObserver>> resident;   // stay registered throughout
+    for (int i = 0; i < 8; i++)
+    {
+        resident.push_back(make_unique<SequenceObserver>(subject));
+        subject.Register(resident.back().get());
+    }
+    // Transient Observers register and release over and over. They must outlive all of the threads, as another
+    // thread's Notify() may still be delivering to one from its snapshot after it has been released.
+    vector<unique_ptr<SequenceObserver>> transients;
+    for (int t = 0; t < numThreads; t++)
+        transients.push_back(make_unique<SequenceObserver>(subject));
+    atomic<bool> running {true};
+    atomic<long> mismatches {0};
+    thread checker([&subject, &running, &mismatches]
+    {
+        while (running.load(memory_order_acquire))
+            if (!subject.CountMatchesList())
+                mismatches++;
+    });
+    vector<thread> threads;
+    for (int t = 0; t < numThreads; t++)
+        threads.emplace_back([&subject, &transients, iterations, t]
+        {
+            SequenceObserver &transient = *transients[t];
+            for (int i = 0; i < iterations; i++)
+            {
+                switch ((i + t) % 4)
+                {
+                case 0: subject.Register(&transient); break;
+                case 1: subject.Change(i % 3); break;
+                case 2: subject.Notify(); break;
+                case 3: subject.Release(&transient); break;
+                }
+            }
+            subject.Release(&transient);   // leave only the resident Observers registered
+        });
+    for (auto &th : threads)
+        th.join();
+    running.store(false, memory_order_release);
+    checker.join();
+
+    bool ok = mismatches == 0 && subject.CountMatchesList() && subject.GetNumObservers() == static_cast<int>(resident.size());
+    subject.Notify();   // every resident Observer must now act on (or have already acted on) the final change
+    uint32_t last = subject.GetStateChange().sequence;
+    long skipped = 0;
+    for (auto &ob : resident)
+    {
+        ok = ok && ob->GetLastSeen() == last;
+        skipped += ob->GetStaleSkipped();
+    }
+    cout << "Registration stress (" << numThreads << " threads x " << iterations << " operations): " << (ok ? "passed" : "FAILED")
+         << ", " << last << " state changes, " << skipped << " stale notifications skipped, "
+         << mismatches << " count mismatches" << endl;
+    return ok;
+}
+
+// Stress test, part 2: a waitlist of three times as many Students as there are seats, while several threads
+// Open() the Course at once (and again, and again). Every seat must be filled by a different Student, each
+// Student enrolled must hold the Course exactly once and have left the waitlist, and everyone else must remain on it.
+bool StressEnrollment(int numThreads, int rounds)
+{
+    constexpr int numStudents = 3 * MAXSTUDENTS;
+    bool ok = true;
+    for (int r = 0; r < rounds && ok; r++)
+    {
+        Course course("C++", 230);
+        vector<unique_ptr<Student>> waitList;
+        for (int i = 0; i < numStudents; i++)
+            waitList.push_back(make_unique<Student>("First", "Last", 'M', "Ms.", 3.5, to_string(i) + "ID", &course));
+        atomic<int> ready {0};   // start the openers together, so that their notifications overlap
+        vector<thread> openers;
+        for (int t = 0; t < numThreads; t++)
+            openers.emplace_back([&course, &ready, numThreads]
+            {
+                ready++;
+                while (ready.load(memory_order_acquire) < numThreads)
+                    std::this_thread::yield();
+                for (int i = 0; i < 4; i++)
+                    course.Open();
+            });
+        for (auto &th : openers)
+            th.join();
+
+        ok = ok && course.GetTotalStudents() == MAXSTUDENTS;
+        for (int seat = 0; ok && seat < MAXSTUDENTS; seat++)   // no Student holds two seats
+            for (int other = 0; other < seat; other++)
+                ok = ok && course.GetStudent(seat) != nullptr && course.GetStudent(seat) != course.GetStudent(other);
+        int enrolled = 0;
+        for (auto &s : waitList)
+        {
+            int held = s->CountCourse(&course);
+            enrolled += held;
+            ok = ok && held <= 1 && (held == 1) == (s->GetWaitListedCourse() == nullptr);
+        }
+        ok = ok && enrolled == MAXSTUDENTS && course.GetNumObservers() == numStudents - MAXSTUDENTS && course.CountMatchesList();
+    }
+    cout << "Enrollment stress (" << numThreads << " threads x " << rounds << " rounds): " << (ok ? "passed" : "FAILED") << endl;
+    return ok;
+}
+
+// Benchmark: each thread mixes reads of the state (the common case) with state changes and registrations
+void Benchmark(int numThreads, int iterations)
+{
+    using Clock = std::chrono::steady_clock;
+    TestSubject subject;
+    auto start = Clock::now();
+    vector<thread> threads;
+    atomic<long> sink {0};
+    for (int t = 0; t < numThreads; t++)
+        threads.emplace_back([&subject, &sink, iterations]
+        {
+            SequenceObserver ob(subject);
+            long sum = 0;
+            for (int i = 0; i < iterations; i++)
+            {
+                sum += subject.GetStateChange().state;   // 7 reads ...
+                if (i % 8 == 0)
+                    subject.Change(i & 1);              // ... for each write
+                if (i % 64 == 0)
+                {
+                    subject.Register(&ob);
+                    subject.Release(&ob);
+                }
+            }
+            sink += sum;
+        });
+    for (auto &th : threads)
+        th.join();
+    double sec = std::chrono::duration<double>(Clock::now() - start).count();
+    ContentionStats stats = subject.GetContentionStats();
+    cout << std::setw(3) << numThreads << " threads: " << std::fixed << setprecision(0)
+         << std::setw(12) << numThreads * static_cast<double>(iterations) / sec << " ops/sec"
+         << "  SetState retries: " << std::setw(8) << stats.stateRetries << " / " << stats.stateUpdates
+         << "  list lock contended: " << std::setw(6) << stats.listContended << " / " << stats.listLocks << endl;
+    cout.unsetf(std::ios::fixed);
+    cout << setprecision(6);
+}
+
+
+int main()
+{
+    Course *c1 = new Course("C++", 230);
+    Student s1("Anne", "Chu", 'M', "Ms.", 3.9, "66TU", c1);
+    Student s2("Joley", "Putt", 'I', "Ms.", 3.1, "585UD", c1);
+    Student s3("Goeff", "Curt", 'K', "Mr.", 3.1, "667UD", c1);
+
+    cout << "Registration is Open" << endl;
+    // Open the Course from several threads at once; each Student acts on the opening exactly once
+    vector<thread> openers;
+    for (int i = 0; i < 3; i++)
+        openers.emplace_back([c1] { c1->Open(); });
+    for (auto &th : openers)
+        th.join();
+    c1->Notify();   // a late, duplicate notification of the same state is recognized as stale by any remaining Observer
+
+    c1->PrintStudents();
+    s1.PrintCourses();
+    cout << "Course state sequence number: " << c1->GetStateChange().sequence
+         << ", waitlist: " << c1->GetNumObservers() << endl;
+    delete c1;
+
+    cout << endl;
+    Student::SetAnnounce(false);
+    bool ok = StressRegistration(8, 20000);
+    ok = StressEnrollment(8, 500) && ok;
+
+    cout << endl << "Contention benchmark" << endl;
+    for (int threads : { 1, 2, 4, 8 })
+        Benchmark(threads, 1000000);
+
+    return ok ? 0 : 1;
+}
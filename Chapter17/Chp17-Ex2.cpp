@@ -288,6 +288,7 @@ public:
         return new UnderGradStudent(degree, fn, ln, mi, t, avg, course, id);
     else if (!degree.compare("None"))
         return new NonDegreeStudent(fn, ln, mi, t, avg, course, id);
+    return nullptr;   // unknown degree (falling off the end here would be undefined behavior)
     }
 
 };
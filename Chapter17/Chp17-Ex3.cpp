@@ -0,0 +1,436 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate a table-driven, registration-based Factory Method.
+// In Chp17-Ex2.cpp, StudentFactory::MatriculateStudent() chooses the Concrete Product with a chain of
+// degree.compare() calls. Here, each Concrete Product registers a constructor "thunk" for the degree codes it
+// handles. The thunks live in a table indexed by a perfect hash of the degree code; the hash seed is found at
+// compile time and checked with static_assert, so dispatch is a hash, one table load and one short string compare.
+// An unknown degree produces an error value rather than undefined behavior.
+// Compile with: g++ -std=c++17 -O2 Chp17-Ex3.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <string_view>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <random>
+
+using std::cout;    // preferred to: using namespace std;
+using std::endl;
+using std::setprecision;
+using std::string;
+using std::string_view;
+using std::to_string;
+using std::array;
+using std::vector;
+using std::uint32_t;
+
+constexpr int MAX = 4;
+
+class Person
+{
+private:
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+protected:
+    void ModifyTitle(const string &);
+public:
+    Person() = default;   // default constructor
+    Person(const string &, const string &, char, const string &);
+    virtual ~Person() = default;  // virtual destructor
+
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+
+    virtual void Print() const;
+    virtual string IsA() const;
+    virtual void Greeting(const string &) const;
+};
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) :
+               firstName(fn), lastName(ln), middleInitial(mi), title(t)
+{
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+    title = newTitle;
+}
+
+void Person::Print() const
+{
+    cout << title << " " << firstName << " ";
+    cout << middleInitial << ". " << lastName << endl;
+}
+
+string Person::IsA() const
+{
+    return "Person";
+}
+
+void Person::Greeting(const string &msg) const
+{
+    cout << msg << endl;
+}
+
+
+// Student is an Abstract class (see pure virtual Graduate() method)
+class Student : public Person
+{
+private:
+    float gpa = 0.0;   // in-class initialization
+    string currentCourse;
+    const string studentId;
+    static int numStudents;
+public:
+    Student();  // default constructor
+    Student(const string &, const string &, char, const string &, float, const string &, const string &);
+    Student(const Student &);  // copy constructor
+    ~Student() override;  // virtual destructor
+    float GetGpa() const { return gpa; }
+    const string &GetCurrentCourse() const { return currentCourse; }
+    const string &GetStudentId() const { return studentId; }
+
+    void Print() const override;
+    string IsA() const override { return "Student"; }
+    virtual void Graduate() = 0;  // Now Student is abstract
+
+    static int GetNumStudents() { return numStudents; }
+};
+
+int Student::numStudents = 0;
+
+Student::Student() : studentId(to_string(numStudents + 100) + "Id")
+{
+   numStudents++;
+}
+
+Student::Student(const string &fn, const string &ln, char mi, const string &t, float avg, const string &course, const string &id) :
+                 Person(fn, ln, mi, t), gpa(avg), currentCourse(course), studentId(id)
+{
+   numStudents++;
+}
+
+Student::Student(const Student &s) : Person(s), gpa(s.gpa), currentCourse(s.currentCourse), studentId(s.studentId)
+{
+   numStudents++;
+}
+
+Student::~Student()
+{
+   numStudents--;
+}
+
+void Student::Print() const
+{
+    cout << "  " << GetTitle() << " " << GetFirstName() << " ";
+    cout << GetMiddleInitial() << ". " << GetLastName();
+    cout << " with id: " << studentId << " GPA: ";
+    cout << setprecision(3) <<  " " << gpa;
+    cout << " Course: " << currentCourse << endl;
+}
+
+
+// The signature shared by every constructor thunk in the factory table
+using StudentThunk = Student *(*)(const string &, const string &, const string &, char, const string &,
+                                  float, const string &, const string &);
+
+enum class MatriculationError { None = 0, UnknownDegree, NotRegistered };
+
+// The result of MatriculateStudent(): either a new Student, or the reason that none could be made
+struct Matriculation
+{
+    Student *student = nullptr;
+    MatriculationError error = MatriculationError::None;
+    explicit operator bool() const { return student != nullptr; }
+};
+
+// Every degree code the university recognizes. The perfect hash is computed over exactly these codes.
+constexpr array<string_view, 6> degreeCodes = { "PhD", "MS", "MA", "BS", "BA", "None" };
+constexpr uint32_t TABLEBITS = 3, TABLESIZE = 1u << TABLEBITS;   // a power of 2 >= the number of codes
+
+// FNV-1a, with a seed as the offset basis. The top bits are used, as the low bits of a product mix poorly.
+constexpr uint32_t HashDegree(string_view code, uint32_t seed)
+{
+    uint32_t h = seed;
+    for (char c : code)
+        h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+    return h >> (32 - TABLEBITS);
+}
+
+constexpr bool IsPerfect(uint32_t seed)
+{
+    bool used[TABLESIZE] = { };
+    for (auto code : degreeCodes)
+    {
+        uint32_t slot = HashDegree(code, seed);
+        if (used[slot])
+            return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t FindSeed()
+{
+    uint32_t seed = 2166136261u;   // the usual FNV offset basis; keep trying until no two codes collide
+    while (!IsPerfect(seed))
+        seed++;
+    return seed;
+}
+
+constexpr uint32_t HASHSEED = FindSeed();
+static_assert(IsPerfect(HASHSEED), "degree code hash must be collision-free");
+
+class StudentFactory
+{
+private:
+    struct Entry
+    {
+        string_view code;
+        StudentThunk thunk = nullptr;
+    };
+    static array<Entry, TABLESIZE> table;
+    static constexpr array<Entry, TABLESIZE> MakeTable();
+public:
+    // Called (once per degree code) by each Concrete Product; returns false for a code the university does not offer
+    static bool Register(string_view code, StudentThunk thunk)
+    {
+        Entry &e = table[HashDegree(code, HASHSEED)];
+        if (e.code != code)
+            return false;
+        e.thunk = thunk;
+        return true;
+    }
+    // O(1): one hash, one table load, and a compare against a single candidate code
+    static StudentThunk Find(string_view degree)
+    {
+        const Entry &e = table[HashDegree(degree, HASHSEED)];
+        return e.code == degree ? e.thunk : nullptr;
+    }
+    // Creates a student based on the degree they seek
+    static Matriculation MatriculateStudent(const string &degree, const string &fn, const string &ln, char mi,
+                                            const string &t, float avg, const string &course, const string &id)
+    {
+        const Entry &e = table[HashDegree(degree, HASHSEED)];
+        if (e.code != degree)
+            return { nullptr, MatriculationError::UnknownDegree };
+        if (!e.thunk)
+            return { nullptr, MatriculationError::NotRegistered };
+        return { e.thunk(degree, fn, ln, mi, t, avg, course, id), MatriculationError::None };
+    }
+};
+
+// The table starts with each code in its (compile-time computed) slot and no thunk
+constexpr array<StudentFactory::Entry, TABLESIZE> StudentFactory::MakeTable()
+{
+    array<Entry, TABLESIZE> t { };
+    for (auto code : degreeCodes)
+        t[HashDegree(code, HASHSEED)].code = code;
+    return t;
+}
+
+array<StudentFactory::Entry, TABLESIZE> StudentFactory::table = MakeTable();
+
+
+class GradStudent : public Student
+{
+private:
+    string degree;  // PhD, MS, MA, etc.
+public:
+    GradStudent() = default;
+    GradStudent(const string &, const string &, const string &, char, const string &, float, const string &, const string &);
+    void EarnPhD();
+    string IsA() const override { return "GradStudent"; }
+    void Graduate() override;
+    static Student *Create(const string &deg, const string &fn, const string &ln, char mi, const string &t,
+                           float avg, const string &course, const string &id)
+    {
+        return new GradStudent(deg, fn, ln, mi, t, avg, course, id);
+    }
+};
+
+GradStudent::GradStudent(const string &deg, const string &fn, const string &ln, char mi,
+                 const string &t, float avg, const string &course, const string &id) :
+                 Student(fn, ln, mi, t, avg, course, id), degree(deg)
+{
+}
+
+void GradStudent::EarnPhD()
+{
+    if (!degree.compare("PhD"))   // only PhD candidates can EarnPhD()
+        ModifyTitle("Dr.");       // not MA and MS candidates
+}
+
+void GradStudent::Graduate()
+{
+    EarnPhD();
+    cout << "GradStudent::Graduate()" << endl;
+}
+
+// Each Concrete Product registers its own thunk with the factory; the factory need not know about it
+static const bool gradRegistered = StudentFactory::Register("PhD", GradStudent::Create) &&
+                                   StudentFactory::Register("MS", GradStudent::Create) &&
+                                   StudentFactory::Register("MA", GradStudent::Create);
+
+class UnderGradStudent : public Student
+{
+private:
+    string degree;  // BS, BA, etc
+public:
+    UnderGradStudent() = default;
+    UnderGradStudent(const string &, const string &, const string &, char, const string &,
+                     float, const string &, const string &);
+    string IsA() const override { return "UnderGradStudent"; }
+    void Graduate() override;
+    static Student *Create(const string &deg, const string &fn, const string &ln, char mi, const string &t,
+                           float avg, const string &course, const string &id)
+    {
+        return new UnderGradStudent(deg, fn, ln, mi, t, avg, course, id);
+    }
+};
+
+UnderGradStudent::UnderGradStudent(const string &deg, const string &fn, const string &ln, char mi,
+                 const string &t, float avg, const string &course, const string &id) :
+                 Student(fn, ln, mi, t, avg, course, id), degree(deg)
+{
+}
+
+void UnderGradStudent::Graduate()
+{
+    cout << "UnderGradStudent::Graduate()" << endl;
+}
+
+static const bool underGradRegistered = StudentFactory::Register("BS", UnderGradStudent::Create) &&
+                                        StudentFactory::Register("BA", UnderGradStudent::Create);
+
+class NonDegreeStudent : public Student
+{
+public:
+    NonDegreeStudent() = default;
+    NonDegreeStudent(const string &, const string &, char, const string &, float, const string &, const string &);
+    string IsA() const override { return "NonDegreeStudent"; }
+    void Graduate() override;
+    static Student *Create(const string &, const string &fn, const string &ln, char mi, const string &t,
+                           float avg, const string &course, const string &id)
+    {
+        return new NonDegreeStudent(fn, ln, mi, t, avg, course, id);   // no degree to pass along
+    }
+};
+
+NonDegreeStudent::NonDegreeStudent(const string &fn, const string &ln, char mi,
+                 const string &t, float avg, const string &course, const string &id) :
+                 Student(fn, ln, mi, t, avg, course, id)
+{
+}
+
+void NonDegreeStudent::Graduate()
+{
+    cout << "NonDegreeStudent::Graduate()" << endl;
+}
+
+static const bool nonDegreeRegistered = StudentFactory::Register("None", NonDegreeStudent::Create);
+
+
+// The dispatch used in Chp17-Ex2.cpp, returning a thunk so that it can be timed against StudentFactory::Find()
+StudentThunk FindByCompare(const string &degree)
+{
+    if (!degree.compare("PhD") || !degree.compare("MS") || !degree.compare("MA"))
+        return GradStudent::Create;
+    else if (!degree.compare("BS") || !degree.compare("BA"))
+        return UnderGradStudent::Create;
+    else if (!degree.compare("None"))
+        return NonDegreeStudent::Create;
+    return nullptr;
+}
+
+// Benchmark: dispatch (only) on millions of degree codes, in the mix we see in matriculation rows,
+// then dispatch plus construction for a smaller number of rows
+void Benchmark(int numRows)
+{
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::duration;
+    const string mix[] = { "BS", "BA", "BS", "BA", "MS", "MA", "PhD", "None", "BS", "MBA" };   // MBA: not offered
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int> pick(0, 9);
+    vector<string> degrees(numRows);
+    for (auto &d : degrees)
+        d = mix[pick(rng)];
+
+    auto time = [&degrees](auto find, const char *label)
+    {
+        auto start = Clock::now();
+        long found = 0;
+        for (const auto &d : degrees)
+            found += (find(d) != nullptr);
+        double sec = duration<double>(Clock::now() - start).count();
+        cout << "  " << std::left << std::setw(16) << label << std::right << std::fixed << setprecision(0)
+             << std::setw(12) << degrees.size() / sec << " dispatches/sec (" << found << " known)" << endl;
+        cout.unsetf(std::ios::fixed);
+    };
+    cout << "Dispatch only, " << numRows << " rows" << endl;
+    time(FindByCompare, "compare chain");
+    time(StudentFactory::Find, "perfect hash");
+
+    constexpr int constructRows = 1000000;
+    cout << "Dispatch and construct, " << constructRows << " rows" << endl;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        auto start = Clock::now();
+        long made = 0;
+        for (int i = 0; i < constructRows; i++)
+        {
+            const string &d = degrees[i];
+            StudentThunk thunk = pass == 0 ? FindByCompare(d) : StudentFactory::Find(d);
+            if (thunk)
+            {
+                delete thunk(d, "Ana", "Sato", 'U', "Ms.", 3.8, "C++", "178PSU");
+                made++;
+            }
+        }
+        double sec = duration<double>(Clock::now() - start).count();
+        cout << "  " << std::left << std::setw(16) << (pass == 0 ? "compare chain" : "perfect hash") << std::right
+             << std::fixed << setprecision(0) << std::setw(12) << made / sec << " Students/sec" << endl;
+        cout.unsetf(std::ios::fixed);
+    }
+    cout << setprecision(6);
+}
+
+
+int main()
+{
+    Student *scholars[MAX] = { };  // will be initialized to nullptrs
+
+    const string degrees[MAX] = { "PhD", "BS", "None", "MBA" };   // the last is not offered -- we get an error value
+    const string firstNames[MAX] = { "Sara", "Ana", "Elle", "Rob" };
+    for (int i = 0; i < MAX; i++)
+    {
+        Matriculation m = StudentFactory::MatriculateStudent(degrees[i], firstNames[i], "Kato", 'B', "Ms.", 3.9, "C++", "272PSU");
+        if (m)
+            scholars[i] = m.student;
+        else
+            cout << "Could not matriculate " << firstNames[i] << ": degree '" << degrees[i] << "' is "
+                 << (m.error == MatriculationError::UnknownDegree ? "unknown" : "not registered") << endl;
+    }
+
+    for (auto *oneStudent : scholars)
+    {
+       if (!oneStudent)
+           continue;
+       oneStudent->Graduate();
+       oneStudent->Print();
+    }
+
+    for (auto *oneStudent : scholars)
+       delete oneStudent; // engage virtual dest. sequence (deleting a nullptr is harmless)
+
+    cout << endl;
+    Benchmark(10000000);
+
+    return 0;
+}
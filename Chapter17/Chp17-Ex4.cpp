@@ -0,0 +1,562 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate a batch matriculation pipeline built around the Factory Method.
+// In Chp17-Ex2.cpp, each Student is made by a separate MatriculateStudent() call with eight arguments.
+// Here, a feed of applicants in CSV form flows through three pipelined stages, each running on its own thread(s):
+//    parse     -- split the text into rows of fields (string_views into the text; nothing is copied)
+//    validate  -- check each row, and decide which Concrete Product it becomes
+//    construct -- one thread per Concrete Product builds the objects into that product's own Arena
+// Stages are connected by bounded queues of batches. Throughput is measured for each stage and end to end.
+// Compile with: g++ -std=c++17 -O2 -pthread Chp17-Ex4.cpp
+// Run with: ./a.out [numRows]   (the benchmark defaults to 10000000 rows and needs roughly 2GB of memory)
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <charconv>
+#include <cstdio>
+
+using std::cout;    // preferred to: using namespace std;
+using std::endl;
+using std::setprecision;
+using std::string;
+using std::string_view;
+using std::to_string;
+using std::vector;
+using std::deque;
+using std::unique_ptr;
+using std::shared_ptr;
+using std::make_unique;
+using std::make_shared;
+using std::thread;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::condition_variable;
+using std::atomic;
+
+class Person
+{
+private:
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+protected:
+    void ModifyTitle(const string &);
+public:
+    Person() = default;   // default constructor
+    Person(const string &, const string &, char, const string &);
+    virtual ~Person() = default;  // virtual destructor
+
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+
+    virtual void Print() const;
+    virtual string IsA() const;
+    virtual void Greeting(const string &) const;
+};
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) :
+               firstName(fn), lastName(ln), middleInitial(mi), title(t)
+{
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+    title = newTitle;
+}
+
+void Person::Print() const
+{
+    cout << title << " " << firstName << " ";
+    cout << middleInitial << ". " << lastName << endl;
+}
+
+string Person::IsA() const
+{
+    return "Person";
+}
+
+void Person::Greeting(const string &msg) const
+{
+    cout << msg << endl;
+}
+
+
+// Student is an Abstract class (see pure virtual Graduate() method)
+class Student : public Person
+{
+private:
+    float gpa = 0.0;   // in-class initialization
+    string currentCourse;
+    const string studentId;
+    static atomic<int> numStudents;   // atomic, as Students are now constructed on several threads at once
+public:
+    Student(const string &, const string &, char, const string &, float, const string &, const string &);
+    Student(const Student &) = delete;
+    ~Student() override;
+    float GetGpa() const { return gpa; }
+    const string &GetCurrentCourse() const { return currentCourse; }
+    const string &GetStudentId() const { return studentId; }
+
+    void Print() const override;
+    string IsA() const override { return "Student"; }
+    virtual void Graduate() = 0;  // Now Student is abstract
+
+    static int GetNumStudents() { return numStudents; }
+};
+
+atomic<int> Student::numStudents {0};
+
+Student::Student(const string &fn, const string &ln, char mi, const string &t, float avg, const string &course, const string &id) :
+                 Person(fn, ln, mi, t), gpa(avg), currentCourse(course), studentId(id)
+{
+   numStudents++;
+}
+
+Student::~Student()
+{
+   numStudents--;
+}
+
+void Student::Print() const
+{
+    cout << "  " << GetTitle() << " " << GetFirstName() << " ";
+    cout << GetMiddleInitial() << ". " << GetLastName();
+    cout << " with id: " << studentId << " GPA: ";
+    cout << setprecision(3) <<  " " << gpa;
+    cout << " Course: " << currentCourse << endl;
+}
+
+class GradStudent : public Student
+{
+private:
+    string degree;  // PhD, MS, MA, etc.
+public:
+    GradStudent(const string &, const string &, const string &, char, const string &, float, const string &, const string &);
+    void EarnPhD() { if (!degree.compare("PhD")) ModifyTitle("Dr."); }
+    string IsA() const override { return "GradStudent"; }
+    void Graduate() override { EarnPhD(); cout << "GradStudent::Graduate()" << endl; }
+};
+
+GradStudent::GradStudent(const string &deg, const string &fn, const string &ln, char mi,
+                 const string &t, float avg, const string &course, const string &id) :
+                 Student(fn, ln, mi, t, avg, course, id), degree(deg)
+{
+}
+
+class UnderGradStudent : public Student
+{
+private:
+    string degree;  // BS, BA, etc
+public:
+    UnderGradStudent(const string &, const string &, const string &, char, const string &, float, const string &, const string &);
+    string IsA() const override { return "UnderGradStudent"; }
+    void Graduate() override { cout << "UnderGradStudent::Graduate()" << endl; }
+};
+
+UnderGradStudent::UnderGradStudent(const string &deg, const string &fn, const string &ln, char mi,
+                 const string &t, float avg, const string &course, const string &id) :
+                 Student(fn, ln, mi, t, avg, course, id), degree(deg)
+{
+}
+
+class NonDegreeStudent : public Student
+{
+public:
+    NonDegreeStudent(const string &, const string &, char, const string &, float, const string &, const string &);
+    string IsA() const override { return "NonDegreeStudent"; }
+    void Graduate() override { cout << "NonDegreeStudent::Graduate()" << endl; }
+};
+
+NonDegreeStudent::NonDegreeStudent(const string &fn, const string &ln, char mi,
+                 const string &t, float avg, const string &course, const string &id) :
+                 Student(fn, ln, mi, t, avg, course, id)
+{
+}
+
+
+// Arena keeps objects of a single type in large blocks, constructed in place. There is one allocation
+// per block rather than one per object, and all of the objects are destroyed together with the Arena.
+template <class Type>
+class Arena
+{
+private:
+    static constexpr size_t BLOCKSIZE = 4096;   // objects per block
+    struct Block
+    {
+        alignas(Type) unsigned char storage[BLOCKSIZE * sizeof(Type)];
+    };
+    vector<unique_ptr<Block>> blocks;
+    size_t count = 0;
+    Type *Slot(size_t i) const { return reinterpret_cast<Type *>(blocks[i / BLOCKSIZE]->storage) + i % BLOCKSIZE; }
+public:
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    ~Arena()
+    {
+        for (size_t i = 0; i < count; i++)
+            Slot(i)->~Type();
+    }
+    template <class... Args>
+    Type *Emplace(Args &&... args)
+    {
+        if (count == blocks.size() * BLOCKSIZE)
+            blocks.push_back(make_unique<Block>());
+        Type *obj = new (Slot(count)) Type(std::forward<Args>(args)...);
+        count++;
+        return obj;
+    }
+    size_t Size() const { return count; }
+    Type &operator[](size_t i) { return *Slot(i); }
+};
+
+// A bounded, blocking queue connecting two stages of the pipeline. Close() signals the end of the stream.
+template <class Item>
+class BoundedQueue
+{
+private:
+    deque<Item> items;
+    size_t capacity;
+    bool closed = false;
+    mutex lock;
+    condition_variable notFull, notEmpty;
+public:
+    explicit BoundedQueue(size_t cap) : capacity(cap) { }
+    void Push(Item item)
+    {
+        unique_lock<mutex> guard(lock);
+        notFull.wait(guard, [this] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+    bool Pop(Item &item)   // returns false once the queue is closed and drained
+    {
+        unique_lock<mutex> guard(lock);
+        notEmpty.wait(guard, [this] { return closed || !items.empty(); });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+    void Close()
+    {
+        lock_guard<mutex> guard(lock);
+        closed = true;
+        notEmpty.notify_all();
+    }
+};
+
+enum class Product { Grad = 0, UnderGrad, NonDegree, NumProducts };
+constexpr int NUMPRODUCTS = static_cast<int>(Product::NumProducts);
+
+// One applicant row; the fields refer into the batch's text
+struct ApplicantRow
+{
+    string_view degree, firstName, lastName, title, course, id;
+    char middleInitial = '\0';
+    float gpa = 0.0f;
+    Product product = Product::Grad;   // decided by the validate stage
+};
+
+struct Batch
+{
+    shared_ptr<const string> text;   // shared, as a batch is split among the construct threads
+    vector<ApplicantRow> rows;
+};
+
+// Timing for one stage: rows processed, and time spent working (not waiting on a queue)
+struct StageMetrics
+{
+    string name;
+    atomic<long> rows {0};
+    atomic<long> busyNanos {0};
+    void Add(long n, std::chrono::steady_clock::duration busy)
+    {
+        rows += n;
+        busyNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count();
+    }
+};
+
+// The source of applicant text: fills in the next chunk of whole CSV lines; returns false at the end of the feed
+using ApplicantSource = std::function<bool(string &)>;
+
+// Reads a stream in chunks of about chunkSize bytes, always ending a chunk on a line boundary
+ApplicantSource StreamSource(std::istream &in, size_t chunkSize = 1 << 20)
+{
+    return [&in, chunkSize](string &chunk)
+    {
+        chunk.clear();
+        string line;
+        while (chunk.size() < chunkSize && std::getline(in, line))
+        {
+            chunk += line;
+            chunk += '\n';
+        }
+        return !chunk.empty();
+    };
+}
+
+class MatriculationPipeline
+{
+private:
+    Arena<GradStudent> grads;
+    Arena<UnderGradStudent> underGrads;
+    Arena<NonDegreeStudent> nonDegrees;
+    StageMetrics parse {"parse"}, validate {"validate"}, construct {"construct"};
+    atomic<long> rejected {0};
+
+    static bool SplitRow(string_view line, ApplicantRow &row);
+    static bool Validate(ApplicantRow &row);
+    void Construct(Product, Batch &);
+public:
+    void Run(ApplicantSource source);
+    void Report(double seconds) const;
+    size_t GetNumGrads() const { return grads.Size(); }
+    size_t GetNumUnderGrads() const { return underGrads.Size(); }
+    size_t GetNumNonDegrees() const { return nonDegrees.Size(); }
+    long GetNumRejected() const { return rejected; }
+    Student &GetGrad(size_t i) { return grads[i]; }
+    Student &GetUnderGrad(size_t i) { return underGrads[i]; }
+    Student &GetNonDegree(size_t i) { return nonDegrees[i]; }
+};
+
+// degree,first,last,middleInitial,title,gpa,course,id
+bool MatriculationPipeline::SplitRow(string_view line, ApplicantRow &row)
+{
+    string_view fields[8];
+    int n = 0;
+    while (n < 8)
+    {
+        size_t comma = line.find(',');
+        fields[n++] = line.substr(0, comma);
+        if (comma == string_view::npos)
+            break;
+        line.remove_prefix(comma + 1);
+    }
+    if (n != 8)
+        return false;
+    row.degree = fields[0];
+    row.firstName = fields[1];
+    row.lastName = fields[2];
+    row.middleInitial = fields[3].empty() ? '\0' : fields[3][0];
+    row.title = fields[4];
+    auto result = std::from_chars(fields[5].data(), fields[5].data() + fields[5].size(), row.gpa);
+    if (result.ec != std::errc())
+        row.gpa = -1.0f;   // caught by Validate()
+    row.course = fields[6];
+    row.id = fields[7];
+    return true;
+}
+
+bool MatriculationPipeline::Validate(ApplicantRow &row)
+{
+    if (row.degree == "PhD" || row.degree == "MS" || row.degree == "MA")
+        row.product = Product::Grad;
+    else if (row.degree == "BS" || row.degree == "BA")
+        row.product = Product::UnderGrad;
+    else if (row.degree == "None")
+        row.product = Product::NonDegree;
+    else
+        return false;   // unknown degree
+    return row.gpa >= 0.0f && row.gpa <= 4.0f && !row.firstName.empty() && !row.lastName.empty() && !row.id.empty();
+}
+
+void MatriculationPipeline::Construct(Product product, Batch &batch)
+{
+    for (const auto &r : batch.rows)
+    {
+        string fn(r.firstName), ln(r.lastName), t(r.title), course(r.course), id(r.id);
+        switch (product)
+        {
+        case Product::Grad: grads.Emplace(string(r.degree), fn, ln, r.middleInitial, t, r.gpa, course, id); break;
+        case Product::UnderGrad: underGrads.Emplace(string(r.degree), fn, ln, r.middleInitial, t, r.gpa, course, id); break;
+        default: nonDegrees.Emplace(fn, ln, r.middleInitial, t, r.gpa, course, id); break;
+        }
+    }
+}
+
+void MatriculationPipeline::Run(ApplicantSource source)
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr size_t QUEUEDEPTH = 8;   // batches in flight between two stages
+    BoundedQueue<Batch> parsed(QUEUEDEPTH);
+    vector<unique_ptr<BoundedQueue<Batch>>> validated;
+    for (int p = 0; p < NUMPRODUCTS; p++)
+        validated.push_back(make_unique<BoundedQueue<Batch>>(QUEUEDEPTH));
+
+    thread parser([&]
+    {
+        string chunk;
+        while (source(chunk))
+        {
+            auto start = Clock::now();
+            Batch batch { make_shared<const string>(std::move(chunk)), { } };
+            chunk = string();
+            string_view text(*batch.text);
+            ApplicantRow row;
+            while (!text.empty())
+            {
+                size_t end = text.find('\n');
+                string_view line = text.substr(0, end);
+                text.remove_prefix(end == string_view::npos ? text.size() : end + 1);
+                if (line.empty())
+                    continue;
+                if (SplitRow(line, row))
+                    batch.rows.push_back(row);
+                else
+                    rejected++;
+            }
+            parse.Add(batch.rows.size(), Clock::now() - start);
+            parsed.Push(std::move(batch));
+        }
+        parsed.Close();
+    });
+
+    thread validator([&]
+    {
+        Batch batch;
+        while (parsed.Pop(batch))
+        {
+            auto start = Clock::now();
+            Batch byProduct[NUMPRODUCTS];   // split into one batch per Concrete Product
+            for (auto &b : byProduct)
+                b.text = batch.text;
+            long good = 0;
+            for (auto &row : batch.rows)
+                if (Validate(row))
+                {
+                    byProduct[static_cast<int>(row.product)].rows.push_back(row);
+                    good++;
+                }
+            rejected += static_cast<long>(batch.rows.size()) - good;
+            validate.Add(batch.rows.size(), Clock::now() - start);
+            for (int p = 0; p < NUMPRODUCTS; p++)
+                if (!byProduct[p].rows.empty())
+                    validated[p]->Push(std::move(byProduct[p]));
+        }
+        for (auto &q : validated)
+            q->Close();
+    });
+
+    vector<thread> constructors;   // one per Concrete Product, so that each Arena has a single writer
+    for (int p = 0; p < NUMPRODUCTS; p++)
+        constructors.emplace_back([&, p]
+        {
+            Batch batch;
+            while (validated[p]->Pop(batch))
+            {
+                auto start = Clock::now();
+                Construct(static_cast<Product>(p), batch);
+                construct.Add(batch.rows.size(), Clock::now() - start);
+            }
+        });
+
+    parser.join();
+    validator.join();
+    for (auto &c : constructors)
+        c.join();
+}
+
+void MatriculationPipeline::Report(double seconds) const
+{
+    cout << std::fixed << setprecision(0);
+    for (const StageMetrics *m : { &parse, &validate, &construct })
+    {
+        double busy = m->busyNanos / 1e9;
+        cout << "  " << std::left << std::setw(10) << m->name << std::right << std::setw(10) << m->rows << " rows  "
+             << std::setw(12) << (busy > 0 ? m->rows / busy : 0.0) << " rows/sec (busy " << setprecision(2) << busy
+             << " s)" << setprecision(0) << endl;
+    }
+    long made = static_cast<long>(grads.Size() + underGrads.Size() + nonDegrees.Size());
+    cout << "  end to end: " << made << " Students in " << setprecision(2) << seconds << " s = " << setprecision(0)
+         << made / seconds << " Students/sec; " << rejected << " rows rejected" << endl;
+    cout << "  arenas: " << grads.Size() << " GradStudent, " << underGrads.Size() << " UnderGradStudent, "
+         << nonDegrees.Size() << " NonDegreeStudent" << endl;
+    cout.unsetf(std::ios::fixed);
+    cout << setprecision(6);
+}
+
+// A synthetic feed for the benchmark: numRows applicants, generated a chunk at a time (about 1 in 100 rows is invalid)
+ApplicantSource SyntheticSource(long numRows)
+{
+    auto next = make_shared<long>(0);
+    return [next, numRows](string &chunk)
+    {
+        static const char *degrees[] = { "BS", "BA", "BS", "MS", "PhD", "MA", "None", "BS", "BA", "MBA" };
+        chunk.clear();
+        char gpa[8];
+        for (int i = 0; i < 20000 && *next < numRows; i++, (*next)++)
+        {
+            long n = *next;
+            const char *degree = (n % 100 == 99) ? degrees[9] : degrees[n % 9];
+            std::snprintf(gpa, sizeof(gpa), "%.1f", 2.0 + (n % 21) / 10.0);
+            chunk += degree;
+            chunk += ",Ana,Sato,U,Ms.,";
+            chunk += gpa;
+            chunk += ",C++,";
+            chunk += to_string(n);
+            chunk += '\n';
+        }
+        return !chunk.empty();
+    };
+}
+
+
+int main(int argc, char *argv[])
+{
+    std::istringstream feed(
+        "PhD,Sara,Kato,B,Ms.,3.9,C++,272PSU\n"
+        "BS,Ana,Sato,U,Ms.,3.8,C++,178PSU\n"
+        "None,Elle,LeBrun,R,Miss,3.5,c++,111BU\n"
+        "MBA,Rob,Kato,Q,Mr.,3.2,C++,311PSU\n"       // rejected: degree not offered
+        "MS,Ling,Mau,I,Ms.,7.1,C++,55TU\n"          // rejected: gpa out of range
+        "BA,Jiang,Wu,Q,Dr.,3.8,C++,88TU\n");
+    {
+        MatriculationPipeline pipeline;
+        pipeline.Run(StreamSource(feed));
+        cout << "Matriculated " << Student::GetNumStudents() << " Students, rejected " << pipeline.GetNumRejected() << endl;
+        for (size_t i = 0; i < pipeline.GetNumGrads(); i++)
+        {
+            pipeline.GetGrad(i).Graduate();
+            pipeline.GetGrad(i).Print();
+        }
+        for (size_t i = 0; i < pipeline.GetNumUnderGrads(); i++)
+        {
+            pipeline.GetUnderGrad(i).Graduate();
+            pipeline.GetUnderGrad(i).Print();
+        }
+        for (size_t i = 0; i < pipeline.GetNumNonDegrees(); i++)
+        {
+            pipeline.GetNonDegree(i).Graduate();
+            pipeline.GetNonDegree(i).Print();
+        }
+    }   // the arenas (and all of the Students in them) go away with the pipeline
+
+    long numRows = argc > 1 ? std::stol(argv[1]) : 10000000;
+    cout << endl << "Benchmark: " << numRows << " rows end to end" << endl;
+    {
+        auto start = std::chrono::steady_clock::now();
+        MatriculationPipeline pipeline;
+        pipeline.Run(SyntheticSource(numRows));
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        pipeline.Report(sec);
+    }
+
+    return 0;
+}
@@ -0,0 +1,373 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate object pooling within the Factory Method (in an Object Factory Class).
+// In Chp17-Ex2.cpp, StudentFactory news a GradStudent, UnderGradStudent or NonDegreeStudent on every call,
+// and main() deletes each one. Here, the factory owns one ObjectPool per Concrete Product. MatriculateStudent()
+// constructs the new Student in place in a recycled slot of the matching pool, and returns a unique_ptr whose
+// deleter hands the slot back to that pool (rather than to the heap) when the Student goes away.
+// Compile with: g++ -std=c++17 -O2 Chp17-Ex5.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cassert>
+
+using std::cout;    // preferred to: using namespace std;
+using std::endl;
+using std::setprecision;
+using std::string;
+using std::to_string;
+using std::unique_ptr;
+using std::make_unique;
+using std::vector;
+
+constexpr int MAX = 3;
+
+class Person
+{
+private:
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+protected:
+    void ModifyTitle(const string &);
+public:
+    Person() = default;   // default constructor
+    Person(const string &, const string &, char, const string &);
+    virtual ~Person() = default;  // virtual destructor
+
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+
+    virtual void Print() const;
+    virtual string IsA() const;
+    virtual void Greeting(const string &) const;
+};
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) :
+               firstName(fn), lastName(ln), middleInitial(mi), title(t)
+{
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+    title = newTitle;
+}
+
+void Person::Print() const
+{
+    cout << title << " " << firstName << " ";
+    cout << middleInitial << ". " << lastName << endl;
+}
+
+string Person::IsA() const
+{
+    return "Person";
+}
+
+void Person::Greeting(const string &msg) const
+{
+    cout << msg << endl;
+}
+
+
+// Student is an Abstract class (see pure virtual Graduate() method)
+class Student : public Person
+{
+private:
+    float gpa = 0.0;   // in-class initialization
+    string currentCourse;
+    const string studentId;
+    static int numStudents;
+public:
+    Student(const string &, const string &, char, const string &, float, const string &, const string &);
+    Student(const Student &) = delete;
+    ~Student() override;
+    float GetGpa() const { return gpa; }
+    const string &GetCurrentCourse() const { return currentCourse; }
+    const string &GetStudentId() const { return studentId; }
+
+    void Print() const override;
+    string IsA() const override { return "Student"; }
+    virtual void Graduate() = 0;  // Now Student is abstract
+
+    static int GetNumStudents() { return numStudents; }
+};
+
+int Student::numStudents = 0;
+
+Student::Student(const string &fn, const string &ln, char mi, const string &t, float avg, const string &course, const string &id) :
+                 Person(fn, ln, mi, t), gpa(avg), currentCourse(course), studentId(id)
+{
+   numStudents++;
+}
+
+Student::~Student()
+{
+   numStudents--;
+}
+
+void Student::Print() const
+{
+    cout << "  " << GetTitle() << " " << GetFirstName() << " ";
+    cout << GetMiddleInitial() << ". " << GetLastName();
+    cout << " with id: " << studentId << " GPA: ";
+    cout << setprecision(3) <<  " " << gpa;
+    cout << " Course: " << currentCourse << endl;
+}
+
+class GradStudent : public Student
+{
+private:
+    string degree;  // PhD, MS, MA, etc.
+public:
+    GradStudent(const string &, const string &, const string &, char, const string &, float, const string &, const string &);
+    void EarnPhD() { if (!degree.compare("PhD")) ModifyTitle("Dr."); }
+    string IsA() const override { return "GradStudent"; }
+    void Graduate() override { EarnPhD(); cout << "GradStudent::Graduate()" << endl; }
+};
+
+GradStudent::GradStudent(const string &deg, const string &fn, const string &ln, char mi,
+                 const string &t, float avg, const string &course, const string &id) :
+                 Student(fn, ln, mi, t, avg, course, id), degree(deg)
+{
+}
+
+class UnderGradStudent : public Student
+{
+private:
+    string degree;  // BS, BA, etc
+public:
+    UnderGradStudent(const string &, const string &, const string &, char, const string &, float, const string &, const string &);
+    string IsA() const override { return "UnderGradStudent"; }
+    void Graduate() override { cout << "UnderGradStudent::Graduate()" << endl; }
+};
+
+UnderGradStudent::UnderGradStudent(const string &deg, const string &fn, const string &ln, char mi,
+                 const string &t, float avg, const string &course, const string &id) :
+                 Student(fn, ln, mi, t, avg, course, id), degree(deg)
+{
+}
+
+class NonDegreeStudent : public Student
+{
+public:
+    NonDegreeStudent(const string &, const string &, char, const string &, float, const string &, const string &);
+    string IsA() const override { return "NonDegreeStudent"; }
+    void Graduate() override { cout << "NonDegreeStudent::Graduate()" << endl; }
+};
+
+NonDegreeStudent::NonDegreeStudent(const string &fn, const string &ln, char mi,
+                 const string &t, float avg, const string &course, const string &id) :
+                 Student(fn, ln, mi, t, avg, course, id)
+{
+}
+
+
+// ObjectPool hands out storage for objects of one type. Storage is carved from blocks of BLOCKSIZE slots;
+// a released slot goes onto a free list, and the next Acquire() constructs a new object in that same slot.
+template <class Type>
+class ObjectPool
+{
+private:
+    static constexpr size_t BLOCKSIZE = 256;
+    union Slot
+    {
+        Slot *next;   // while on the free list
+        alignas(Type) unsigned char storage[sizeof(Type)];   // while in use
+    };
+    vector<unique_ptr<Slot[]>> blocks;
+    Slot *freeList = nullptr;
+    size_t inUse = 0, acquired = 0, released = 0;
+    void Grow();
+public:
+    ObjectPool() = default;
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+    ~ObjectPool() { assert(inUse == 0 && "all pooled objects must be released before their pool goes away"); }
+    template <class... Args>
+    Type *Acquire(Args &&...);
+    void Release(Type *);
+    size_t GetInUse() const { return inUse; }
+    size_t GetAcquired() const { return acquired; }
+    size_t GetReleased() const { return released; }
+    size_t GetBlocks() const { return blocks.size(); }
+};
+
+template <class Type>
+void ObjectPool<Type>::Grow()
+{
+    blocks.push_back(make_unique<Slot[]>(BLOCKSIZE));
+    Slot *block = blocks.back().get();
+    for (size_t i = 0; i < BLOCKSIZE; i++)
+    {
+        block[i].next = freeList;
+        freeList = &block[i];
+    }
+}
+
+template <class Type>
+template <class... Args>
+Type *ObjectPool<Type>::Acquire(Args &&... args)
+{
+    if (!freeList)
+        Grow();
+    Slot *slot = freeList;
+    freeList = slot->next;   // unlink first: constructing the object overwrites 'next'
+    Type *obj = nullptr;
+    try
+    {
+        obj = new (slot->storage) Type(std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        slot->next = freeList;   // construction failed; return the slot to the free list
+        freeList = slot;
+        throw;
+    }
+    inUse++;
+    acquired++;
+    return obj;
+}
+
+template <class Type>
+void ObjectPool<Type>::Release(Type *obj)
+{
+    obj->~Type();
+    Slot *slot = reinterpret_cast<Slot *>(obj);
+    slot->next = freeList;
+    freeList = slot;
+    inUse--;
+    released++;
+}
+
+// The deleter for pooled Students: it remembers which pool the Student came from. It is two pointers in size,
+// so it works for any Concrete Product without making the unique_ptr depend on the product type.
+class PoolDeleter
+{
+private:
+    void *pool = nullptr;
+    void (*release)(void *, Student *) = nullptr;
+public:
+    PoolDeleter() = default;
+    template <class Type>
+    explicit PoolDeleter(ObjectPool<Type> *p) : pool(p),
+        release([](void *p, Student *s) { static_cast<ObjectPool<Type> *>(p)->Release(static_cast<Type *>(s)); }) { }
+    void operator()(Student *s) const { if (s) release(pool, s); }
+};
+
+using StudentPtr = unique_ptr<Student, PoolDeleter>;
+
+// The factory owns the pools, so it must outlive every Student it has made
+class StudentFactory
+{
+private:
+    ObjectPool<GradStudent> gradPool;
+    ObjectPool<UnderGradStudent> underGradPool;
+    ObjectPool<NonDegreeStudent> nonDegreePool;
+public:
+    // Creates a student based on the degree they seek; an unknown degree yields an empty StudentPtr
+    StudentPtr MatriculateStudent(const string &degree, const string &fn, const string &ln, char mi,
+                                  const string &t, float avg, const string &course, const string &id)
+    {
+        if (!degree.compare("PhD") || !degree.compare("MS") || !degree.compare("MA"))
+            return StudentPtr(gradPool.Acquire(degree, fn, ln, mi, t, avg, course, id), PoolDeleter(&gradPool));
+        else if (!degree.compare("BS") || !degree.compare("BA"))
+            return StudentPtr(underGradPool.Acquire(degree, fn, ln, mi, t, avg, course, id), PoolDeleter(&underGradPool));
+        else if (!degree.compare("None"))
+            return StudentPtr(nonDegreePool.Acquire(fn, ln, mi, t, avg, course, id), PoolDeleter(&nonDegreePool));
+        return StudentPtr();
+    }
+    void PrintPoolStats() const
+    {
+        cout << "  GradStudent pool:      " << gradPool.GetAcquired() << " acquired, " << gradPool.GetReleased()
+             << " released, " << gradPool.GetBlocks() << " blocks allocated" << endl;
+        cout << "  UnderGradStudent pool: " << underGradPool.GetAcquired() << " acquired, " << underGradPool.GetReleased()
+             << " released, " << underGradPool.GetBlocks() << " blocks allocated" << endl;
+        cout << "  NonDegreeStudent pool: " << nonDegreePool.GetAcquired() << " acquired, " << nonDegreePool.GetReleased()
+             << " released, " << nonDegreePool.GetBlocks() << " blocks allocated" << endl;
+    }
+};
+
+// The factory from Chp17-Ex2.cpp, for comparison in the benchmark
+class HeapStudentFactory
+{
+public:
+    unique_ptr<Student> MatriculateStudent(const string &degree, const string &fn, const string &ln, char mi,
+                                           const string &t, float avg, const string &course, const string &id)
+    {
+        if (!degree.compare("PhD") || !degree.compare("MS") || !degree.compare("MA"))
+            return make_unique<GradStudent>(degree, fn, ln, mi, t, avg, course, id);
+        else if (!degree.compare("BS") || !degree.compare("BA"))
+            return make_unique<UnderGradStudent>(degree, fn, ln, mi, t, avg, course, id);
+        else if (!degree.compare("None"))
+            return make_unique<NonDegreeStudent>(fn, ln, mi, t, avg, course, id);
+        return nullptr;
+    }
+};
+
+// Churn benchmark: keep a population of live Students; over and over, one application is withdrawn
+// (its Student destroyed) and a new one arrives (a new Student made) in its place
+template <class Factory>
+double Churn(Factory &factory, int population, int churns)
+{
+    using Clock = std::chrono::steady_clock;
+    const string degrees[] = { "PhD", "MS", "BS", "BA", "BS", "None" };
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> pickStudent(0, population - 1), pickDegree(0, 5);
+    vector<decltype(factory.MatriculateStudent("", "", "", ' ', "", 0.0f, "", ""))> live;
+    for (int i = 0; i < population; i++)
+        live.push_back(factory.MatriculateStudent(degrees[pickDegree(rng)], "Ana", "Sato", 'U', "Ms.", 3.8, "C++", "178PSU"));
+    auto start = Clock::now();
+    for (int i = 0; i < churns; i++)
+    {
+        auto &slot = live[pickStudent(rng)];
+        slot.reset();   // application withdrawn
+        slot = factory.MatriculateStudent(degrees[pickDegree(rng)], "Ana", "Sato", 'U', "Ms.", 3.8, "C++", "178PSU");
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+
+int main()
+{
+    StudentFactory UofD;   // must outlive the Students it makes, as it owns their storage
+    {
+        StudentPtr scholars[MAX];
+        scholars[0] = UofD.MatriculateStudent("PhD", "Sara", "Kato", 'B', "Ms.", 3.9, "C++", "272PSU");
+        scholars[1] = UofD.MatriculateStudent("BS", "Ana", "Sato", 'U', "Ms.", 3.8, "C++", "178PSU");
+        scholars[2] = UofD.MatriculateStudent("None", "Elle", "LeBrun", 'R', "Miss", 3.5, "c++", "111BU");
+
+        for (auto &oneStudent : scholars)
+        {
+           oneStudent->Graduate();
+           oneStudent->Print();
+        }
+
+        scholars[1].reset();   // Ana withdraws; her storage goes back to the UnderGradStudent pool ...
+        scholars[1] = UofD.MatriculateStudent("BA", "Ling", "Mau", 'I', "Ms.", 3.1, "C++", "55TU");   // ... and is reused here
+        scholars[1]->Print();
+    }   // no delete needed; each StudentPtr returns its Student to its pool
+    UofD.PrintPoolStats();
+
+    constexpr int population = 10000, churns = 5000000;
+    cout << endl << "Churn benchmark: " << population << " live Students, " << churns << " withdraw/matriculate cycles" << endl;
+    HeapStudentFactory heapFactory;
+    double heapSec = Churn(heapFactory, population, churns);
+    StudentFactory pooledFactory;
+    double poolSec = Churn(pooledFactory, population, churns);
+    cout << std::fixed << setprecision(1);
+    cout << "  new/delete factory: " << heapSec * 1000 << " ms (" << setprecision(0) << churns / heapSec << " cycles/sec)" << endl;
+    cout << setprecision(1) << "  pooled factory:     " << poolSec * 1000 << " ms (" << setprecision(0) << churns / poolSec << " cycles/sec)" << endl;
+    cout << setprecision(1) << "  allocator time saved: " << (heapSec - poolSec) * 1000 << " ms, "
+         << (heapSec - poolSec) / churns * 1e9 << " ns per cycle" << endl;
+    cout.unsetf(std::ios::fixed);
+    pooledFactory.PrintPoolStats();
+
+    return 0;
+}
@@ -121,7 +121,7 @@ Humanoid::Humanoid(const string &n2, const string &n1, const string &planetNatio
 
 Humanoid::Humanoid(const Humanoid &h) 
 {
-   delete life;  // delete the old associated object
+   // Note: this object is just being constructed -- life is only nullptr (from its in-class initializer), so there is no old object to delete
    // instantiate the associated object (Adaptee)
    life = new Person(h.GetSecondaryName(), h.GetPrimaryName(), ' ', h.GetTitle());
    life->SetGreeting(h.life->Speak());  // Remember, life member is a Person *
@@ -131,7 +131,7 @@ Humanoid::Humanoid(const Humanoid &h)
 Humanoid &Humanoid::operator=(const Humanoid &h)
 {  // there's only one data member, life, to worry about for a deep assignment
    if (this != &h)
-       life->Person::operator=(dynamic_cast<const Person &>(h));     
+       *life = *(h.life);   // assign the associated Person objects (a Humanoid is not itself a Person)
    return *this; 
 }
 
@@ -0,0 +1,561 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate an Adapter (wrapper) which adds batched and asynchronous I/O to the interface it wraps.
+// In Chp18-Ex3.cpp, CitizenDataBase::Read() and Write() call db_read() and db_write() synchronously, one Person
+// per call, and db_read() returns a reference to a single global Person (objectRead) -- which races if two threads
+// read at once. Here, the "external" db functions are a small, file-backed stand-in which fills in the caller's
+// Person instead. The Adapter adds ReadMany() and WriteMany(), plus WriteAsync(): a write-behind queue whose
+// background thread commits pending writes together (a group commit) and completes a future or calls a callback.
+// Compile with: g++ -std=c++17 -O2 -pthread Chp18-Ex4.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <future>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>   // fsync()
+#endif
+
+using std::cout;    // preferable to: using namespace std;
+using std::endl;
+using std::string;
+using std::to_string;
+using std::vector;
+using std::map;
+using std::unordered_map;
+using std::deque;
+using std::unique_ptr;
+using std::make_unique;
+using std::optional;
+using std::future;
+using std::promise;
+using std::function;
+using std::thread;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::condition_variable;
+
+class Person
+{
+private:
+   string firstName;
+   string lastName;
+   char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+   string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+   string greeting;
+protected:
+   void ModifyTitle(const string &);  // Make this operation available to derived classes
+public:
+   Person() = default;   // default constructor
+   Person(const string &, const string &, char, const string &);  // alternate constructor
+   virtual ~Person() = default;  // virtual destructor
+   const string &GetFirstName() const { return firstName; }
+   const string &GetLastName() const { return lastName; }
+   const string &GetTitle() const { return title; }
+   char GetMiddleInitial() const { return middleInitial; }
+   const string &GetGreeting() const { return greeting; }
+   void SetGreeting(const string &);
+   virtual const string &Speak() { return greeting; }
+   virtual void Print() const;
+};
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) :
+               firstName(fn), lastName(ln), middleInitial(mi), title(t), greeting("Hello")
+{
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+   title = newTitle;
+}
+
+void Person::SetGreeting(const string &newGreeting)
+{
+   greeting = newGreeting;
+}
+
+void Person::Print() const
+{
+   cout << title << " " << firstName << " " << lastName << endl;
+}
+
+
+// External database access functions -- a local, file-backed stand-in.
+// Each database is an append-only file of records, one per line: lastName|firstName|middleInitial|title|greeting
+// The latest record for a key wins. An in-memory index of the records is loaded by db_open().
+// Every db_write() or db_write_many() call is one commit: the records are written, flushed and synced together.
+
+namespace
+{
+    struct DbFile
+    {
+        std::FILE *file = nullptr;
+        unordered_map<string, Person> records;
+        mutex lock;    // the stand-in is safe to call from several threads
+        long commits = 0;
+    };
+    map<string, unique_ptr<DbFile>> openDbs;
+    mutex openDbsLock;
+
+    DbFile &Lookup(const string &dbName)
+    {
+        lock_guard<mutex> guard(openDbsLock);
+        return *openDbs.at(dbName);
+    }
+
+    string Serialize(const Person &p)
+    {
+        return p.GetLastName() + '|' + p.GetFirstName() + '|' + p.GetMiddleInitial() + '|' + p.GetTitle() + '|' + p.GetGreeting() + '\n';
+    }
+
+    bool Deserialize(const string &line, Person &p)
+    {
+        string fields[5];
+        std::istringstream in(line);
+        for (auto &f : fields)
+            if (!std::getline(in, f, '|'))
+                return false;
+        p = Person(fields[1], fields[0], fields[2].empty() ? '\0' : fields[2][0], fields[3]);
+        p.SetGreeting(fields[4]);
+        return true;
+    }
+
+    void Commit(DbFile &db)   // called with db.lock held
+    {
+        std::fflush(db.file);
+#if defined(__unix__) || defined(__APPLE__)
+        fsync(fileno(db.file));
+#endif
+        db.commits++;
+    }
+}
+
+void db_open(const string &dbName)
+{
+    auto db = make_unique<DbFile>();
+    std::ifstream existing(dbName + ".db");
+    string line;
+    Person p;
+    while (std::getline(existing, line))
+        if (Deserialize(line + '|', p))   // the trailing '|' lets getline() find the last field
+            db->records[p.GetLastName()] = p;
+    db->file = std::fopen((dbName + ".db").c_str(), "a");
+    cout << "Opening database: " << dbName << " (" << db->records.size() << " records)" << endl;
+    lock_guard<mutex> guard(openDbsLock);
+    openDbs[dbName] = std::move(db);
+}
+
+void db_close(const string &dbName)
+{
+    lock_guard<mutex> guard(openDbsLock);
+    auto iter = openDbs.find(dbName);
+    if (iter != openDbs.end())
+    {
+        cout << "Closing database: " << dbName << " after " << iter->second->commits << " commits" << endl;
+        std::fclose(iter->second->file);
+        openDbs.erase(iter);
+    }
+}
+
+// Fills in the caller's Person (there is no shared global result); returns false if there is no such key
+bool db_read(const string &dbName, const string &key, Person &result)
+{
+    DbFile &db = Lookup(dbName);
+    lock_guard<mutex> guard(db.lock);
+    auto iter = db.records.find(key);
+    if (iter == db.records.end())
+        return false;
+    result = iter->second;
+    return true;
+}
+
+// Reads a batch of keys under one lock acquisition; found[i] tells whether results[i] was filled in
+void db_read_many(const string &dbName, const vector<string> &keys, vector<Person> &results, vector<bool> &found)
+{
+    DbFile &db = Lookup(dbName);
+    results.resize(keys.size());
+    found.assign(keys.size(), false);
+    lock_guard<mutex> guard(db.lock);
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        auto iter = db.records.find(keys[i]);
+        if (iter != db.records.end())
+        {
+            results[i] = iter->second;
+            found[i] = true;
+        }
+    }
+}
+
+string db_write(const string &dbName, const Person &data)
+{
+    DbFile &db = Lookup(dbName);
+    lock_guard<mutex> guard(db.lock);
+    string record = Serialize(data);
+    std::fwrite(record.data(), 1, record.size(), db.file);
+    Commit(db);
+    db.records[data.GetLastName()] = data;
+    return data.GetLastName();
+}
+
+// Writes a batch of Persons as a single commit
+void db_write_many(const string &dbName, const vector<Person> &data)
+{
+    DbFile &db = Lookup(dbName);
+    string records;
+    for (const auto &p : data)
+        records += Serialize(p);
+    lock_guard<mutex> guard(db.lock);
+    std::fwrite(records.data(), 1, records.size(), db.file);
+    Commit(db);
+    for (const auto &p : data)
+        db.records[p.GetLastName()] = p;
+}
+
+
+// CitizenDataBase is the Adapter class (the class wrapping the undesired interfaces)
+// Beyond Read() and Write(), it offers batched calls and a write-behind queue with group commit.
+class CitizenDataBase
+{
+public:
+    using WriteCallback = function<void(const string &)>;   // called with the key, once the write is committed
+private:
+    struct PendingWrite
+    {
+        Person data;
+        promise<string> done;
+        WriteCallback callback;
+    };
+    string name;
+    size_t maxBatch;                       // the most writes the write-behind thread commits together
+    std::chrono::microseconds maxDelay;    // how long a write may wait for others to join its batch
+    deque<PendingWrite> pending;
+    struct PendingKey
+    {
+        Person latest;    // the newest queued write for this key
+        int queued = 0;   // how many writes for this key are queued or being committed
+    };
+    unordered_map<string, PendingKey> pendingByKey;   // so that Read() sees writes which are not yet committed
+    mutex pendingLock;
+    condition_variable wakeWriter, drained;
+    condition_variable batchCommitted;   // signalled after each group commit, once pendingByKey is up to date
+    bool stopping = false;
+    bool committing = false;
+    thread writer;
+    void WriteBehind();
+    void AwaitCommitted(unique_lock<mutex> &, const vector<string> &);
+public:
+    // No default constructor (unusual)
+    CitizenDataBase(const string &, size_t = 256, std::chrono::microseconds = std::chrono::microseconds(500));
+    CitizenDataBase(const CitizenDataBase &) = delete;  // prohibit copies
+    CitizenDataBase &operator=(const CitizenDataBase &) = delete;  // prohibit assignment
+    virtual ~CitizenDataBase();  // destructor
+    optional<Person> Read(const string &);
+    string Write(const Person &);
+    vector<optional<Person>> ReadMany(const vector<string> &);
+    void WriteMany(const vector<Person> &);
+    future<string> WriteAsync(const Person &);
+    void WriteAsync(const Person &, WriteCallback);
+    void Flush();   // wait until every asynchronous write has been committed
+};
+
+CitizenDataBase::CitizenDataBase(const string &n, size_t batch, std::chrono::microseconds delay) :
+                                 name(n), maxBatch(batch > 0 ? batch : 1), maxDelay(delay)
+{
+    db_open(name);   // calling an existing external function
+    writer = thread([this] { WriteBehind(); });
+}
+
+CitizenDataBase::~CitizenDataBase()
+{
+    {
+        lock_guard<mutex> guard(pendingLock);
+        stopping = true;
+    }
+    wakeWriter.notify_one();
+    writer.join();   // the write-behind thread commits everything still pending before it exits
+    db_close(name);  // close database with external function
+}
+
+optional<Person> CitizenDataBase::Read(const string &key)
+{
+    {
+        lock_guard<mutex> guard(pendingLock);
+        auto iter = pendingByKey.find(key);
+        if (iter != pendingByKey.end())
+            return iter->second.latest;   // read our own (not yet committed) write
+    }
+    Person result;
+    if (db_read(name, key, result))   // call external function
+        return result;
+    return std::nullopt;
+}
+
+// A synchronous write must not go around queued writes to the same key: the group commit would later write the
+// older Person over ours. So wait for those to be committed first, and hold pendingLock across our own commit,
+// so that no new asynchronous write to the key can be queued (and read back) ahead of it meanwhile.
+void CitizenDataBase::AwaitCommitted(unique_lock<mutex> &guard, const vector<string> &keys)
+{
+    batchCommitted.wait(guard, [this, &keys]
+    {
+        for (const auto &k : keys)
+            if (pendingByKey.count(k))
+                return false;
+        return true;
+    });
+}
+
+string CitizenDataBase::Write(const Person &data)
+{
+    unique_lock<mutex> guard(pendingLock);
+    AwaitCommitted(guard, { data.GetLastName() });
+    return db_write(name, data);  // call external function
+}
+
+vector<optional<Person>> CitizenDataBase::ReadMany(const vector<string> &keys)
+{
+    vector<optional<Person>> answer(keys.size());
+    vector<string> dbKeys;       // the keys with no write pending, which we must read from the database
+    vector<size_t> dbIndex;      // where each of those goes in answer
+    {
+        // As in Read(), check pendingByKey first: a key which is not pending here has no write in flight,
+        // so the database already holds its latest committed value when we read it below
+        lock_guard<mutex> guard(pendingLock);
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            auto iter = pendingByKey.find(keys[i]);
+            if (iter != pendingByKey.end())
+                answer[i] = iter->second.latest;   // read our own (not yet committed) write
+            else
+            {
+                dbKeys.push_back(keys[i]);
+                dbIndex.push_back(i);
+            }
+        }
+    }
+    if (dbKeys.empty())
+        return answer;
+    vector<Person> results;
+    vector<bool> found;
+    db_read_many(name, dbKeys, results, found);
+    for (size_t j = 0; j < dbKeys.size(); j++)
+        if (found[j])
+            answer[dbIndex[j]] = std::move(results[j]);
+    return answer;
+}
+
+void CitizenDataBase::WriteMany(const vector<Person> &data)
+{
+    vector<string> keys;
+    keys.reserve(data.size());
+    for (const auto &p : data)
+        keys.push_back(p.GetLastName());
+    unique_lock<mutex> guard(pendingLock);
+    AwaitCommitted(guard, keys);   // as in Write()
+    db_write_many(name, data);   // one commit for the whole batch
+}
+
+future<string> CitizenDataBase::WriteAsync(const Person &data)
+{
+    PendingWrite w { data, promise<string>(), nullptr };
+    future<string> result = w.done.get_future();
+    {
+        lock_guard<mutex> guard(pendingLock);
+        PendingKey &k = pendingByKey[data.GetLastName()];
+        k.latest = data;
+        k.queued++;
+        pending.push_back(std::move(w));
+    }
+    wakeWriter.notify_one();
+    return result;
+}
+
+void CitizenDataBase::WriteAsync(const Person &data, WriteCallback callback)
+{
+    {
+        lock_guard<mutex> guard(pendingLock);
+        PendingKey &k = pendingByKey[data.GetLastName()];
+        k.latest = data;
+        k.queued++;
+        pending.push_back({ data, promise<string>(), std::move(callback) });
+    }
+    wakeWriter.notify_one();
+}
+
+void CitizenDataBase::Flush()
+{
+    unique_lock<mutex> guard(pendingLock);
+    drained.wait(guard, [this] { return pending.empty() && !committing; });
+}
+
+// The write-behind thread: wait for writes, give a partial batch up to maxDelay to fill, then commit the batch
+// with a single db_write_many() call, and complete each write's future (or call its callback)
+void CitizenDataBase::WriteBehind()
+{
+    unique_lock<mutex> guard(pendingLock);
+    for (;;)
+    {
+        wakeWriter.wait(guard, [this] { return stopping || !pending.empty(); });
+        if (pending.empty())
+            return;   // stopping, and nothing left to commit
+        if (pending.size() < maxBatch && !stopping)
+            wakeWriter.wait_for(guard, maxDelay, [this] { return stopping || pending.size() >= maxBatch; });
+
+        vector<PendingWrite> batch;
+        while (!pending.empty() && batch.size() < maxBatch)
+        {
+            batch.push_back(std::move(pending.front()));
+            pending.pop_front();
+        }
+        committing = true;
+        guard.unlock();
+
+        vector<Person> data;
+        data.reserve(batch.size());
+        for (auto &w : batch)
+            data.push_back(w.data);
+        db_write_many(name, data);
+        for (auto &w : batch)
+        {
+            if (w.callback)
+                w.callback(w.data.GetLastName());
+            else
+                w.done.set_value(w.data.GetLastName());
+        }
+
+        guard.lock();
+        committing = false;
+        for (auto &w : batch)   // committed: reads may now go to the database -- unless a newer write is queued
+        {
+            auto iter = pendingByKey.find(w.data.GetLastName());
+            if (--iter->second.queued == 0)
+                pendingByKey.erase(iter);
+        }
+        batchCommitted.notify_all();
+        if (pending.empty())
+            drained.notify_all();
+    }
+}
+
+
+// Benchmark: sustained writes and reads against the stand-in database, at several batch sizes
+void Benchmark(int numOps)
+{
+    using Clock = std::chrono::steady_clock;
+    auto opsPerSec = [numOps](Clock::time_point start) {
+        return numOps / std::chrono::duration<double>(Clock::now() - start).count();
+    };
+    vector<Person> people;
+    vector<string> keys;
+    for (int i = 0; i < numOps; i++)
+    {
+        people.emplace_back("First", "Last" + to_string(i), 'M', "Mr.");
+        keys.push_back("Last" + to_string(i));
+    }
+    string dbName("BenchData");
+    std::remove((dbName + ".db").c_str());
+    {
+        CitizenDataBase db(dbName);
+        cout << std::fixed << std::setprecision(0);
+        auto start = Clock::now();
+        for (const auto &p : people)
+            db.Write(p);
+        cout << "  Write(), one commit each:      " << std::setw(10) << opsPerSec(start) << " writes/sec" << endl;
+        for (size_t batch : { 16, 256, 4096 })
+        {
+            start = Clock::now();
+            for (size_t i = 0; i < people.size(); i += batch)
+                db.WriteMany(vector<Person>(people.begin() + i, people.begin() + std::min(people.size(), i + batch)));
+            cout << "  WriteMany(), batch of " << std::setw(4) << batch << ":    " << std::setw(10) << opsPerSec(start) << " writes/sec" << endl;
+        }
+        start = Clock::now();
+        vector<future<string>> done;
+        done.reserve(people.size());
+        for (const auto &p : people)
+            done.push_back(db.WriteAsync(p));
+        for (auto &f : done)
+            f.get();
+        cout << "  WriteAsync(), write-behind:    " << std::setw(10) << opsPerSec(start) << " writes/sec" << endl;
+
+        start = Clock::now();
+        for (const auto &k : keys)
+            db.Read(k);
+        cout << "  Read():                        " << std::setw(10) << opsPerSec(start) << " reads/sec" << endl;
+        for (size_t batch : { 16, 256, 4096 })
+        {
+            start = Clock::now();
+            for (size_t i = 0; i < keys.size(); i += batch)
+                db.ReadMany(vector<string>(keys.begin() + i, keys.begin() + std::min(keys.size(), i + batch)));
+            cout << "  ReadMany(), batch of " << std::setw(4) << batch << ":     " << std::setw(10) << opsPerSec(start) << " reads/sec" << endl;
+        }
+        cout.unsetf(std::ios::fixed);
+        cout << std::setprecision(6);
+    }
+    std::remove((dbName + ".db").c_str());
+}
+
+
+int main()
+{
+    string name("PersonData");
+    std::remove((name + ".db").c_str());   // start the example with an empty database
+
+    Person p1("Curt", "Jeffreys", 'M', "Mr.");
+    Person p2("Frank", "Burns", 'W', "Mr.");
+    Person p3("Margaret", "Houlihan", 'J', "Maj.");
+    {
+        CitizenDataBase People(name);   // create a Database
+        string key = People.Write(p1);
+        if (auto p = People.Read(key))
+            p->Print();
+
+        People.WriteMany({ p2, p3 });   // both written by one commit
+        for (auto &p : People.ReadMany({ "Burns", "Houlihan", "Pierce" }))
+        {
+            if (p)
+                p->Print();
+            else
+                cout << "(no such person)" << endl;
+        }
+
+        p2.SetGreeting("Ferret face");
+        future<string> written = People.WriteAsync(p2);   // returns right away
+        People.WriteAsync(p3, [](const string &k) { cout << "Committed: " << k << endl; });
+        cout << "Read before commit sees greeting: " << People.Read("Burns")->Speak() << endl;
+        People.Flush();   // after this, the callback has run as well
+        cout << "Committed: " << written.get() << endl;
+
+        // A synchronous write after an asynchronous one to the same key must win, both now and once committed
+        p2.SetGreeting("Good morning");
+        People.WriteAsync(p2);
+        p2.SetGreeting("Good evening");
+        People.Write(p2);
+        bool readBack = People.Read("Burns")->Speak() == "Good evening";
+        People.Flush();
+        bool committed = People.Read("Burns")->Speak() == "Good evening";
+        cout << "Sync write after async write wins: " << (readBack && committed ? "passed" : "FAILED") << endl;
+    }
+    {
+        CitizenDataBase People(name);   // reopen; the records were made durable
+        cout << "After reopening, Burns says: " << People.Read("Burns")->Speak() << endl;
+    }
+    std::remove((name + ".db").c_str());
+
+    cout << endl << "Benchmark: 20000 Persons" << endl;
+    Benchmark(20000);
+
+    return 0;
+}
@@ -0,0 +1,433 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate an Adapter (wrapper) which adds a read-through cache in front of the interface it wraps.
+// In Chp18-Ex3.cpp, every CitizenDataBase::Read() goes to the external db_read(), even for keys which are read
+// over and over. Here, the Adapter keeps recently read Persons (by value) in a sharded LRU cache bounded by bytes.
+// Writes either invalidate the cached entry or write through to it. Hits, misses and evictions are counted.
+// As in Chp18-Ex4.cpp, the external db_read() fills in the caller's Person rather than a shared global Person.
+// Compile with: g++ -std=c++17 -O2 -pthread Chp18-Ex5.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <optional>
+#include <functional>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+using std::cout;    // preferable to: using namespace std;
+using std::endl;
+using std::string;
+using std::to_string;
+using std::vector;
+using std::list;
+using std::unordered_map;
+using std::optional;
+using std::thread;
+using std::mutex;
+using std::lock_guard;
+using std::atomic;
+using std::memory_order_relaxed;
+
+class Person
+{
+private:
+   string firstName;
+   string lastName;
+   char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+   string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+   string greeting;
+protected:
+   void ModifyTitle(const string &);  // Make this operation available to derived classes
+public:
+   Person() = default;   // default constructor
+   Person(const string &, const string &, char, const string &);  // alternate constructor
+   virtual ~Person() = default;  // virtual destructor
+   const string &GetFirstName() const { return firstName; }
+   const string &GetLastName() const { return lastName; }
+   const string &GetTitle() const { return title; }
+   char GetMiddleInitial() const { return middleInitial; }
+   const string &GetGreeting() const { return greeting; }
+   void SetGreeting(const string &);
+   virtual const string &Speak() { return greeting; }
+   virtual void Print() const;
+};
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) :
+               firstName(fn), lastName(ln), middleInitial(mi), title(t), greeting("Hello")
+{
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+   title = newTitle;
+}
+
+void Person::SetGreeting(const string &newGreeting)
+{
+   greeting = newGreeting;
+}
+
+void Person::Print() const
+{
+   cout << title << " " << firstName << " " << lastName << endl;
+}
+
+
+// External database access functions -- an in-memory stand-in with a simulated round trip per call
+namespace
+{
+    unordered_map<string, Person> records;
+    mutex recordsLock;
+    atomic<long> dbReads(0);
+    std::chrono::microseconds roundTrip(2);
+
+    void RoundTrip()   // spin (rather than sleep) so that the cost is the same on every platform
+    {
+        auto until = std::chrono::steady_clock::now() + roundTrip;
+        while (std::chrono::steady_clock::now() < until)
+            ;
+    }
+}
+
+void db_open(const string &dbName)
+{
+    cout << "Opening database: " << dbName << endl;
+}
+
+void db_close(const string &dbName)
+{
+    cout << "Closing database: " << dbName << endl;
+}
+
+// Fills in the caller's Person (there is no shared global result); returns false if there is no such key
+bool db_read(const string &, const string &key, Person &result)
+{
+    RoundTrip();
+    dbReads.fetch_add(1, memory_order_relaxed);
+    lock_guard<mutex> guard(recordsLock);
+    auto iter = records.find(key);
+    if (iter == records.end())
+        return false;
+    result = iter->second;
+    return true;
+}
+
+string db_write(const string &, const Person &data)
+{
+    RoundTrip();
+    lock_guard<mutex> guard(recordsLock);
+    records[data.GetLastName()] = data;
+    return data.GetLastName();
+}
+
+
+enum class WritePolicy { Invalidate, WriteThrough };
+
+struct CacheStats
+{
+    long hits = 0;
+    long misses = 0;
+    long evictions = 0;
+    size_t bytes = 0;
+    size_t entries = 0;
+    double HitRate() const { return hits + misses > 0 ? double(hits) / (hits + misses) : 0.0; }
+};
+
+// A cache of Persons by key, split into shards (each with its own lock and LRU list) so that concurrent readers
+// of different keys seldom wait on one another. The byte bound is divided evenly among the shards.
+class PersonCache
+{
+private:
+    static constexpr int NUMSHARDS = 8;
+    struct Entry
+    {
+        string key;
+        Person data;
+        size_t bytes;
+    };
+    struct Shard
+    {
+        mutex lock;
+        list<Entry> lru;   // most recently used at the front
+        unordered_map<string, list<Entry>::iterator> index;
+        size_t bytes = 0;
+        long version = 0;   // bumped by every Erase(), so a slow miss cannot re-insert a value a write replaced
+        mutex writeLock;    // held by a write-through across db_write() and Update(); readers never take it
+    };
+    Shard shards[NUMSHARDS];
+    size_t shardLimit;
+    atomic<long> hits, misses, evictions;
+    Shard &ShardFor(const string &key) { return shards[std::hash<string>()(key) % NUMSHARDS]; }
+    void Store(Shard &, const string &, const Person &);   // called with the shard's lock held
+public:
+    static size_t Footprint(const string &, const Person &);
+    explicit PersonCache(size_t maxBytes) : shardLimit(maxBytes / NUMSHARDS), hits(0), misses(0), evictions(0) { }
+    PersonCache(const PersonCache &) = delete;
+    PersonCache &operator=(const PersonCache &) = delete;
+    bool Find(const string &, Person &, long &);   // on a miss, also returns the shard version to pass to Insert()
+    void Insert(const string &, const Person &, long);
+    void Update(const string &, const Person &);
+    void Erase(const string &);
+    // Serializes write-throughs of keys in the same shard, so that the cache ends up with the last value written
+    mutex &WriteLockFor(const string &key) { return ShardFor(key).writeLock; }
+    CacheStats GetStats();
+};
+
+// An estimate of the bytes an entry occupies: the node and the strings' characters (whether or not held inline)
+size_t PersonCache::Footprint(const string &key, const Person &p)
+{
+    return sizeof(Entry) + key.size() + p.GetFirstName().size() + p.GetLastName().size() +
+           p.GetTitle().size() + p.GetGreeting().size();
+}
+
+bool PersonCache::Find(const string &key, Person &result, long &version)
+{
+    Shard &s = ShardFor(key);
+    lock_guard<mutex> guard(s.lock);
+    auto iter = s.index.find(key);
+    if (iter == s.index.end())
+    {
+        misses.fetch_add(1, memory_order_relaxed);
+        version = s.version;
+        return false;
+    }
+    s.lru.splice(s.lru.begin(), s.lru, iter->second);   // now the most recently used
+    result = iter->second->data;
+    hits.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+void PersonCache::Store(Shard &s, const string &key, const Person &data)
+{
+    auto iter = s.index.find(key);
+    if (iter != s.index.end())   // drop the old entry first: it must go even if the new value can not be cached
+    {
+        s.bytes -= iter->second->bytes;
+        s.lru.erase(iter->second);
+        s.index.erase(iter);
+    }
+    size_t bytes = Footprint(key, data);
+    if (bytes > shardLimit)
+        return;   // too big to cache at all
+    while (s.bytes + bytes > shardLimit)   // evict least recently used entries until the new one fits
+    {
+        Entry &victim = s.lru.back();
+        s.bytes -= victim.bytes;
+        s.index.erase(victim.key);
+        s.lru.pop_back();
+        evictions.fetch_add(1, memory_order_relaxed);
+    }
+    s.lru.push_front({ key, data, bytes });
+    s.index[key] = s.lru.begin();
+    s.bytes += bytes;
+}
+
+void PersonCache::Insert(const string &key, const Person &data, long version)
+{
+    Shard &s = ShardFor(key);
+    lock_guard<mutex> guard(s.lock);
+    if (s.version == version)   // otherwise a write happened while we read from the database; don't cache
+        Store(s, key, data);
+}
+
+void PersonCache::Update(const string &key, const Person &data)
+{
+    Shard &s = ShardFor(key);
+    lock_guard<mutex> guard(s.lock);
+    s.version++;
+    Store(s, key, data);
+}
+
+void PersonCache::Erase(const string &key)
+{
+    Shard &s = ShardFor(key);
+    lock_guard<mutex> guard(s.lock);
+    s.version++;
+    auto iter = s.index.find(key);
+    if (iter != s.index.end())
+    {
+        s.bytes -= iter->second->bytes;
+        s.lru.erase(iter->second);
+        s.index.erase(iter);
+    }
+}
+
+CacheStats PersonCache::GetStats()
+{
+    CacheStats stats;
+    stats.hits = hits.load(memory_order_relaxed);
+    stats.misses = misses.load(memory_order_relaxed);
+    stats.evictions = evictions.load(memory_order_relaxed);
+    for (auto &s : shards)
+    {
+        lock_guard<mutex> guard(s.lock);
+        stats.bytes += s.bytes;
+        stats.entries += s.index.size();
+    }
+    return stats;
+}
+
+
+// CitizenDataBase is the Adapter class (the class wrapping the undesired interfaces)
+class CitizenDataBase
+{
+private:
+    string name;
+    WritePolicy policy;
+    PersonCache cache;
+public:
+    // No default constructor (unusual)
+    CitizenDataBase(const string &, size_t = 1 << 20, WritePolicy = WritePolicy::Invalidate);
+    CitizenDataBase(const CitizenDataBase &) = delete;  // prohibit copies
+    CitizenDataBase &operator=(const CitizenDataBase &) = delete;  // prohibit assignment
+    virtual ~CitizenDataBase();  // destructor
+    optional<Person> Read(const string &);
+    string Write(const Person &);
+    CacheStats GetCacheStats() { return cache.GetStats(); }
+};
+
+CitizenDataBase::CitizenDataBase(const string &n, size_t cacheBytes, WritePolicy p) :
+                                 name(n), policy(p), cache(cacheBytes)
+{
+    db_open(name);   // calling an existing external function
+}
+
+CitizenDataBase::~CitizenDataBase()
+{
+    db_close(name);  // close database with external function
+}
+
+optional<Person> CitizenDataBase::Read(const string &key)
+{
+    Person result;
+    long version = 0;
+    if (cache.Find(key, result, version))
+        return result;
+    if (!db_read(name, key, result))   // call external function only on a miss
+        return std::nullopt;
+    cache.Insert(key, result, version);
+    return result;
+}
+
+string CitizenDataBase::Write(const Person &data)
+{
+    if (policy == WritePolicy::WriteThrough)
+    {
+        // Without this lock, two writers of one key could reach the database in one order and the cache in the
+        // other, leaving the older Person cached for good. Readers of the shard are not held up by it.
+        lock_guard<mutex> ordered(cache.WriteLockFor(data.GetLastName()));
+        string key = db_write(name, data);  // call external function
+        cache.Update(key, data);
+        return key;
+    }
+    string key = db_write(name, data);
+    cache.Erase(key);   // erasing is idempotent, so racing writers need no ordering here
+    return key;
+}
+
+
+void PrintStats(const string &label, CitizenDataBase &db, double seconds, long ops)
+{
+    CacheStats s = db.GetCacheStats();
+    cout << std::fixed << std::setprecision(0);
+    cout << "  " << std::left << std::setw(22) << label << std::right << std::setw(10) << ops / seconds << " reads/sec";
+    cout << std::setprecision(1) << std::setw(8) << 100 * s.HitRate() << "% hits";
+    cout << std::setw(9) << s.evictions << " evictions" << std::setw(8) << s.entries << " entries" << std::setw(10) << s.bytes << " bytes" << endl;
+    cout.unsetf(std::ios::fixed);
+    cout << std::setprecision(6);
+}
+
+// Benchmark: skewed reads (a few last names are very popular) of numKeys records, with caches of several sizes,
+// by one thread and then by several concurrent readers
+void Benchmark(int numKeys, int numReads)
+{
+    using Clock = std::chrono::steady_clock;
+    for (int i = 0; i < numKeys; i++)
+        db_write("BenchData", Person("First", "Last" + to_string(i), 'M', "Mr."));
+
+    auto workload = [numKeys](unsigned seed, int n) {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+        vector<string> keys;
+        for (int i = 0; i < n; i++)
+        {
+            double x = u(gen);
+            keys.push_back("Last" + to_string(int(numKeys * x * x * x)));   // skewed toward low-numbered keys
+        }
+        return keys;
+    };
+    vector<string> keys = workload(1, numReads);
+
+    for (size_t cacheBytes : { size_t(0), size_t(64) << 10, size_t(512) << 10, size_t(4) << 20 })
+    {
+        CitizenDataBase db("BenchData", cacheBytes);
+        auto start = Clock::now();
+        for (const auto &k : keys)
+            db.Read(k);
+        PrintStats(to_string(cacheBytes >> 10) + "KB cache:", db, std::chrono::duration<double>(Clock::now() - start).count(), numReads);
+    }
+
+    const int numThreads = 4;
+    CitizenDataBase db("BenchData", size_t(512) << 10, WritePolicy::WriteThrough);
+    vector<vector<string>> perThread;
+    for (int t = 0; t < numThreads; t++)
+        perThread.push_back(workload(100 + t, numReads / numThreads));
+    auto start = Clock::now();
+    vector<thread> readers;
+    for (int t = 0; t < numThreads; t++)
+        readers.emplace_back([&db, &perThread, t]() {
+            for (size_t i = 0; i < perThread[t].size(); i++)
+            {
+                if (i % 100 == 99)   // an occasional write, written through to the cache
+                    db.Write(Person("Other", perThread[t][i], 'X', "Dr."));
+                else
+                    db.Read(perThread[t][i]);
+            }
+        });
+    for (auto &r : readers)
+        r.join();
+    PrintStats(to_string(numThreads) + " threads, 512KB:", db, std::chrono::duration<double>(Clock::now() - start).count(), numReads);
+}
+
+
+int main(int argc, char *argv[])
+{
+    Person p1("Curt", "Jeffreys", 'M', "Mr.");
+    {
+        CitizenDataBase People("PersonData", 1 << 16);   // create a Database with a 64KB cache
+        string key = People.Write(p1);
+        People.Read(key)->Print();      // a miss: read from the database, then cached
+        People.Read(key)->Print();      // a hit
+        p1.SetGreeting("Good day");
+        People.Write(p1);               // invalidates the cached copy
+        cout << "After the write: " << People.Read(key)->Speak() << endl;
+        cout << "Missing key found? " << People.Read("Pierce").has_value() << endl;
+        CacheStats s = People.GetCacheStats();
+        cout << "hits: " << s.hits << " misses: " << s.misses << " entries: " << s.entries << endl;
+    }
+    {
+        // Write through a value too big to cache: the older, cached Person must not be served afterwards
+        CitizenDataBase People("PersonData", 1 << 12, WritePolicy::WriteThrough);   // 512 bytes per shard
+        People.Write(p1);
+        People.Read(p1.GetLastName());
+        p1.SetGreeting(string(1000, 'z'));
+        People.Write(p1);
+        cout << "After an uncacheable write-through: " << (People.Read(p1.GetLastName())->Speak() == p1.Speak() ? "new value" : "STALE value")
+             << ", entries: " << People.GetCacheStats().entries << endl;
+    }
+
+    int numKeys = argc > 1 ? std::stoi(argv[1]) : 10000;
+    int numReads = argc > 2 ? std::stoi(argv[2]) : 200000;
+    cout << endl << "Benchmark: " << numReads << " skewed reads of " << numKeys << " keys, "
+         << roundTrip.count() << "us per database round trip" << endl;
+    long before = dbReads.load();
+    Benchmark(numKeys, numReads);
+    cout << "Database reads: " << dbReads.load() - before << endl;
+
+    return 0;
+}
@@ -0,0 +1,751 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate an Adapter (wrapper) over a real, embedded storage backend.
+// In Chp18-Ex3.cpp, the external db functions are stubs. Here, CitizenDataBase wraps a PersonStore: an append-only
+// log of serialized Person records plus a memory-mapped hash index keyed by GetLastName(). Reads may be zero-copy
+// (a PersonView's string_views point straight into the memory-mapped log). Writes are appended to the log and made
+// durable in batches (one fdatasync per syncEvery writes). Compact() rewrites the log keeping only the latest record
+// per key. If the store was not closed cleanly, its index is rebuilt from the log, and a torn last record is dropped;
+// an invalid record anywhere else is corruption, and the store refuses to open rather than discard the records after it.
+// This example uses POSIX file and memory-mapping calls.
+// Compile with: g++ -std=c++17 -O2 Chp18-Ex6.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <optional>
+#include <string_view>
+#include <random>
+#include <chrono>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::cout;    // preferable to: using namespace std;
+using std::endl;
+using std::string;
+using std::string_view;
+using std::to_string;
+using std::vector;
+using std::optional;
+
+class Person
+{
+private:
+   string firstName;
+   string lastName;
+   char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+   string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+   string greeting;
+protected:
+   void ModifyTitle(const string &);  // Make this operation available to derived classes
+public:
+   Person() = default;   // default constructor
+   Person(const string &, const string &, char, const string &);  // alternate constructor
+   virtual ~Person() = default;  // virtual destructor
+   const string &GetFirstName() const { return firstName; }
+   const string &GetLastName() const { return lastName; }
+   const string &GetTitle() const { return title; }
+   char GetMiddleInitial() const { return middleInitial; }
+   const string &GetGreeting() const { return greeting; }
+   void SetGreeting(const string &);
+   virtual const string &Speak() { return greeting; }
+   virtual void Print() const;
+};
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) :
+               firstName(fn), lastName(ln), middleInitial(mi), title(t), greeting("Hello")
+{
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+   title = newTitle;
+}
+
+void Person::SetGreeting(const string &newGreeting)
+{
+   greeting = newGreeting;
+}
+
+void Person::Print() const
+{
+   cout << title << " " << firstName << " " << lastName << endl;
+}
+
+
+// A read-only view of a stored Person. Its string_views point into the store's memory-mapped log, so they are
+// valid until the store is compacted, grows past its mapping (see PersonStore::MapLog()), or is closed.
+struct PersonView
+{
+    string_view firstName;
+    string_view lastName;
+    string_view title;
+    string_view greeting;
+    char middleInitial = '\0';
+    Person ToPerson() const
+    {
+        Person p(string(firstName), string(lastName), middleInitial, string(title));
+        p.SetGreeting(string(greeting));
+        return p;
+    }
+};
+
+// The log file is a 16 byte file header, followed by records:
+//    uint32 payload length | uint32 checksum of payload | payload
+// where the payload is:
+//    uint16 lengths of lastName, firstName, title, greeting | char middleInitial | the four strings' characters
+// The index file is an IndexHeader followed by a power-of-two table of Slots (linear probing); a Slot's offset is
+// that of the latest record for its key within the log (0, which is within the file header, means an empty slot).
+class PersonStore
+{
+private:
+    static constexpr char LOGMAGIC[16] = "PersonStoreLog1";
+    static constexpr uint64_t INDEXMAGIC = 0x5053494e44455831;   // "PSINDEX1"
+    static constexpr size_t HEADERBYTES = sizeof(LOGMAGIC);
+    static constexpr size_t RECORDHEADER = 8;
+    static constexpr size_t PAYLOADHEADER = 4 * sizeof(uint16_t) + 1;
+    static constexpr size_t MAXPAYLOAD = PAYLOADHEADER + 4 * size_t(UINT16_MAX);   // the largest Append() can write
+    struct IndexHeader
+    {
+        uint64_t magic;
+        uint64_t capacity;
+        uint64_t count;
+        uint64_t logEnd;   // the log's length when the index was last closed
+        uint64_t clean;    // 1 only between a clean close and the next open
+    };
+    struct Slot
+    {
+        uint64_t hash;
+        uint64_t offset;
+    };
+    string logPath, indexPath;
+    int logFd = -1, indexFd = -1;
+    const char *log = nullptr;
+    size_t logReserved = 0;
+    uint64_t logEnd = 0;
+    IndexHeader *index = nullptr;
+    size_t indexBytes = 0;
+    size_t syncEvery, unsynced = 0;
+    bool rebuilt = false;
+    string record;   // scratch space for serializing one record
+
+    [[noreturn]] static void Fail(const string &what) { throw std::runtime_error(what + ": " + std::strerror(errno)); }
+    static uint32_t Checksum(const char *, size_t);
+    static uint64_t Hash(string_view);
+    Slot *Slots() const { return reinterpret_cast<Slot *>(index + 1); }
+    uint32_t Load32(uint64_t offset) const { uint32_t v; std::memcpy(&v, log + offset, sizeof(v)); return v; }
+    void MapLog(size_t);
+    void CreateIndex(uint64_t);
+    bool OpenIndex();
+    void CloseIndex();
+    size_t RecordLength(uint64_t, uint64_t) const;   // 0 if there is no whole, valid record at this offset
+    bool IsTornTail(uint64_t) const;   // could the invalid record at this offset be an append cut short by a crash?
+    void Decode(uint64_t, PersonView &) const;
+    string_view KeyAt(uint64_t) const;
+    void IndexInsert(uint64_t, string_view, uint64_t);
+    void RebuildIndex();
+    void SyncDirectory() const;
+public:
+    explicit PersonStore(const string &, size_t = 64);
+    PersonStore(const PersonStore &) = delete;  // prohibit copies
+    PersonStore &operator=(const PersonStore &) = delete;  // prohibit assignment
+    ~PersonStore();
+    bool Find(string_view, PersonView &) const;
+    void Append(const Person &);
+    void Sync();
+    void Compact();
+    size_t Count() const { return index->count; }
+    size_t LogBytes() const { return logEnd; }
+    bool IndexWasRebuilt() const { return rebuilt; }
+};
+
+uint32_t PersonStore::Checksum(const char *data, size_t len)   // 32 bit FNV-1a
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ static_cast<unsigned char>(data[i])) * 16777619u;
+    return h;
+}
+
+uint64_t PersonStore::Hash(string_view key)   // 64 bit FNV-1a
+{
+    uint64_t h = 14695981039346656037ull;
+    for (char c : key)
+        h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    return h;
+}
+
+PersonStore::PersonStore(const string &name, size_t syncBatch) :
+                         logPath(name + ".log"), indexPath(name + ".idx"), syncEvery(syncBatch > 0 ? syncBatch : 1)
+{
+    logFd = open(logPath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (logFd < 0)
+        Fail("open " + logPath);
+    struct stat st;
+    fstat(logFd, &st);
+    logEnd = st.st_size;
+    if (logEnd == 0)
+    {
+        if (pwrite(logFd, LOGMAGIC, HEADERBYTES, 0) != static_cast<ssize_t>(HEADERBYTES) || fdatasync(logFd) != 0)
+            Fail("initialize " + logPath);
+        logEnd = HEADERBYTES;
+    }
+    else
+    {
+        char magic[HEADERBYTES];
+        if (pread(logFd, magic, HEADERBYTES, 0) != static_cast<ssize_t>(HEADERBYTES) || std::memcmp(magic, LOGMAGIC, HEADERBYTES) != 0)
+            throw std::runtime_error(logPath + " is not a PersonStore log");
+    }
+    MapLog(std::max<size_t>(size_t(1) << 30, logEnd * 2));
+    try
+    {
+        if (!OpenIndex())
+            RebuildIndex();
+    }
+    catch (...)   // the destructor will not run; release the log and index before passing on the exception
+    {
+        if (index)
+            CloseIndex();
+        munmap(const_cast<char *>(log), logReserved);
+        close(logFd);
+        throw;
+    }
+    index->clean = 0;   // if we crash from here on, the next open rebuilds the index
+    msync(index, sizeof(IndexHeader), MS_SYNC);
+}
+
+PersonStore::~PersonStore()
+{
+    if (fdatasync(logFd) == 0)   // don't mark the index clean unless the log it describes is durable
+    {
+        index->logEnd = logEnd;
+        msync(index, indexBytes, MS_SYNC);
+        index->clean = 1;
+        msync(index, sizeof(IndexHeader), MS_SYNC);
+    }
+    CloseIndex();
+    munmap(const_cast<char *>(log), logReserved);
+    close(logFd);
+}
+
+// Map more address space than the log needs, so that appends seldom require a new mapping. Pages beyond the end of
+// the file are never touched. Remapping (after 1GB of growth) invalidates outstanding PersonViews.
+void PersonStore::MapLog(size_t reserve)
+{
+    if (log)
+        munmap(const_cast<char *>(log), logReserved);
+    void *p = mmap(nullptr, reserve, PROT_READ, MAP_SHARED, logFd, 0);
+    if (p == MAP_FAILED)
+        Fail("mmap " + logPath);
+    log = static_cast<const char *>(p);
+    logReserved = reserve;
+}
+
+// Create an empty index with the given capacity (a power of two) in a temporary file, then rename it into place
+void PersonStore::CreateIndex(uint64_t capacity)
+{
+    string tmpPath = indexPath + ".tmp";
+    int fd = open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    size_t bytes = sizeof(IndexHeader) + capacity * sizeof(Slot);
+    if (fd < 0 || ftruncate(fd, bytes) != 0)   // ftruncate() fills with zeros: every slot is empty
+        Fail("create " + tmpPath);
+    void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+        Fail("mmap " + tmpPath);
+    IndexHeader *fresh = static_cast<IndexHeader *>(p);
+    *fresh = { INDEXMAGIC, capacity, 0, 0, 0 };
+    if (index)
+    {
+        Slot *slots = reinterpret_cast<Slot *>(fresh + 1);
+        for (uint64_t i = 0; i < index->capacity; i++)   // rehash: keys are distinct, so compare hashes only
+        {
+            const Slot &old = Slots()[i];
+            if (old.offset == 0)
+                continue;
+            uint64_t j = old.hash & (capacity - 1);
+            while (slots[j].offset != 0)
+                j = (j + 1) & (capacity - 1);
+            slots[j] = old;
+            fresh->count++;
+        }
+        CloseIndex();
+    }
+    if (rename(tmpPath.c_str(), indexPath.c_str()) != 0)
+        Fail("rename " + tmpPath);
+    index = fresh;
+    indexFd = fd;
+    indexBytes = bytes;
+}
+
+// Use the existing index file only if it was closed cleanly and describes exactly the log we have
+bool PersonStore::OpenIndex()
+{
+    int fd = open(indexPath.c_str(), O_RDWR);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    fstat(fd, &st);
+    size_t bytes = st.st_size;
+    if (bytes < sizeof(IndexHeader))
+    {
+        close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+    IndexHeader *h = static_cast<IndexHeader *>(p);
+    if (h->magic != INDEXMAGIC || h->clean != 1 || h->logEnd != logEnd ||
+        bytes != sizeof(IndexHeader) + h->capacity * sizeof(Slot))
+    {
+        munmap(p, bytes);
+        close(fd);
+        return false;
+    }
+    index = h;
+    indexFd = fd;
+    indexBytes = bytes;
+    return true;
+}
+
+void PersonStore::CloseIndex()
+{
+    munmap(index, indexBytes);
+    close(indexFd);
+    index = nullptr;
+}
+
+size_t PersonStore::RecordLength(uint64_t offset, uint64_t end) const
+{
+    if (offset + RECORDHEADER + PAYLOADHEADER > end)
+        return 0;
+    uint32_t len = Load32(offset);
+    if (len < PAYLOADHEADER || offset + RECORDHEADER + len > end)
+        return 0;
+    const char *payload = log + offset + RECORDHEADER;
+    uint16_t lens[4];
+    std::memcpy(lens, payload, sizeof(lens));
+    if (PAYLOADHEADER + size_t(lens[0]) + lens[1] + lens[2] + lens[3] != len || Checksum(payload, len) != Load32(offset + 4))
+        return 0;
+    return RECORDHEADER + len;
+}
+
+void PersonStore::Decode(uint64_t offset, PersonView &view) const
+{
+    const char *payload = log + offset + RECORDHEADER;
+    uint16_t lens[4];
+    std::memcpy(lens, payload, sizeof(lens));
+    view.middleInitial = payload[sizeof(lens)];
+    const char *s = payload + PAYLOADHEADER;
+    view.lastName = string_view(s, lens[0]);
+    s += lens[0];
+    view.firstName = string_view(s, lens[1]);
+    s += lens[1];
+    view.title = string_view(s, lens[2]);
+    s += lens[2];
+    view.greeting = string_view(s, lens[3]);
+}
+
+string_view PersonStore::KeyAt(uint64_t offset) const
+{
+    uint16_t keyLen;
+    std::memcpy(&keyLen, log + offset + RECORDHEADER, sizeof(keyLen));
+    return string_view(log + offset + RECORDHEADER + PAYLOADHEADER, keyLen);
+}
+
+void PersonStore::IndexInsert(uint64_t hash, string_view key, uint64_t offset)
+{
+    if ((index->count + 1) * 10 > index->capacity * 7)   // keep the load factor at or below 70%
+        CreateIndex(index->capacity * 2);
+    uint64_t mask = index->capacity - 1;
+    Slot *slots = Slots();
+    for (uint64_t i = hash & mask; ; i = (i + 1) & mask)
+    {
+        if (slots[i].offset == 0)
+        {
+            slots[i] = { hash, offset };
+            index->count++;
+            return;
+        }
+        if (slots[i].hash == hash && KeyAt(slots[i].offset) == key)
+        {
+            slots[i].offset = offset;   // the newer record for this key replaces the older
+            return;
+        }
+    }
+}
+
+// A crash mid-append leaves the last record cut short: the file was extended but the record's bytes never reached
+// the disk (leaving only zeros), or the bytes present are a prefix of the record (or all of it, with some pages
+// unwritten). So its length must be one Append() could have written and must reach the end of the file, and no
+// valid record may start within it -- if one does, a length field in mid-log was damaged, and the records after
+// it are intact.
+bool PersonStore::IsTornTail(uint64_t offset) const
+{
+    bool zeros = true;
+    for (uint64_t i = offset; i < logEnd && zeros; i++)
+        zeros = log[i] == 0;
+    if (zeros)
+        return true;
+    if (offset + RECORDHEADER > logEnd)
+        return true;   // not even a whole length and checksum
+    uint32_t len = Load32(offset);
+    if (len < PAYLOADHEADER || len > MAXPAYLOAD || offset + RECORDHEADER + len < logEnd)
+        return false;   // not a length we write, or the record ends before the file does
+    for (uint64_t next = offset + 1; next < logEnd; next++)
+        if (RecordLength(next, logEnd))
+            return false;
+    return true;
+}
+
+// Scan the whole log, indexing every valid record; a torn record at the end (from a crash mid-append) is dropped.
+// An invalid record with more of the log after it is not a torn append: truncating there would destroy the valid
+// records which follow, so we report the corruption instead.
+void PersonStore::RebuildIndex()
+{
+    if (index)
+        CloseIndex();
+    CreateIndex(1024);
+    uint64_t offset = HEADERBYTES;
+    while (size_t len = RecordLength(offset, logEnd))
+    {
+        IndexInsert(Hash(KeyAt(offset)), KeyAt(offset), offset);
+        offset += len;
+    }
+    if (offset != logEnd)
+    {
+        if (!IsTornTail(offset))
+            throw std::runtime_error(logPath + " is corrupt: invalid record at offset " + to_string(offset) + " of " +
+                                     to_string(logEnd) + " bytes");
+        if (ftruncate(logFd, offset) != 0)
+            Fail("truncate " + logPath);
+        logEnd = offset;
+    }
+    rebuilt = true;
+}
+
+void PersonStore::SyncDirectory() const
+{
+    size_t slash = logPath.rfind('/');
+    string dir = slash == string::npos ? "." : logPath.substr(0, slash);
+    int fd = open(dir.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+bool PersonStore::Find(string_view key, PersonView &view) const
+{
+    uint64_t hash = Hash(key);
+    uint64_t mask = index->capacity - 1;
+    const Slot *slots = Slots();
+    for (uint64_t i = hash & mask; slots[i].offset != 0; i = (i + 1) & mask)
+    {
+        if (slots[i].hash == hash && KeyAt(slots[i].offset) == key)
+        {
+            Decode(slots[i].offset, view);
+            return true;
+        }
+    }
+    return false;
+}
+
+void PersonStore::Append(const Person &p)
+{
+    const string *fields[4] = { &p.GetLastName(), &p.GetFirstName(), &p.GetTitle(), &p.GetGreeting() };
+    uint16_t lens[4];
+    size_t len = PAYLOADHEADER;
+    for (int i = 0; i < 4; i++)
+    {
+        if (fields[i]->size() > UINT16_MAX)
+            throw std::length_error("PersonStore: field longer than 65535 characters");
+        lens[i] = static_cast<uint16_t>(fields[i]->size());
+        len += lens[i];
+    }
+    record.resize(RECORDHEADER + len);
+    char *r = &record[0];
+    uint32_t len32 = static_cast<uint32_t>(len);
+    std::memcpy(r, &len32, sizeof(len32));
+    std::memcpy(r + RECORDHEADER, lens, sizeof(lens));
+    r[RECORDHEADER + sizeof(lens)] = p.GetMiddleInitial();
+    char *s = r + RECORDHEADER + PAYLOADHEADER;
+    for (auto f : fields)
+    {
+        std::memcpy(s, f->data(), f->size());
+        s += f->size();
+    }
+    uint32_t sum = Checksum(r + RECORDHEADER, len);
+    std::memcpy(r + 4, &sum, sizeof(sum));
+
+    if (logEnd + record.size() > logReserved)
+        MapLog(logReserved * 2);
+    if (pwrite(logFd, record.data(), record.size(), logEnd) != static_cast<ssize_t>(record.size()))
+        Fail("append to " + logPath);
+    uint64_t offset = logEnd;
+    logEnd += record.size();
+    IndexInsert(Hash(p.GetLastName()), p.GetLastName(), offset);
+    if (++unsynced >= syncEvery)
+        Sync();
+}
+
+// Make every appended record durable with one fdatasync()
+void PersonStore::Sync()
+{
+    if (unsynced == 0)
+        return;
+    if (fdatasync(logFd) != 0)
+        Fail("sync " + logPath);
+    unsynced = 0;
+}
+
+// Rewrite the log with only the latest record for each key. The new log is written and synced under a temporary
+// name, then renamed over the old one; a crash at any point leaves either the old log or the new one (and since
+// the index is not marked clean until close, it is rebuilt from whichever log survives).
+void PersonStore::Compact()
+{
+    Sync();
+    string tmpPath = logPath + ".tmp";
+    int fd = open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        Fail("create " + tmpPath);
+    string buffer(LOGMAGIC, HEADERBYTES);
+    uint64_t newEnd = 0;
+    Slot *slots = Slots();
+    vector<uint64_t> newOffsets(index->capacity, 0);   // applied only once the new log is in place
+    for (uint64_t i = 0; i < index->capacity; i++)
+    {
+        if (slots[i].offset == 0)
+            continue;
+        size_t len = RecordLength(slots[i].offset, logEnd);
+        uint64_t newOffset = newEnd + buffer.size();
+        buffer.append(log + slots[i].offset, len);
+        newOffsets[i] = newOffset;
+        if (buffer.size() >= (1 << 20))
+        {
+            if (pwrite(fd, buffer.data(), buffer.size(), newEnd) != static_cast<ssize_t>(buffer.size()))
+                Fail("write " + tmpPath);
+            newEnd += buffer.size();
+            buffer.clear();
+        }
+    }
+    if (pwrite(fd, buffer.data(), buffer.size(), newEnd) != static_cast<ssize_t>(buffer.size()) || fdatasync(fd) != 0)
+        Fail("write " + tmpPath);
+    newEnd += buffer.size();
+    if (rename(tmpPath.c_str(), logPath.c_str()) != 0)
+        Fail("rename " + tmpPath);
+    SyncDirectory();
+    for (uint64_t i = 0; i < index->capacity; i++)
+        slots[i].offset = newOffsets[i];
+    close(logFd);
+    logFd = fd;
+    logEnd = newEnd;
+    MapLog(logReserved);
+}
+
+
+// CitizenDataBase is the Adapter class (the class wrapping the undesired interfaces)
+class CitizenDataBase
+{
+private:
+    string name;
+    PersonStore store;
+public:
+    // No default constructor (unusual)
+    CitizenDataBase(const string &, size_t = 64);
+    CitizenDataBase(const CitizenDataBase &) = delete;  // prohibit copies
+    CitizenDataBase &operator=(const CitizenDataBase &) = delete;  // prohibit assignment
+    virtual ~CitizenDataBase();  // destructor
+    optional<Person> Read(const string &);
+    optional<PersonView> ReadView(string_view) const;   // zero-copy
+    string Write(const Person &);
+    void Sync() { store.Sync(); }
+    void Compact() { store.Compact(); }
+    const PersonStore &GetStore() const { return store; }
+};
+
+CitizenDataBase::CitizenDataBase(const string &n, size_t syncEvery) : name(n), store(n, syncEvery)
+{
+}
+
+CitizenDataBase::~CitizenDataBase()
+{
+}
+
+optional<Person> CitizenDataBase::Read(const string &key)
+{
+    PersonView view;
+    if (store.Find(key, view))
+        return view.ToPerson();
+    return std::nullopt;
+}
+
+optional<PersonView> CitizenDataBase::ReadView(string_view key) const
+{
+    PersonView view;
+    if (store.Find(key, view))
+        return view;
+    return std::nullopt;
+}
+
+string CitizenDataBase::Write(const Person &data)
+{
+    store.Append(data);
+    return data.GetLastName();
+}
+
+
+void RemoveStore(const string &name)
+{
+    std::remove((name + ".log").c_str());
+    std::remove((name + ".idx").c_str());
+}
+
+// Benchmark: sequential writes at several sync batch sizes, cold start (with a clean index, and rebuilding it),
+// random reads (zero-copy and copying), and compaction
+void Benchmark(int numRecords)
+{
+    using Clock = std::chrono::steady_clock;
+    auto seconds = [](Clock::time_point start) { return std::chrono::duration<double>(Clock::now() - start).count(); };
+    string name("BenchData");
+    vector<Person> people;
+    for (int i = 0; i < numRecords; i++)
+        people.emplace_back("First", "Last" + to_string(i), 'M', "Mr.");
+    cout << std::fixed << std::setprecision(0);
+
+    for (size_t syncEvery : { 1, 64, 4096 })
+    {
+        RemoveStore(name);
+        int n = syncEvery == 1 ? std::min(numRecords, 2000) : numRecords;   // one fdatasync per write is slow
+        CitizenDataBase db(name, syncEvery);
+        auto start = Clock::now();
+        for (int i = 0; i < n; i++)
+            db.Write(people[i]);
+        db.Sync();
+        cout << "  Sequential write, sync every " << std::setw(4) << syncEvery << ": " << std::setw(10) << n / seconds(start) << " writes/sec" << endl;
+    }
+
+    auto start = Clock::now();
+    {
+        CitizenDataBase db(name);
+        cout << std::setprecision(2) << "  Cold start, clean index:       " << std::setw(10) << 1000 * seconds(start) << " ms ("
+             << db.GetStore().Count() << " records, rebuilt: " << db.GetStore().IndexWasRebuilt() << ")" << endl;
+    }
+    std::remove((name + ".idx").c_str());
+    start = Clock::now();
+    {
+        CitizenDataBase db(name);
+        cout << "  Cold start, rebuilding index:  " << std::setw(10) << 1000 * seconds(start) << " ms ("
+             << db.GetStore().Count() << " records, rebuilt: " << db.GetStore().IndexWasRebuilt() << ")" << endl;
+    }
+
+    CitizenDataBase db(name, 4096);
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> pick(0, numRecords - 1);
+    vector<string> keys;
+    for (int i = 0; i < numRecords; i++)
+        keys.push_back("Last" + to_string(pick(gen)));
+    size_t checksum = 0;
+    start = Clock::now();
+    for (const auto &k : keys)
+        checksum += db.ReadView(k)->greeting.size();
+    cout << std::setprecision(0) << "  Random read, zero-copy view:   " << std::setw(10) << numRecords / seconds(start) << " reads/sec" << endl;
+    start = Clock::now();
+    for (const auto &k : keys)
+        checksum += db.Read(k)->GetGreeting().size();
+    cout << "  Random read, copied Person:    " << std::setw(10) << numRecords / seconds(start) << " reads/sec" << endl;
+
+    for (auto &p : people)   // overwrite every record, doubling the log
+    {
+        p.SetGreeting("Good day");
+        db.Write(p);
+    }
+    size_t before = db.GetStore().LogBytes();
+    start = Clock::now();
+    db.Compact();
+    cout << std::setprecision(2) << "  Compaction: " << before << " -> " << db.GetStore().LogBytes() << " bytes in "
+         << 1000 * seconds(start) << " ms; greeting now: " << db.ReadView("Last0")->greeting << endl;
+    cout.unsetf(std::ios::fixed);
+    cout << std::setprecision(6) << "(checksum " << checksum << ")" << endl;
+    RemoveStore(name);
+}
+
+
+int main(int argc, char *argv[])
+{
+    string name("PersonData");
+    RemoveStore(name);   // start the example with an empty store
+
+    Person p1("Curt", "Jeffreys", 'M', "Mr.");
+    {
+        CitizenDataBase People(name);   // create a Database
+        string key = People.Write(p1);
+        People.Read(key)->Print();
+        p1.SetGreeting("Good day");
+        People.Write(p1);               // the newer record replaces the older in the index
+        cout << "Greeting (read in place): " << People.ReadView(key)->greeting << endl;
+    }
+    {
+        CitizenDataBase People(name);   // reopen: the clean index is used as is
+        cout << "After reopening, rebuilt index? " << People.GetStore().IndexWasRebuilt() << "; "
+             << People.GetStore().Count() << " record(s); greeting: " << People.Read("Jeffreys")->Speak() << endl;
+        People.Compact();
+        cout << "After compaction, log is " << People.GetStore().LogBytes() << " bytes" << endl;
+        People.Write(Person("Hawkeye", "Pierce", 'B', "Capt."));
+    }
+    {
+        // Simulate a crash mid-append: half of a record at the end of the log, and an index not marked clean
+        int fd = open((name + ".log").c_str(), O_WRONLY | O_APPEND);
+        const char torn[] = { 60, 0, 0, 0, 1, 2, 3, 4, 5, 6 };
+        bool ok = write(fd, torn, sizeof(torn)) == static_cast<ssize_t>(sizeof(torn));
+        close(fd);
+        std::remove((name + ".idx").c_str());
+        CitizenDataBase People(name);
+        cout << "After a torn append (" << ok << "), rebuilt index? " << People.GetStore().IndexWasRebuilt() << "; "
+             << People.GetStore().Count() << " record(s), log is " << People.GetStore().LogBytes() << " bytes" << endl;
+    }
+    auto openDamaged = [&name](const char *what, const void *bytes, size_t count, off_t at)
+    {
+        int fd = open((name + ".log").c_str(), O_RDWR);
+        char saved[8];
+        bool ok = pread(fd, saved, count, at) == static_cast<ssize_t>(count) &&
+                  pwrite(fd, bytes, count, at) == static_cast<ssize_t>(count);
+        std::remove((name + ".idx").c_str());
+        try
+        {
+            CitizenDataBase People(name);
+            cout << "Opened a log with " << what << " (" << ok << ")!" << endl;
+        }
+        catch (const std::runtime_error &e)
+        {
+            cout << "With " << what << ", refused to open: " << e.what() << endl;
+        }
+        ok = pwrite(fd, saved, count, at) == static_cast<ssize_t>(count);   // undo the damage
+        close(fd);
+    };
+    {
+        // Damage the first record, which has a valid record after it: either way, the store must not open
+        struct stat st;
+        stat((name + ".log").c_str(), &st);
+        uint32_t toEnd = static_cast<uint32_t>(st.st_size - 16 - 8);   // a length which runs to the end of the log
+        openDamaged("a damaged length", &toEnd, sizeof(toEnd), 16);
+        openDamaged("a damaged byte", "?", 1, 30);
+    }
+    RemoveStore(name);
+
+    int numRecords = argc > 1 ? std::stoi(argv[1]) : 200000;
+    cout << endl << "Benchmark: " << numRecords << " Persons" << endl;
+    Benchmark(numRecords);
+
+    return 0;
+}
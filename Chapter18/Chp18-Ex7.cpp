@@ -0,0 +1,495 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate pooling instances of an Adapter class which wraps an expensive-to-open resource.
+// In Chp18-Ex3.cpp, CitizenDataBase calls db_open() in its constructor and db_close() in its destructor, and may
+// not be copied. So, each thread which needs the database either opens its own (paying for db_open() each time),
+// or shares one unsafely. Here, a CitizenDataBasePool keeps a bounded number of open CitizenDataBase instances.
+// A thread leases one (waiting, up to a timeout, if all are in use), and the Lease returns it to the pool when the
+// Lease goes out of scope. An idle instance is health-checked before it is leased again; one which fails (or whose
+// lease was invalidated) is closed and replaced. Lease wait times are measured.
+// Compile with: g++ -std=c++17 -O2 -pthread Chp18-Ex7.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cassert>
+
+using std::cout;    // preferable to: using namespace std;
+using std::endl;
+using std::string;
+using std::to_string;
+using std::vector;
+using std::unordered_map;
+using std::unique_ptr;
+using std::make_unique;
+using std::optional;
+using std::thread;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::condition_variable;
+using std::atomic;
+using std::memory_order_relaxed;
+using Clock = std::chrono::steady_clock;
+
+class Person
+{
+private:
+   string firstName;
+   string lastName;
+   char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+   string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+   string greeting;
+protected:
+   void ModifyTitle(const string &);  // Make this operation available to derived classes
+public:
+   Person() = default;   // default constructor
+   Person(const string &, const string &, char, const string &);  // alternate constructor
+   virtual ~Person() = default;  // virtual destructor
+   const string &GetFirstName() const { return firstName; }
+   const string &GetLastName() const { return lastName; }
+   const string &GetTitle() const { return title; }
+   const string &GetGreeting() const { return greeting; }
+   void SetGreeting(const string &);
+   virtual const string &Speak() { return greeting; }
+   virtual void Print() const;
+};
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) :
+               firstName(fn), lastName(ln), middleInitial(mi), title(t), greeting("Hello")
+{
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+   title = newTitle;
+}
+
+void Person::SetGreeting(const string &newGreeting)
+{
+   greeting = newGreeting;
+}
+
+void Person::Print() const
+{
+   cout << title << " " << firstName << " " << lastName << endl;
+}
+
+
+// External database access functions -- a local stand-in for a database server. Opening a handle is slow (a
+// simulated connection setup), each request takes a little time, and db_restart() simulates the server
+// restarting, which breaks every handle opened before it.
+struct DbHandle
+{
+    string dbName;
+    long generation;
+};
+
+namespace
+{
+    unordered_map<string, Person> records;
+    mutex recordsLock;
+    atomic<long> serverGeneration(0);
+    atomic<long> handlesOpened(0);
+    std::chrono::microseconds openLatency(2000);
+    std::chrono::microseconds requestLatency(100);
+}
+
+DbHandle *db_open(const string &dbName)
+{
+    std::this_thread::sleep_for(openLatency);
+    handlesOpened.fetch_add(1, memory_order_relaxed);
+    return new DbHandle { dbName, serverGeneration.load() };
+}
+
+void db_close(DbHandle *handle)
+{
+    delete handle;
+}
+
+bool db_ping(DbHandle *handle)   // a cheap health check
+{
+    return handle->generation == serverGeneration.load();
+}
+
+void db_restart()
+{
+    serverGeneration.fetch_add(1);
+}
+
+// Fills in the caller's Person; returns false if there is no such key. Throws if the handle is broken.
+bool db_read(DbHandle *handle, const string &key, Person &result)
+{
+    std::this_thread::sleep_for(requestLatency);
+    if (!db_ping(handle))
+        throw std::runtime_error("db_read: connection to " + handle->dbName + " lost");
+    lock_guard<mutex> guard(recordsLock);
+    auto iter = records.find(key);
+    if (iter == records.end())
+        return false;
+    result = iter->second;
+    return true;
+}
+
+string db_write(DbHandle *handle, const Person &data)
+{
+    std::this_thread::sleep_for(requestLatency);
+    if (!db_ping(handle))
+        throw std::runtime_error("db_write: connection to " + handle->dbName + " lost");
+    lock_guard<mutex> guard(recordsLock);
+    records[data.GetLastName()] = data;
+    return data.GetLastName();
+}
+
+
+// CitizenDataBase is the Adapter class (the class wrapping the undesired interfaces)
+class CitizenDataBase
+{
+private:
+    string name;
+    DbHandle *handle;
+public:
+    // No default constructor (unusual)
+    CitizenDataBase(const string &);
+    CitizenDataBase(const CitizenDataBase &) = delete;  // prohibit copies
+    CitizenDataBase &operator=(const CitizenDataBase &) = delete;  // prohibit assignment
+    virtual ~CitizenDataBase();  // destructor
+    const string &GetName() const { return name; }
+    bool IsHealthy() const { return db_ping(handle); }
+    optional<Person> Read(const string &);
+    string Write(const Person &);
+};
+
+CitizenDataBase::CitizenDataBase(const string &n) : name(n)
+{
+    handle = db_open(name);   // calling an existing external function
+}
+
+CitizenDataBase::~CitizenDataBase()
+{
+    db_close(handle);  // close database with external function
+}
+
+optional<Person> CitizenDataBase::Read(const string &key)
+{
+    Person result;
+    if (db_read(handle, key, result))   // call external function
+        return result;
+    return std::nullopt;
+}
+
+string CitizenDataBase::Write(const Person &data)
+{
+    return db_write(handle, data);  // call external function
+}
+
+
+struct PoolStats
+{
+    long leases = 0;
+    long waited = 0;        // leases which had to wait for an instance to be returned
+    long timeouts = 0;
+    long opens = 0;
+    long closes = 0;
+    long healthFailures = 0;
+    double averageWaitMs = 0.0;
+    double maxWaitMs = 0.0;
+};
+
+// A bounded pool of open CitizenDataBase instances, for one database. Instances are opened on demand (outside
+// the pool's lock, since opening is slow) until maxSize are open; after that, Acquire() waits for a Lease to end.
+// Leases must not outlive their pool.
+class CitizenDataBasePool
+{
+public:
+    class Lease
+    {
+    private:
+        CitizenDataBasePool *pool = nullptr;
+        unique_ptr<CitizenDataBase> db;
+        bool broken = false;
+        friend class CitizenDataBasePool;
+        Lease(CitizenDataBasePool *p, unique_ptr<CitizenDataBase> d) : pool(p), db(std::move(d)) { }
+    public:
+        Lease() = default;   // an empty lease (Acquire() timed out)
+        Lease(Lease &&other) noexcept : pool(other.pool), db(std::move(other.db)), broken(other.broken) { other.pool = nullptr; }
+        Lease &operator=(Lease &&);
+        ~Lease() { if (db) pool->Return(std::move(db), broken); }
+        explicit operator bool() const { return db != nullptr; }
+        CitizenDataBase *operator->() const { return db.get(); }
+        CitizenDataBase &operator*() const { return *db; }
+        void Invalidate() { broken = true; }   // e.g. after an error: close this instance instead of reusing it
+    };
+private:
+    string name;
+    size_t maxSize;
+    mutex lock;
+    condition_variable available;
+    vector<unique_ptr<CitizenDataBase>> idle;   // most recently returned at the back
+    size_t open = 0;      // idle, leased, or being opened
+    size_t leased = 0;
+    atomic<long> leases, waited, timeouts, opens, closes, healthFailures;
+    atomic<long> totalWaitNs, maxWaitNs;
+    void Return(unique_ptr<CitizenDataBase>, bool);
+    Lease Leased(unique_ptr<CitizenDataBase>, Clock::time_point);
+    void Close(unique_ptr<CitizenDataBase>);
+public:
+    CitizenDataBasePool(const string &, size_t, size_t = 0);
+    CitizenDataBasePool(const CitizenDataBasePool &) = delete;
+    CitizenDataBasePool &operator=(const CitizenDataBasePool &) = delete;
+    ~CitizenDataBasePool();
+    Lease Acquire(std::chrono::milliseconds = std::chrono::milliseconds(1000));
+    PoolStats GetStats() const;
+};
+
+CitizenDataBasePool::Lease &CitizenDataBasePool::Lease::operator=(Lease &&other)
+{
+    if (this != &other)
+    {
+        if (db)
+            pool->Return(std::move(db), broken);
+        pool = other.pool;
+        db = std::move(other.db);
+        broken = other.broken;
+        other.pool = nullptr;
+    }
+    return *this;
+}
+
+// Opens minIdle instances up front, so that the first requests need not wait for db_open()
+CitizenDataBasePool::CitizenDataBasePool(const string &n, size_t max, size_t minIdle) :
+                     name(n), maxSize(max > 0 ? max : 1), leases(0), waited(0), timeouts(0), opens(0), closes(0),
+                     healthFailures(0), totalWaitNs(0), maxWaitNs(0)
+{
+    for (size_t i = 0; i < minIdle && i < maxSize; i++)
+    {
+        idle.push_back(make_unique<CitizenDataBase>(name));
+        open++;
+        opens++;
+    }
+}
+
+CitizenDataBasePool::~CitizenDataBasePool()
+{
+    assert(leased == 0 && "a Lease outlived its CitizenDataBasePool");
+}
+
+void CitizenDataBasePool::Close(unique_ptr<CitizenDataBase> db)
+{
+    db.reset();   // db_close(), outside the pool's lock
+    closes.fetch_add(1, memory_order_relaxed);
+    lock_guard<mutex> guard(lock);
+    open--;
+    available.notify_one();   // there is room to open another
+}
+
+CitizenDataBasePool::Lease CitizenDataBasePool::Leased(unique_ptr<CitizenDataBase> db, Clock::time_point start)
+{
+    long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    leases.fetch_add(1, memory_order_relaxed);
+    totalWaitNs.fetch_add(ns, memory_order_relaxed);
+    long max = maxWaitNs.load(memory_order_relaxed);
+    while (ns > max && !maxWaitNs.compare_exchange_weak(max, ns, memory_order_relaxed))
+        ;
+    return Lease(this, std::move(db));
+}
+
+// Lease an idle instance (after a health check), or open a new one if there is room, or else wait for a return.
+// Returns an empty Lease if none is available within the timeout.
+CitizenDataBasePool::Lease CitizenDataBasePool::Acquire(std::chrono::milliseconds timeout)
+{
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + timeout;
+    bool hadToWait = false;
+    unique_lock<mutex> guard(lock);
+    for (;;)
+    {
+        if (!idle.empty())
+        {
+            unique_ptr<CitizenDataBase> db = std::move(idle.back());
+            idle.pop_back();
+            leased++;
+            guard.unlock();
+            if (db->IsHealthy())
+                return Leased(std::move(db), start);
+            healthFailures.fetch_add(1, memory_order_relaxed);
+            Close(std::move(db));
+            guard.lock();
+            leased--;
+            continue;   // try the next idle instance, or open a fresh one
+        }
+        if (open < maxSize)
+        {
+            open++;
+            leased++;
+            guard.unlock();
+            unique_ptr<CitizenDataBase> db;
+            try
+            {
+                db = make_unique<CitizenDataBase>(name);
+            }
+            catch (...)
+            {
+                guard.lock();
+                open--;
+                leased--;
+                available.notify_one();
+                throw;
+            }
+            opens.fetch_add(1, memory_order_relaxed);
+            return Leased(std::move(db), start);
+        }
+        if (!hadToWait)
+        {
+            hadToWait = true;
+            waited.fetch_add(1, memory_order_relaxed);
+        }
+        if (available.wait_until(guard, deadline) == std::cv_status::timeout && idle.empty() && open >= maxSize)
+        {
+            timeouts.fetch_add(1, memory_order_relaxed);
+            return Lease();
+        }
+    }
+}
+
+void CitizenDataBasePool::Return(unique_ptr<CitizenDataBase> db, bool broken)
+{
+    {
+        lock_guard<mutex> guard(lock);
+        leased--;
+    }
+    if (broken)
+    {
+        Close(std::move(db));
+        return;
+    }
+    lock_guard<mutex> guard(lock);
+    idle.push_back(std::move(db));
+    available.notify_one();
+}
+
+PoolStats CitizenDataBasePool::GetStats() const
+{
+    PoolStats s;
+    s.leases = leases.load();
+    s.waited = waited.load();
+    s.timeouts = timeouts.load();
+    s.opens = opens.load();
+    s.closes = closes.load();
+    s.healthFailures = healthFailures.load();
+    s.averageWaitMs = s.leases > 0 ? totalWaitNs.load() / 1e6 / s.leases : 0.0;
+    s.maxWaitMs = maxWaitNs.load() / 1e6;
+    return s;
+}
+
+
+// Benchmark: numThreads threads each serve requestsPerThread requests (one read each), either opening their own
+// CitizenDataBase per request, or leasing one from a pool; the server restarts once, halfway through
+void Benchmark(int numThreads, int requestsPerThread, size_t poolSize)
+{
+    auto run = [numThreads, requestsPerThread](auto serve) {
+        vector<thread> threads;
+        auto start = Clock::now();
+        for (int t = 0; t < numThreads; t++)
+            threads.emplace_back([&serve, t, requestsPerThread]() {
+                for (int i = 0; i < requestsPerThread; i++)
+                {
+                    if (t == 0 && i == requestsPerThread / 2)
+                        db_restart();
+                    serve("Last" + to_string((t * requestsPerThread + i) % 1000));
+                }
+            });
+        for (auto &th : threads)
+            th.join();
+        return numThreads * requestsPerThread / std::chrono::duration<double>(Clock::now() - start).count();
+    };
+
+    long before = handlesOpened.load();
+    double perRequest = run([](const string &key) {
+        for (;;)
+        {
+            try
+            {
+                CitizenDataBase db("PersonData");
+                db.Read(key);
+                return;
+            }
+            catch (const std::runtime_error &)
+            {
+                // the server restarted between our open and our read; open again
+            }
+        }
+    });
+    long perRequestOpens = handlesOpened.load() - before;
+
+    CitizenDataBasePool pool("PersonData", poolSize);
+    atomic<long> retried(0);
+    double pooled = run([&pool, &retried](const string &key) {
+        for (;;)
+        {
+            CitizenDataBasePool::Lease db = pool.Acquire();
+            if (!db)
+                continue;   // timed out; try again
+            try
+            {
+                db->Read(key);
+                return;
+            }
+            catch (const std::runtime_error &)
+            {
+                db.Invalidate();   // the connection broke while leased; retry on another
+                retried.fetch_add(1, memory_order_relaxed);
+            }
+        }
+    });
+    PoolStats s = pool.GetStats();
+
+    cout << std::fixed << std::setprecision(0);
+    cout << std::setw(4) << numThreads << " threads:  open per request " << std::setw(7) << perRequest << " req/sec ("
+         << perRequestOpens << " opens);  pool of " << poolSize << " " << std::setw(7) << pooled << " req/sec ("
+         << s.opens << " opens, " << s.healthFailures << " failed checks, " << retried.load() << " retries)" << endl;
+    cout << std::setprecision(3) << "              lease wait: avg " << s.averageWaitMs << " ms, max " << s.maxWaitMs
+         << " ms; " << s.waited << " of " << s.leases << " leases waited, " << s.timeouts << " timeouts" << endl;
+    cout.unsetf(std::ios::fixed);
+    cout << std::setprecision(6);
+}
+
+
+int main(int argc, char *argv[])
+{
+    {
+        CitizenDataBasePool pool("PersonData", 2, 1);   // at most 2 open; 1 opened up front
+        {
+            CitizenDataBasePool::Lease db = pool.Acquire();
+            string key = db->Write(Person("Curt", "Jeffreys", 'M', "Mr."));
+            db->Read(key)->Print();
+        }   // the Lease returns the instance to the pool
+        db_restart();   // every open handle is now broken
+        {
+            CitizenDataBasePool::Lease db = pool.Acquire();   // the idle instance fails its health check; a new one is opened
+            db->Read("Jeffreys")->Print();
+            CitizenDataBasePool::Lease db2 = pool.Acquire();
+            CitizenDataBasePool::Lease db3 = pool.Acquire(std::chrono::milliseconds(10));   // the pool is exhausted
+            cout << "Third lease granted? " << static_cast<bool>(db3) << endl;
+        }
+        PoolStats s = pool.GetStats();
+        cout << "leases: " << s.leases << " opens: " << s.opens << " failed health checks: " << s.healthFailures
+             << " timeouts: " << s.timeouts << endl;
+    }
+
+    int requestsPerThread = argc > 1 ? std::stoi(argv[1]) : 200;
+    cout << endl << "Benchmark: " << requestsPerThread << " requests per thread, " << openLatency.count() << "us to open, "
+         << requestLatency.count() << "us per request" << endl;
+    for (int numThreads : { 1, 8, 64 })
+        Benchmark(numThreads, requestsPerThread, 8);
+
+    return 0;
+}
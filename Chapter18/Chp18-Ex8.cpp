@@ -0,0 +1,293 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate an Adapter class which embeds its Adaptee by value, with compile-time (CRTP) dispatch.
+// In Chp18-Ex2.cpp, Humanoid holds a heap-allocated Person *life, and each GetPrimaryName(), GetSecondaryName()
+// and Converse() call goes through that pointer (and Converse() through a virtual call besides). Each copy of a
+// Humanoid allocates a new Person. Here, Humanoid<Species> contains its Person directly, and Converse() is resolved
+// at compile time via the Curiously Recurring Template Pattern: Humanoid<Orkan> calls Orkan::ConverseImpl().
+// Copies and assignments are member-wise and make no allocations (as long as each string fits within the library's
+// short-string buffer, as all these names do). With no common base class, a mixed population is held in a
+// std::variant of the species, visited without any heap allocation or virtual call.
+// Compile with: g++ -std=c++17 -O2 Chp18-Ex8.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <variant>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+using std::cout;    // preferable to: using namespace std;
+using std::endl;
+using std::string;
+using std::vector;
+using std::variant;
+
+// Count heap allocations, so that the benchmark can show which copies allocate
+namespace
+{
+    long allocations = 0;
+}
+
+void *operator new(std::size_t size)
+{
+    allocations++;
+    if (void *p = std::malloc(size > 0 ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+// Person is the Adaptee class (the class requiring an adaptation)
+class Person
+{
+private:
+   string firstName;
+   string lastName;
+   char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+   string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+   string greeting;
+public:
+   Person() = default;   // default constructor
+   Person(const string &, const string &, char, const string &);  // alternate constructor
+   // Default copy constructor and assignment operator suffice (and make no allocations for short strings)
+   virtual ~Person() = default;  // virtual destructor
+   const string &GetFirstName() const { return firstName; }
+   const string &GetLastName() const { return lastName; }
+   const string &GetTitle() const { return title; }
+   char GetMiddleInitial() const { return middleInitial; }
+   void ModifyTitle(const string &);
+   void SetGreeting(const string &);
+   virtual const string &Speak() { return greeting; }
+   virtual void Print() const;
+};
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) :
+               firstName(fn), lastName(ln), middleInitial(mi), title(t), greeting("Hello")
+{
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+   title = newTitle;
+}
+
+void Person::SetGreeting(const string &newGreeting)
+{
+   greeting = newGreeting;
+}
+
+void Person::Print() const
+{
+   cout << title << " " << firstName << " " << lastName << endl;
+}
+
+
+// Adapter Class -- contains its Adaptee by value. Species is the derived class (Orkan, Romulan or Earthling).
+// Since life is a Person object (not a reference or pointer to one), calls such as life.Speak() are not virtual calls.
+template <typename Species>
+class Humanoid
+{
+private:
+   Person life;  // delegate all requests to the contained object
+protected:
+   void SetTitle(const string &t) { life.ModifyTitle(t); }
+   Humanoid() = default;
+   Humanoid(const string &n2, const string &n1, const string &planetNation, const string &greeting) :
+            life(n2, n1, ' ', planetNation) { life.SetGreeting(greeting); }
+   // Default copy constructor, assignment operator and (non-virtual, protected) destructor suffice
+   ~Humanoid() = default;
+   const string &ConverseImpl() { return life.Speak(); }   // the default; a Species may hide it with its own
+public:
+   const string &GetSecondaryName() const { return life.GetFirstName(); }
+   const string &GetPrimaryName() const { return life.GetLastName(); }
+   const string &GetTitle() const { return life.GetTitle(); }
+   void SetSalutation(const string &m) { life.SetGreeting(m); }
+   void GetInfo() const { life.Print(); }
+   const string &Converse() { return static_cast<Species &>(*this).ConverseImpl(); }  // resolved at compile time
+};
+
+
+// One of several Target classes
+class Orkan: public Humanoid<Orkan>
+{
+   friend class Humanoid<Orkan>;   // so that Humanoid<Orkan>::Converse() may call our ConverseImpl()
+private:
+   // Optional with CRTP (without it, Humanoid's default is used) -- shown for symmetry with Chp18-Ex2.cpp
+   const string &ConverseImpl() { return Humanoid::ConverseImpl(); }
+public:
+   Orkan() = default;   // default constructor
+   Orkan(const string &n2, const string &n1, const string &t) : Humanoid(n2, n1, t, "Nanu nanu") { }
+};
+
+// One of several Target classes
+class Romulan: public Humanoid<Romulan>
+{
+public:
+   Romulan() = default;   // default constructor
+   Romulan(const string &n2, const string &n1, const string &t) : Humanoid(n2, n1, t, "jolan'tru") { }
+};
+
+// One of several Target classes
+class Earthling: public Humanoid<Earthling>
+{
+public:
+   Earthling() = default;   // default constructor
+   Earthling(const string &n2, const string &n1, const string &t) : Humanoid(n2, n1, t, "Hello") { }
+};
+
+using AnyHumanoid = variant<Orkan, Romulan, Earthling>;   // a mixed population, with no common base class
+
+
+// For comparison: the pointer-delegating Adapter from Chp18-Ex2.cpp (abbreviated)
+class DelegatingHumanoid
+{
+private:
+   Person *life = nullptr;  // delegate all requests to the associated object
+public:
+   DelegatingHumanoid(const string &n2, const string &n1, const string &planetNation, const string &greeting) :
+                      life(new Person(n2, n1, ' ', planetNation)) { life->SetGreeting(greeting); }
+   DelegatingHumanoid(const DelegatingHumanoid &h) : life(new Person(*h.life)) { }
+   DelegatingHumanoid &operator=(const DelegatingHumanoid &h) { if (this != &h) *life = *h.life; return *this; }
+   virtual ~DelegatingHumanoid() { delete life; life = nullptr; }
+   const string &GetPrimaryName() const { return life->GetLastName(); }
+   virtual const string &Converse() = 0;
+};
+
+const string &DelegatingHumanoid::Converse()
+{
+   return life->Speak();
+}
+
+class DelegatingOrkan: public DelegatingHumanoid
+{
+public:
+   DelegatingOrkan(const string &n2, const string &n1, const string &t) : DelegatingHumanoid(n2, n1, t, "Nanu nanu") { }
+   const string &Converse() override { return DelegatingHumanoid::Converse(); }
+};
+
+class DelegatingRomulan: public DelegatingHumanoid
+{
+public:
+   DelegatingRomulan(const string &n2, const string &n1, const string &t) : DelegatingHumanoid(n2, n1, t, "jolan'tru") { }
+   const string &Converse() override { return DelegatingHumanoid::Converse(); }
+};
+
+class DelegatingEarthling: public DelegatingHumanoid
+{
+public:
+   DelegatingEarthling(const string &n2, const string &n1, const string &t) : DelegatingHumanoid(n2, n1, t, "Hello") { }
+   const string &Converse() override { return DelegatingHumanoid::Converse(); }
+};
+
+
+// Benchmark: Converse() on a mixed population, through Humanoid *'s (Chp18-Ex2.cpp) vs. visiting variants,
+// and through a single-species vector; then copying a vector of Orkans each way, counting allocations
+void Benchmark(int population, int rounds)
+{
+   using Clock = std::chrono::steady_clock;
+   auto nsPerCall = [population, rounds](Clock::time_point start) {
+      return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (double(population) * rounds);
+   };
+
+   vector<DelegatingHumanoid *> delegating;
+   vector<AnyHumanoid> inlined;
+   vector<Orkan> orkans;
+   for (int i = 0; i < population; i++)
+   {
+      switch (i % 3)
+      {
+         case 0: delegating.push_back(new DelegatingOrkan("Mork", "McConnell", "Orkan"));
+                 inlined.emplace_back(Orkan("Mork", "McConnell", "Orkan"));
+                 break;
+         case 1: delegating.push_back(new DelegatingRomulan("Donatra", "Jarok", "Romulan"));
+                 inlined.emplace_back(Romulan("Donatra", "Jarok", "Romulan"));
+                 break;
+         default: delegating.push_back(new DelegatingEarthling("Eve", "Xu", "Earthling"));
+                  inlined.emplace_back(Earthling("Eve", "Xu", "Earthling"));
+                  break;
+      }
+      orkans.emplace_back("Mork", "McConnell", "Orkan");
+   }
+
+   size_t checksum = 0;
+   auto start = Clock::now();
+   for (int r = 0; r < rounds; r++)
+      for (auto *h : delegating)
+         checksum += h->Converse().size();
+   cout << std::fixed << std::setprecision(2);
+   cout << "  Converse(), Humanoid * (virtual, via Person *): " << std::setw(6) << nsPerCall(start) << " ns/call" << endl;
+
+   start = Clock::now();
+   for (int r = 0; r < rounds; r++)
+      for (auto &h : inlined)
+         checksum += std::visit([](auto &species) -> const string & { return species.Converse(); }, h).size();
+   cout << "  Converse(), variant of inline Humanoids:       " << std::setw(6) << nsPerCall(start) << " ns/call" << endl;
+
+   start = Clock::now();
+   for (int r = 0; r < rounds; r++)
+      for (auto &o : orkans)
+         checksum += o.Converse().size();
+   cout << "  Converse(), vector<Orkan> (inline, CRTP):      " << std::setw(6) << nsPerCall(start) << " ns/call" << endl;
+
+   vector<DelegatingOrkan> delegatingOrkans(population, DelegatingOrkan("Mork", "McConnell", "Orkan"));
+   long before = allocations;
+   vector<DelegatingOrkan> delegatingCopy(delegatingOrkans);
+   long delegatingAllocs = allocations - before;
+   before = allocations;
+   vector<Orkan> inlinedCopy(orkans);
+   long inlinedAllocs = allocations - before;
+   cout << "  Copying " << population << " Orkans: " << delegatingAllocs << " allocations (via Person *) vs. "
+        << inlinedAllocs << " (inline; that one is the vector's own array)" << endl;
+   cout << "  sizeof: DelegatingOrkan " << sizeof(DelegatingOrkan) << " + Person " << sizeof(Person) << " on the heap; Orkan "
+        << sizeof(Orkan) << "; AnyHumanoid " << sizeof(AnyHumanoid) << endl;
+   cout.unsetf(std::ios::fixed);
+   cout << std::setprecision(6) << "(checksum " << checksum + delegatingCopy.size() + inlinedCopy.size() << ")" << endl;
+
+   for (auto *h : delegating)
+      delete h;
+}
+
+
+int main(int argc, char *argv[])
+{
+   vector<AnyHumanoid> allies;
+   allies.reserve(3);
+   allies.emplace_back(Orkan("Mork", "McConnell", "Orkan"));
+   allies.emplace_back(Romulan("Donatra", "Jarok", "Romulan"));
+   allies.emplace_back(Earthling("Eve", "Xu", "Earthling"));
+
+   for (auto &entity : allies)
+   {
+      std::visit([](auto &h) {
+         h.GetInfo();
+         cout << h.Converse() << endl;
+      }, entity);
+   }
+
+   // Though each type of Humanoid has a default Salutation, each may expand their language skills and choose an alternate language
+   Earthling e1("Eve", "Xu", "Earthling");
+   long before = allocations;
+   Earthling e2 = e1;   // copies the contained Person -- no allocation
+   e2.SetSalutation("Bonjour");
+   e1 = e2;             // assigns the contained Person -- no allocation
+   cout << "Allocations while copying and assigning: " << allocations - before << endl;
+   e1.GetInfo();
+   cout << e1.Converse() << endl;  // Show the Earthling's revised language capabilities
+
+   int population = argc > 1 ? std::atoi(argv[1]) : 100000;
+   int rounds = argc > 2 ? std::atoi(argv[2]) : 100;
+   cout << endl << "Benchmark: " << population << " Humanoids, " << rounds << " rounds of Converse()" << endl;
+   Benchmark(population, rounds);
+
+   return 0;
+}
@@ -0,0 +1,296 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate the Flyweight pattern alongside an Adapter: species-constant strings, shared by index.
+// In Chp18-Ex1.cpp and Chp18-Ex2.cpp, every Orkan, Romulan and Earthling copies its species' greeting ("Nanu nanu",
+// "jolan'tru", ...) and title into its own Person::greeting and Person::title strings. Across millions of Humanoids,
+// that is the same few strings over and over. Here, SharedStrings is a flyweight factory: each distinct string is
+// stored once, and a Person refers to its title and greeting by a 2 byte index. A Humanoid may still override its
+// greeting (SetSalutation()); the override is itself interned, so the table holds one entry per distinct string,
+// not one per Humanoid.
+// Compile with: g++ -std=c++17 -O2 Chp18-Ex9.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+using std::cout;    // preferable to: using namespace std;
+using std::endl;
+using std::string;
+using std::vector;
+using std::deque;
+using std::unordered_map;
+
+// Count the bytes requested from the heap, so that the benchmark can report bytes per Humanoid
+namespace
+{
+    size_t heapBytes = 0;
+}
+
+void *operator new(std::size_t size)
+{
+    heapBytes += size;
+    if (void *p = std::malloc(size > 0 ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+
+// The Flyweight factory: interns strings, handing back a small index for each distinct one.
+// Entries are never removed, and a deque never moves its elements, so references from Get() stay valid.
+// Like the rest of this example, it is not synchronized for use by several threads.
+class SharedStrings
+{
+private:
+    static deque<string> &Table() { static deque<string> table; return table; }   // constructed on first use
+    static unordered_map<string, uint16_t> &Index() { static unordered_map<string, uint16_t> index; return index; }
+public:
+    static uint16_t Intern(const string &);
+    static const string &Get(uint16_t id) { return Table()[id]; }
+    static size_t Count() { return Table().size(); }
+};
+
+uint16_t SharedStrings::Intern(const string &s)
+{
+    auto iter = Index().find(s);
+    if (iter != Index().end())
+        return iter->second;
+    if (Table().size() > UINT16_MAX)
+        throw std::length_error("SharedStrings: more than 65536 distinct strings");
+    uint16_t id = static_cast<uint16_t>(Table().size());
+    Table().push_back(s);
+    Index().emplace(s, id);
+    return id;
+}
+
+
+// Person is the Adaptee class (the class requiring an adaptation)
+// Its title and greeting are indices into SharedStrings, rather than strings of its own
+class Person
+{
+private:
+   string firstName;
+   string lastName;
+   char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+   uint16_t titleId = 0;
+   uint16_t greetingId = HELLO;
+protected:
+   void ModifyTitle(const string &t) { titleId = SharedStrings::Intern(t); }  // Make this operation available to derived classes
+public:
+   static const uint16_t HELLO;   // the default greeting
+   Person() = default;   // default constructor
+   Person(const string &, const string &, char, const string &);  // alternate constructor
+   // Default copy constructor and assignment operator suffice
+   virtual ~Person() = default;  // virtual destructor
+   const string &GetFirstName() const { return firstName; }
+   const string &GetLastName() const { return lastName; }
+   const string &GetTitle() const { return SharedStrings::Get(titleId); }
+   char GetMiddleInitial() const { return middleInitial; }
+   void SetGreeting(const string &g) { greetingId = SharedStrings::Intern(g); }
+   void SetGreeting(uint16_t id) { greetingId = id; }   // an already-interned greeting: no lookup needed
+   virtual const string &Speak() { return SharedStrings::Get(greetingId); }
+   virtual void Print() const;
+};
+
+const uint16_t Person::HELLO = SharedStrings::Intern("Hello");
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) :
+               firstName(fn), lastName(ln), middleInitial(mi), titleId(SharedStrings::Intern(t))
+{
+}
+
+void Person::Print() const
+{
+   cout << GetTitle() << " " << firstName << " " << lastName << endl;
+}
+
+
+// Adapter Class -- uses private inheritance, as in Chp18-Ex1.cpp
+class Humanoid: private Person
+{
+protected:
+   void SetTitle(const string &t) { ModifyTitle(t); }  // calls Person::ModifyTitle()
+public:
+   Humanoid() = default;
+   Humanoid(const string &n2, const string &n1, const string &planetNation, uint16_t greeting) :
+            Person(n2, n1, ' ', planetNation) { SetGreeting(greeting); }
+   const string &GetSecondaryName() const { return GetFirstName(); }
+   const string &GetPrimaryName() const { return GetLastName(); }
+   const string &GetTitle() const { return Person::GetTitle(); }   // Scope resolution needed on GetTitle() to avoid recursion
+   void SetSalutation(const string &m) { SetGreeting(m); }   // a per-instance override (interned as well)
+   virtual void GetInfo() const { Print(); }
+   virtual const string &Converse() = 0;  // Pure virtual function prototype
+};
+
+const string &Humanoid::Converse()   // Yes, there can be a default implementation for a pure virtual function
+{
+   return Speak();
+}
+
+
+// One of several Target classes; each species interns its greeting once, when the program starts
+class Orkan: public Humanoid
+{
+public:
+   static const uint16_t GREETING;
+   Orkan() = default;   // default constructor
+   Orkan(const string &n2, const string &n1, const string &t) : Humanoid(n2, n1, t, GREETING) { }
+   const string &Converse() override { return Humanoid::Converse(); }
+};
+
+const uint16_t Orkan::GREETING = SharedStrings::Intern("Nanu nanu");
+
+class Romulan: public Humanoid
+{
+public:
+   static const uint16_t GREETING;
+   Romulan() = default;   // default constructor
+   Romulan(const string &n2, const string &n1, const string &t) : Humanoid(n2, n1, t, GREETING) { }
+   const string &Converse() override { return Humanoid::Converse(); }
+};
+
+const uint16_t Romulan::GREETING = SharedStrings::Intern("jolan'tru");
+
+class Earthling: public Humanoid
+{
+public:
+   static const uint16_t GREETING;
+   Earthling() = default;   // default constructor
+   Earthling(const string &n2, const string &n1, const string &t) : Humanoid(n2, n1, t, GREETING) { }
+   const string &Converse() override { return Humanoid::Converse(); }
+};
+
+const uint16_t Earthling::GREETING = ::Person::HELLO;   // scope resolution: the injected name Person is private here
+
+
+// For comparison: Chp18-Ex1.cpp's Person, which owns its title and greeting strings (abbreviated)
+class OwningPerson
+{
+private:
+   string firstName;
+   string lastName;
+   char middleInitial = '\0';
+   string title;
+   string greeting;
+public:
+   OwningPerson(const string &fn, const string &ln, char mi, const string &t) :
+                firstName(fn), lastName(ln), middleInitial(mi), title(t), greeting("Hello") { }
+   virtual ~OwningPerson() = default;
+   void SetGreeting(const string &newGreeting) { greeting = newGreeting; }
+   virtual const string &Speak() { return greeting; }
+};
+
+class OwningHumanoid: private OwningPerson
+{
+public:
+   OwningHumanoid(const string &n2, const string &n1, const string &planetNation, const string &greeting) :
+                  OwningPerson(n2, n1, ' ', planetNation) { SetGreeting(greeting); }
+   void SetSalutation(const string &m) { SetGreeting(m); }
+   virtual const string &Converse() { return Speak(); }
+};
+
+
+// Benchmark: bytes per Humanoid (the object itself plus whatever it allocates) for a mixed population, where every
+// tenth Humanoid overrides its salutation with a longer greeting (one that does not fit a short-string buffer)
+void Benchmark(int population)
+{
+   const string planets[3] = { "Orkan", "Romulan", "Earthling" };
+   const string greetings[3] = { "Nanu nanu", "jolan'tru", "Hello" };
+   const string longGreeting("Greetings and felicitations");
+   size_t checksum = 0;
+
+   vector<OwningHumanoid> owning;
+   owning.reserve(population);
+   size_t before = heapBytes;
+   for (int i = 0; i < population; i++)
+   {
+      owning.emplace_back("Eve", "Xu", planets[i % 3], greetings[i % 3]);
+      if (i % 10 == 9)
+         owning.back().SetSalutation(longGreeting);
+   }
+   double owningBytes = sizeof(OwningHumanoid) + double(heapBytes - before) / population;
+   for (auto &h : owning)
+      checksum += h.Converse().size();
+
+   vector<Orkan> orkans;
+   vector<Romulan> romulans;
+   vector<Earthling> earthlings;
+   orkans.reserve(population / 3 + 1);
+   romulans.reserve(population / 3 + 1);
+   earthlings.reserve(population / 3 + 1);
+   before = heapBytes;
+   for (int i = 0; i < population; i++)
+   {
+      Humanoid *h = nullptr;
+      switch (i % 3)
+      {
+         case 0: orkans.emplace_back("Eve", "Xu", planets[0]); h = &orkans.back(); break;
+         case 1: romulans.emplace_back("Eve", "Xu", planets[1]); h = &romulans.back(); break;
+         default: earthlings.emplace_back("Eve", "Xu", planets[2]); h = &earthlings.back(); break;
+      }
+      if (i % 10 == 9)
+         h->SetSalutation(longGreeting);
+   }
+   double sharedBytes = sizeof(Orkan) + double(heapBytes - before) / population;   // all three species are the same size
+   for (auto &h : orkans)
+      checksum += h.Converse().size();
+   for (auto &h : romulans)
+      checksum += h.Converse().size();
+   for (auto &h : earthlings)
+      checksum += h.Converse().size();
+
+   cout << std::fixed << std::setprecision(1);
+   cout << "  Owned strings (Chp18-Ex1.cpp): " << std::setw(6) << owningBytes << " bytes per Humanoid (sizeof "
+        << sizeof(OwningHumanoid) << ")" << endl;
+   cout << "  Flyweight title and greeting:  " << std::setw(6) << sharedBytes << " bytes per Humanoid (sizeof "
+        << sizeof(Orkan) << "), plus " << SharedStrings::Count() << " shared strings in all" << endl;
+   cout.unsetf(std::ios::fixed);
+   cout << std::setprecision(6) << "(checksum " << checksum << ")" << endl;
+}
+
+
+int main(int argc, char *argv[])
+{
+   vector<Humanoid *> allies;
+   Orkan o1("Mork", "McConnell", "Orkan");
+   Romulan r1("Donatra", "Jarok", "Romulan");
+   Earthling e1("Eve", "Xu", "Earthling");
+   Earthling e2("Adam", "Xu", "Earthling");
+
+   allies.push_back(&o1);
+   allies.push_back(&r1);
+   allies.push_back(&e1);
+   allies.push_back(&e2);
+
+   for (auto *entity : allies)
+   {
+       entity->GetInfo();
+       cout << entity->Converse() << endl;
+   }
+
+   // Though each type of Humanoid has a default Salutation, each may expand their language skills and choose an alternate language
+   e1.SetSalutation("Bonjour");   // only e1 changes; e2 still shares "Hello"
+   e1.GetInfo();
+   cout << e1.Converse() << " (while " << e2.GetSecondaryName() << " still says " << e2.Converse() << ")" << endl;
+   cout << "Shared strings: " << SharedStrings::Count() << endl;
+
+   int population = argc > 1 ? std::atoi(argv[1]) : 1000000;
+   cout << endl << "Benchmark: " << population << " Humanoids" << endl;
+   Benchmark(population);
+
+   return 0;
+}
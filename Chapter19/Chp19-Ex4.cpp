@@ -0,0 +1,338 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate a thread-safe Singleton, implemented as a cooperating pair of class templates --
+// Singleton<T> and SingletonDestroyer<T> -- mixed in to President, as in Chp19-Ex2.cpp and Chp19-Ex3.cpp.
+// There, instance() tests theInstance == nullptr without synchronization: threads making the first call at the
+// same time may each create a President. Here, the Singleton is created exactly once (std::call_once), and the
+// pointer is published with release semantics. After that, instance() is a single acquire load and a test --
+// on most hardware, an ordinary load -- so concurrent calls share the cached pointer without contention.
+// As before, the static SingletonDestroyer deletes the Singleton when the program ends, unless a Client has
+// explicitly deleted it already (after which instance() returns nullptr, since the Singleton is created only once).
+// Compile with: g++ -std=c++17 -O2 -pthread Chp19-Ex4.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+using std::cout;   // preferred to: using namespace std;
+using std::endl;
+using std::string;
+using std::vector;
+using std::thread;
+using std::mutex;
+using std::lock_guard;
+using std::once_flag;
+using std::atomic;
+using std::memory_order_acquire;
+using std::memory_order_release;
+
+template <typename T> class Singleton;
+
+template <typename T>
+class SingletonDestroyer
+{
+private:
+    T *theSingleton = nullptr;
+public:
+    constexpr SingletonDestroyer(T *s = nullptr) : theSingleton(s) { }   // constexpr: initialized before any code runs
+    SingletonDestroyer(const SingletonDestroyer &) = delete; // disallow copies
+    SingletonDestroyer &operator=(const SingletonDestroyer &) = delete; // disallow assignment
+    ~SingletonDestroyer();  // class is not meant to be customized, so destructor is not virtual
+    void setSingleton(T *s) { theSingleton = s; }
+    T *getSingleton() { return theSingleton; }
+};
+
+template <typename T>
+SingletonDestroyer<T>::~SingletonDestroyer()
+{   // If Singleton has been directly deleted (rare), its destructor will have Nulled out SingletonDestroyer's theSingleton member
+    if (theSingleton != nullptr)
+        delete theSingleton;
+}
+
+// Singleton<T> is designed to be mixed-in to a class T desiring a Singleton using inheritance
+// T must befriend Singleton<T>, so that instance() may use T's private constructor
+template <typename T>
+class Singleton
+{
+private:
+    static atomic<T *> theInstance;   // static members initialized below
+    static once_flag created;
+    static SingletonDestroyer<T> destroyer;
+    template <typename... Args> static T *Create(Args &&...);
+protected:
+    Singleton() = default;
+    Singleton(const Singleton &) = delete; // disallow copies
+    Singleton &operator=(const Singleton &) = delete; // disallow assignment
+    virtual ~Singleton();   // virtual because we'll inherit from Singleton
+public:
+    // The arguments are used only by the call which creates the Singleton; later calls return the existing one
+    template <typename... Args>
+    static T *instance(Args &&...args)
+    {
+        T *existing = theInstance.load(memory_order_acquire);   // the fast path, once the Singleton exists
+        if (existing != nullptr)
+            return existing;
+        return Create(std::forward<Args>(args)...);
+    }
+};
+
+// External (name mangled) variables to hold static data members
+template <typename T> atomic<T *> Singleton<T>::theInstance(nullptr);
+template <typename T> once_flag Singleton<T>::created;
+template <typename T> SingletonDestroyer<T> Singleton<T>::destroyer;
+
+// The slow path: exactly one caller runs the lambda (others block in call_once until it finishes). If the
+// constructor throws, call_once lets a later caller try again.
+template <typename T>
+template <typename... Args>
+T *Singleton<T>::Create(Args &&...args)
+{
+    std::call_once(created, [&]() {
+        T *t = new T(std::forward<Args>(args)...);   // Create one using T's private constructor
+        destroyer.setSingleton(t);                   // Set our SingletonDestroyer to point to the Singleton
+        theInstance.store(t, memory_order_release);  // publish: t's construction happens-before any acquire load of t
+    });
+    return theInstance.load(memory_order_acquire);
+}
+
+template <typename T>
+Singleton<T>::~Singleton()
+{
+    destroyer.setSingleton(nullptr);   // Necessary for the rare case that a Singleton is explicitly deleted
+    theInstance.store(nullptr, memory_order_release);
+}
+
+
+class Person
+{
+private:
+   string firstName;
+   string lastName;
+   char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+   string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+   string greeting;
+protected:
+   void ModifyTitle(const string &);  // Make this operation available to derived classes
+public:
+   Person() = default;   // default constructor
+   Person(const string &, const string &, char, const string &);  // alternate constructor
+   virtual ~Person();  // virtual destructor
+   const string &GetFirstName() const { return firstName; }  // firstName returned as reference to const string
+   const string &GetLastName() const { return lastName; }    // so is lastName (via implicit cast)
+   const string &GetTitle() const { return title; }
+   char GetMiddleInitial() const { return middleInitial; }
+   void SetGreeting(const string &);
+   virtual const string &Speak() { return greeting; }
+   virtual void Print() const;
+};
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) :
+               firstName(fn), lastName(ln), middleInitial(mi), title(t), greeting("Hello")
+{
+}
+
+Person::~Person()
+{
+   cout << "Person destructor" << endl;
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+   title = newTitle;
+}
+
+void Person::SetGreeting(const string &newGreeting)
+{
+   greeting = newGreeting;
+}
+
+void Person::Print() const
+{
+   cout << title << " " << firstName << " " << lastName << endl;
+}
+
+// A President Is-A Person yet mixes-in a Singleton (definitely!)
+class President: public Person, public Singleton<President>
+{
+private:
+    friend class Singleton<President>;   // so that instance() may use our private constructor
+    President(const string &, const string &, char, const string &);
+    // No default constructor - rare
+public:
+    ~President() override;
+    President(const President &) = delete;  // disallow copies
+    President &operator=(const President &) = delete;
+};
+
+President::President(const string &fn, const string &ln, char mi, const string &t) : Person(fn, ln, mi, t)
+{
+    cout << "Creating the Singleton" << endl;
+}
+
+President::~President()
+{
+    cout << "President destructor" << endl;
+}
+
+
+// For comparison: the unsynchronized check from Chp19-Ex2.cpp (made an atomic so that the race is in the logic --
+// check, then create -- rather than undefined behavior)
+template <typename T>
+class UnsafeSingleton
+{
+private:
+    static atomic<T *> theInstance;
+public:
+    static T *instance()
+    {
+        if (theInstance.load() == nullptr)   // If we have not yet allocated the Singleton (but others may be doing so now!)
+            theInstance.store(new T());      // a losing thread's instance is leaked, just as in the unsynchronized original
+        return theInstance.load();
+    }
+};
+
+template <typename T> atomic<T *> UnsafeSingleton<T>::theInstance(nullptr);
+
+// Stress test subjects: a distinct type per trial (each has its own once_flag), with a slow constructor to widen
+// the window in which several threads see that no instance exists yet
+atomic<int> constructions(0);
+
+template <int N>
+class Probe: public Singleton<Probe<N>>
+{
+private:
+    friend class Singleton<Probe<N>>;
+    Probe() { constructions++; std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+};
+
+template <int N>
+class UnsafeProbe: public UnsafeSingleton<UnsafeProbe<N>>
+{
+public:
+    UnsafeProbe() { constructions++; std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+};
+
+// numThreads threads are released at once to make the first call to instance(); returns the number of instances made
+template <typename GetInstance>
+int Race(int numThreads, GetInstance get)
+{
+    constructions = 0;
+    atomic<bool> go(false);
+    atomic<int> distinct(0);
+    vector<const void *> seen(numThreads);
+    vector<thread> threads;
+    for (int t = 0; t < numThreads; t++)
+        threads.emplace_back([&, t]() {
+            while (!go.load())
+                std::this_thread::yield();
+            seen[t] = get();
+        });
+    go = true;
+    for (auto &th : threads)
+        th.join();
+    for (int t = 1; t < numThreads; t++)
+        if (seen[t] != seen[0])
+            distinct++;
+    return distinct > 0 ? std::max(constructions.load(), 2) : constructions.load();
+}
+
+template <int... N>
+bool StressTest(int numThreads, std::integer_sequence<int, N...>)
+{
+    int failures = 0;
+    ((failures += Race(numThreads, []() { return static_cast<const void *>(Probe<N>::instance()); }) != 1), ...);
+    int unsafeFailures = 0;
+    ((unsafeFailures += Race(numThreads, []() { return static_cast<const void *>(UnsafeProbe<N>::instance()); }) != 1), ...);
+    cout << "Stress test: " << sizeof...(N) << " first-call races of " << numThreads << " threads each: "
+         << failures << " made more than one instance with Singleton<T>; " << unsafeFailures
+         << " with the unsynchronized check" << endl;
+    return failures == 0;
+}
+
+// Benchmark: numThreads threads each call instance() callsPerThread times, via several strategies
+struct LockedPresident   // every call takes a lock, then checks
+{
+    static mutex lock;
+    static President *theInstance;
+    static President *instance()
+    {
+        lock_guard<mutex> guard(lock);
+        return theInstance;
+    }
+};
+mutex LockedPresident::lock;
+President *LockedPresident::theInstance = nullptr;
+
+struct CallOncePresident   // every call goes through call_once
+{
+    static once_flag flag;
+    static President *instance()
+    {
+        std::call_once(flag, []() { });
+        return President::instance("", "", ' ', "");
+    }
+};
+once_flag CallOncePresident::flag;
+
+struct StaticLocalPresident   // a function-local static (the compiler's guard variable, as in Chp19-Ex1b.cpp)
+{
+    static President *instance()
+    {
+        static President *const theInstance = President::instance("", "", ' ', "");
+        return theInstance;
+    }
+};
+
+template <typename GetInstance>
+void Benchmark(const char *label, int numThreads, long callsPerThread, GetInstance get)
+{
+    vector<thread> threads;
+    atomic<long> checksum(0);
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < numThreads; t++)
+        threads.emplace_back([&]() {
+            long sum = 0;
+            for (long i = 0; i < callsPerThread; i++)
+                sum += get() != nullptr;
+            checksum += sum;
+        });
+    for (auto &th : threads)
+        th.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    cout << "  " << std::left << std::setw(36) << label << std::right << std::fixed << std::setprecision(1)
+         << std::setw(8) << numThreads * callsPerThread / seconds / 1e6 << " M calls/sec" << endl;
+    cout.unsetf(std::ios::fixed);
+    cout << std::setprecision(6);
+    if (checksum != numThreads * callsPerThread)
+        cout << "(instance() returned nullptr!)" << endl;
+}
+
+
+int main(int argc, char *argv[])
+{
+    President *p1 = President::instance("John", "Adams", 'Q', "President");
+    President *p2 = President::instance("William", "Harrison", 'H', "President");
+    // Verification there's only one object
+    if (p1 == p2)
+        cout << "Same instance (only one Singleton)" << endl;
+    p1->Print();
+
+    bool passed = StressTest(64, std::make_integer_sequence<int, 16>());
+
+    LockedPresident::theInstance = p1;
+    int numThreads = 64;
+    long callsPerThread = argc > 1 ? std::atol(argv[1]) : 2000000;
+    cout << "Benchmark: instance() from " << numThreads << " threads, " << callsPerThread << " calls each" << endl;
+    Benchmark("mutex, then check", numThreads, callsPerThread, LockedPresident::instance);
+    Benchmark("call_once on every call", numThreads, callsPerThread, CallOncePresident::instance);
+    Benchmark("function-local static", numThreads, callsPerThread, StaticLocalPresident::instance);
+    Benchmark("Singleton<T>: acquire load, then test", numThreads, callsPerThread, []() {
+        return President::instance("", "", ' ', "");
+    });
+
+    // The Singleton is deleted by its SingletonDestroyer when the program ends (after main() returns)
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,296 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To demonstrate a policy-based smart pointer class
+// Chp20-Ex2.cpp's SmartPointer left copies undecided (copying it deletes the pointee twice), has a virtual
+// destructor (so a vtable pointer in every SmartPointer), and always uses delete -- never delete[], nor a return
+// to a pool. Here, SmartPointer<Type, Ownership, Deleter> takes its decisions as template arguments:
+//    Ownership: UniqueOwnership (move only), IntrusiveOwnership (copies share a count kept in the pointee), or
+//               NonOwning (copies freely, never deletes)
+//    Deleter:   a stateless function object: DefaultDelete<Type> (delete, or delete[] for Type[]), or e.g. PoolDelete
+// A SmartPointer holds only its pointer -- it is the size of a raw pointer -- and has no virtual functions, so each
+// operation compiles to what you would write by hand with a raw pointer.
+// To compile: g++ -std=c++17 -O2 -c PersonImpl.cpp
+//             g++ -std=c++17 -O2 -c Chp20-Ex6.cpp
+//             g++ -o runme PersonImpl.o Chp20-Ex6.o   (executable is in 'runme')
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <chrono>
+#include <cstdlib>
+#include "Person.h"
+
+using std::cout;    // preferred to: using namespace std;
+using std::endl;
+using std::vector;
+
+// Deleters
+
+template <class Type>
+struct DefaultDelete
+{
+    void operator()(Type *p) const { delete p; }
+};
+
+template <class Type>
+struct DefaultDelete<Type[]>   // partial specialization for arrays
+{
+    void operator()(Type *p) const { delete [] p; }
+};
+
+// Ownership policies: each says whether a SmartPointer may be copied, and what to do when a SmartPointer
+// takes on a pointer (Acquire) and gives it up (Release)
+
+struct UniqueOwnership
+{
+    static constexpr bool COPYABLE = false;
+    template <class Type> static void Acquire(Type *) { }
+    template <class Deleter, class Type> static void Release(Type *p) { if (p) Deleter()(p); }
+};
+
+// The pointee keeps the count; Type must provide IntrusiveAddRef(Type *) and IntrusiveRelease(Type *) -- the
+// latter returning true when the last reference is released (see RefCounted, below)
+struct IntrusiveOwnership
+{
+    static constexpr bool COPYABLE = true;
+    template <class Type> static void Acquire(Type *p) { if (p) IntrusiveAddRef(p); }
+    template <class Deleter, class Type> static void Release(Type *p) { if (p && IntrusiveRelease(p)) Deleter()(p); }
+};
+
+struct NonOwning
+{
+    static constexpr bool COPYABLE = true;
+    template <class Type> static void Acquire(Type *) { }
+    template <class Deleter, class Type> static void Release(Type *) { }
+};
+
+template <class Type, class Ownership = UniqueOwnership, class Deleter = DefaultDelete<Type>>
+class SmartPointer
+{
+public:
+    using Element = std::remove_extent_t<Type>;   // for SmartPointer<int[]>, Element is int
+private:
+    Element *pointer = nullptr;  // in-class initialization
+    static_assert(std::is_empty_v<Deleter>, "Deleter must be stateless, so that a SmartPointer stays pointer-sized");
+public:
+    SmartPointer() = default;
+    explicit SmartPointer(Element *ptr) : pointer(ptr) { Ownership::Acquire(pointer); }
+    SmartPointer(const SmartPointer &sp) : pointer(sp.pointer)
+    {
+        static_assert(Ownership::COPYABLE, "this SmartPointer's Ownership policy does not allow copies; move it instead");
+        Ownership::Acquire(pointer);
+    }
+    SmartPointer(SmartPointer &&sp) noexcept : pointer(sp.pointer) { sp.pointer = nullptr; }
+    ~SmartPointer() { Ownership::template Release<Deleter>(pointer); }   // not virtual: SmartPointer is not a base class
+    SmartPointer &operator=(const SmartPointer &sp)
+    {
+        static_assert(Ownership::COPYABLE, "this SmartPointer's Ownership policy does not allow copies; move it instead");
+        SmartPointer(sp).Swap(*this);   // copy, then swap: correct for self-assignment, and if Acquire() throws
+        return *this;
+    }
+    SmartPointer &operator=(SmartPointer &&sp) noexcept
+    {
+        SmartPointer(std::move(sp)).Swap(*this);
+        return *this;
+    }
+    void Swap(SmartPointer &sp) noexcept { std::swap(pointer, sp.pointer); }
+    void Reset(Element *ptr = nullptr) { SmartPointer(ptr).Swap(*this); }
+    Element *Release() noexcept { Element *p = pointer; pointer = nullptr; return p; }  // the caller takes ownership
+    Element *Get() const noexcept { return pointer; }
+    explicit operator bool() const noexcept { return pointer != nullptr; }
+    Element *operator->() const noexcept { return pointer; }
+    Element &operator*() const noexcept { return *pointer; }
+    Element &operator[](std::size_t i) const noexcept
+    {
+        static_assert(std::is_array_v<Type>, "operator[] is for SmartPointer<Type[]>");
+        return pointer[i];
+    }
+};
+
+static_assert(sizeof(SmartPointer<Person>) == sizeof(Person *), "SmartPointer should be the size of a raw pointer");
+static_assert(sizeof(SmartPointer<int[]>) == sizeof(int *), "SmartPointer should be the size of a raw pointer");
+
+
+// A mix-in giving a class an intrusive reference count, for use with IntrusiveOwnership (single-threaded; an atomic
+// count would make it safe to share across threads, at some cost)
+class RefCounted
+{
+private:
+    int refCount = 0;
+    friend void IntrusiveAddRef(RefCounted *p) { ++p->refCount; }
+    friend bool IntrusiveRelease(RefCounted *p) { return --p->refCount == 0; }
+protected:
+    RefCounted() = default;
+    RefCounted(const RefCounted &) { }   // a copy of an object is not referred to by the original's SmartPointers
+    RefCounted &operator=(const RefCounted &) { return *this; }
+    ~RefCounted() = default;
+};
+
+class CountedPerson: public Person, public RefCounted
+{
+public:
+    using Person::Person;   // inherit Person's constructors
+};
+
+
+// A simple fixed-capacity pool, and a Deleter which returns objects to it. The pool is named by a template
+// argument (a reference to a static object), so PoolDelete is stateless.
+template <class Type, int SIZE>
+class FixedPool
+{
+private:
+    union Slot
+    {
+        Slot *next;
+        alignas(Type) unsigned char object[sizeof(Type)];
+    };
+    Slot slots[SIZE];
+    Slot *freeList = nullptr;
+public:
+    FixedPool() { for (int i = SIZE - 1; i >= 0; i--) { slots[i].next = freeList; freeList = &slots[i]; } }
+    FixedPool(const FixedPool &) = delete;
+    FixedPool &operator=(const FixedPool &) = delete;
+    template <class... Args>
+    Type *Create(Args &&...args)
+    {
+        if (freeList == nullptr)
+            throw std::bad_alloc();
+        Slot *slot = freeList;
+        Type *p = new (slot->object) Type(std::forward<Args>(args)...);   // if this throws, slot remains free
+        freeList = slot->next;
+        return p;
+    }
+    void Destroy(Type *p)
+    {
+        p->~Type();
+        Slot *slot = reinterpret_cast<Slot *>(p);
+        slot->next = freeList;
+        freeList = slot;
+    }
+};
+
+template <class Type, class Pool, Pool &pool>
+struct PoolDelete
+{
+    void operator()(Type *p) const { pool.Destroy(p); }
+};
+
+FixedPool<Person, 8> personPool;
+using PooledPerson = SmartPointer<Person, UniqueOwnership, PoolDelete<Person, FixedPool<Person, 8>, personPool>>;
+
+
+// Benchmarks: each SmartPointer operation against the same operation written with raw pointers (or shared_ptr)
+template <class Function>
+double Time(long n, Function f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+}
+
+void Benchmark(long n)
+{
+    cout << std::fixed << std::setprecision(2);
+    long sum = 0;
+
+    int *raw = new int[n];
+    SmartPointer<int[]> smart(new int[n]);
+    for (long i = 0; i < n; i++)
+        raw[i] = smart[i] = int(i & 7);
+    double rawNs = Time(n, [&]() { for (long i = 0; i < n; i++) sum += raw[i]; });
+    double smartNs = Time(n, [&]() { for (long i = 0; i < n; i++) sum += smart[i]; });
+    delete [] raw;
+    cout << "  Index an array:                  raw " << rawNs << " ns, SmartPointer<int[]> " << smartNs << " ns" << endl;
+
+    const long m = n / 10;
+    rawNs = Time(m, [&]() {
+        for (long i = 0; i < m; i++)
+        {
+            int *p = new int(int(i));
+            sum += *p;
+            delete p;
+        }
+    });
+    smartNs = Time(m, [&]() {
+        for (long i = 0; i < m; i++)
+        {
+            SmartPointer<int> p(new int(int(i)));
+            sum += *p;
+        }
+    });
+    cout << "  Allocate, use, delete:           raw " << rawNs << " ns, SmartPointer<int> " << smartNs << " ns" << endl;
+
+    vector<Person *> rawPeople;
+    vector<SmartPointer<Person>> smartPeople;
+    rawPeople.reserve(m);
+    smartPeople.reserve(m);
+    for (long i = 0; i < m; i++)
+    {
+        rawPeople.push_back(new Person("Renee", "Alexander", 'K', "Dr."));
+        smartPeople.emplace_back(new Person("Renee", "Alexander", 'K', "Dr."));
+    }
+    rawNs = Time(m, [&]() { for (auto *p : rawPeople) sum += p->GetMiddleInitial(); });
+    smartNs = Time(m, [&]() { for (auto &p : smartPeople) sum += p->GetMiddleInitial(); });
+    for (auto *p : rawPeople)
+        delete p;
+    cout << "  Call through, vector of Persons: raw " << rawNs << " ns, SmartPointer<Person> " << smartNs << " ns" << endl;
+
+    SmartPointer<CountedPerson, IntrusiveOwnership> counted(new CountedPerson("Renee", "Alexander", 'K', "Dr."));
+    std::shared_ptr<Person> shared = std::make_shared<Person>("Renee", "Alexander", 'K', "Dr.");
+    double intrusiveNs = Time(n, [&]() {
+        for (long i = 0; i < n; i++)
+        {
+            SmartPointer<CountedPerson, IntrusiveOwnership> copy(counted);
+            sum += copy->GetMiddleInitial();
+        }
+    });
+    double sharedNs = Time(n, [&]() {
+        for (long i = 0; i < n; i++)
+        {
+            std::shared_ptr<Person> copy(shared);
+            sum += copy->GetMiddleInitial();
+        }
+    });
+    cout << "  Copy, use, destroy:              intrusive SmartPointer " << intrusiveNs << " ns, shared_ptr "
+         << sharedNs << " ns (sizes " << sizeof(counted) << " vs. " << sizeof(shared) << " bytes)" << endl;
+    cout.unsetf(std::ios::fixed);
+    cout << std::setprecision(6) << "  (checksum " << sum << ")" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    SmartPointer<int> p1(new int());
+    SmartPointer<Person> pers1(new Person("Renee", "Alexander", 'K', "Dr."));
+
+    *p1 = 100;
+    cout << *p1 << endl;
+    (*pers1).Print();   // or use: pers1->Print();
+
+    // SmartPointer<Person> pers2 = pers1;   // will not compile: UniqueOwnership does not allow copies
+    SmartPointer<Person> pers2 = std::move(pers1);   // ownership moves to pers2; pers1 is now empty
+    cout << "pers1 is " << (pers1 ? "not empty" : "empty") << "; pers2: ";
+    pers2->Print();
+
+    SmartPointer<int[]> scores(new int[3] { 93, 87, 100 });   // deleted with delete []
+    cout << "Scores: " << scores[0] << " " << scores[1] << " " << scores[2] << endl;
+
+    SmartPointer<CountedPerson, IntrusiveOwnership> shared1(new CountedPerson("Giselle", "LeBrun", 'R', "Ms."));
+    {
+        SmartPointer<CountedPerson, IntrusiveOwnership> shared2 = shared1;   // both refer to the same CountedPerson
+        shared2->Print();
+    }   // shared2's reference is released; shared1's keeps the CountedPerson alive
+
+    SmartPointer<Person, NonOwning> observer(pers2.Get());   // refers to pers2's Person, but never deletes it
+    observer->Print();
+
+    PooledPerson pooled(personPool.Create("Gabby", "Doone", 'A', "Dr."));   // returned to personPool, not deleted
+    pooled->Print();
+
+    long n = argc > 1 ? std::atol(argv[1]) : 10000000;
+    cout << endl << "Benchmark: " << n << " operations" << endl;
+    Benchmark(n);
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate use of the pImpl pattern with a copy-on-write implementation, and to benchmark it against
+// the unique pointer version (Chapter20/unique, which now has noexcept move operations as well).
+// The driver works the same with either implementation of Person:
+// To compile (copy-on-write):  g++ -std=c++17 -O2 -c PersonImpl.cpp
+//                              g++ -std=c++17 -O2 -c Chp20-Ex5.cpp
+//                              g++ -o runme PersonImpl.o Chp20-Ex5.o   (executable is in 'runme')
+// To compile (unique pointer, for comparison):
+//                              g++ -std=c++17 -O2 -DUNIQUE_PIMPL -o runme-unique Chp20-Ex5.cpp ../unique/PersonImpl.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#ifdef UNIQUE_PIMPL
+#include "../unique/Person.h"
+constexpr const char *VARIANT = "unique pointer pImpl";
+#else
+#include "Person.h"
+constexpr const char *VARIANT = "copy-on-write pImpl";
+#endif
+
+using std::cout;   // preferred to: using namespace std;
+using std::endl;
+using std::string;
+using std::vector;
+
+// Count heap allocations, so that the benchmark can show how many each operation makes
+namespace
+{
+    long allocations = 0;
+}
+
+void *operator new(std::size_t size)
+{
+    allocations++;
+    if (void *p = std::malloc(size > 0 ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+// ModifyTitle() is protected in Person, so a derived class offers a way to change a title
+class Employee: public Person
+{
+public:
+    using Person::Person;   // inherit Person's constructors
+    void Promote(const string &newTitle) { ModifyTitle(newTitle); }
+};
+
+// Benchmark: grow a vector (without reserve()), copy it, access the copies, then modify every copy
+void Benchmark(int numPersons)
+{
+    using Clock = std::chrono::steady_clock;
+    auto report = [numPersons](const char *label, Clock::time_point start, long allocs) {
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / numPersons;
+        cout << "  " << std::left << std::setw(26) << label << std::right << std::setw(8) << ns << " ns per Person, "
+             << std::setw(5) << double(allocs) / numPersons << " allocations per Person" << endl;
+    };
+    cout << std::fixed << std::setprecision(2);
+
+    vector<Employee> staff;   // as the vector grows, it moves its Persons, since moving cannot throw
+    long before = allocations;
+    auto start = Clock::now();
+    for (int i = 0; i < numPersons; i++)
+        staff.push_back(Employee("Gabby", "Doone", 'A', "Dr."));
+    report("grow vector:", start, allocations - before);
+
+    before = allocations;
+    start = Clock::now();
+    vector<Employee> copies(staff);
+    report("copy vector:", start, allocations - before - 1);   // less the vector's own array
+
+    size_t checksum = 0;
+    start = Clock::now();
+    for (const auto &e : copies)
+        checksum += e.GetTitle().size() + e.GetMiddleInitial();
+    report("access copies:", start, 0);
+
+    before = allocations;
+    start = Clock::now();
+    for (auto &e : copies)
+        e.Promote("Prof.");
+    report("modify copies (1st time):", start, allocations - before);
+
+    before = allocations;
+    start = Clock::now();
+    for (auto &e : copies)
+        e.Promote("Dean");
+    report("modify copies (again):", start, allocations - before);
+
+    cout.unsetf(std::ios::fixed);
+    cout << std::setprecision(6) << "  (checksum " << checksum + copies.size() << "; original title still "
+         << staff[0].GetTitle() << ", copy's now " << copies[0].GetTitle() << ")" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    Employee e1("Gabby", "Doone", 'A', "Dr.");
+    Employee e2(e1);   // with copy-on-write, e2 shares e1's implementation...
+    e2.Promote("Prof.");   // ...until e2 is modified
+    e1.Print();
+    e2.Print();
+
+    int numPersons = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    cout << endl << "Benchmark (" << VARIANT << "): " << numPersons << " Persons" << endl;
+    Benchmark(numPersons);
+
+    return 0;
+}
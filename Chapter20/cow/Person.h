@@ -0,0 +1,37 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: Person class header file for pImpl with copy-on-write: copies of a Person share one reference-counted
+// PersonImpl, until one of them is about to be modified -- only then does it get a PersonImpl of its own.
+
+#ifndef _PERSON_H
+#define _PERSON_H
+
+using std::string;
+
+class Person
+{
+private:
+    class PersonImpl;  // forward declaration to nested class
+    PersonImpl *pImpl = nullptr; // pointer to (possibly shared) implementation of class
+    PersonImpl *Unshare();  // before modifying: make sure *pImpl is this Person's alone, copying it if need be
+    void Release() noexcept;  // give up this Person's share of *pImpl
+protected:
+    void ModifyTitle(const string &);
+public:
+    Person();   // default constructor
+    Person(const string &, const string &, char, const string &);
+    Person(const Person &) noexcept;  // copy constructor -- shares the PersonImpl (no allocation)
+    Person(Person &&) noexcept;  // move constructor -- the moved-from Person may only be assigned to or destroyed
+    virtual ~Person();  // virtual destructor
+    const string &GetFirstName() const;
+    const string &GetLastName() const;
+    const string &GetTitle() const;
+    char GetMiddleInitial() const;
+    virtual void Print() const;
+    virtual void IsA() const;
+    virtual void Greeting(const string &) const;
+    Person &operator=(const Person &) noexcept;  // overloaded assignment operator prototype -- shares as well
+    Person &operator=(Person &&) noexcept;  // move assignment
+    bool SharesImplWith(const Person &p) const { return pImpl == p.pImpl; }
+};
+
+#endif
@@ -0,0 +1,188 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate pImpl pattern, this version shares a reference-counted PersonImpl among copies of a Person
+// (copy-on-write). Copying a Person just increments the count; the first modification made through a Person whose
+// PersonImpl is shared copies the PersonImpl first. The count is atomic, so copies may be used by different threads
+// (though, as with any object, one Person may not be modified by one thread while another thread uses it).
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include "Person.h"
+
+using std::cout;   // preferred to: using namespace std;
+using std::endl;
+using std::string;
+
+// Nested class definition supports implementation
+class Person::PersonImpl
+{
+private:
+    friend class Person;   // Person manages the reference count
+    std::atomic<int> refCount{1};   // the number of Persons sharing this PersonImpl
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+public:
+    PersonImpl() = default;   // default constructor
+    PersonImpl(const string &, const string &, char, const string &);
+    PersonImpl(const PersonImpl &);  // copy constructor -- the copy is not shared (yet)
+    PersonImpl &operator=(const PersonImpl &) = delete;  // Persons share or copy PersonImpls; they never assign them
+    virtual ~PersonImpl() = default;  // virtual destructor
+
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+    void ModifyTitle(const string &);
+
+    virtual void Print() const;
+    virtual void IsA() const;
+    virtual void Greeting(const string &) const;
+};
+
+// Nested class member functions
+
+Person::PersonImpl::PersonImpl(const string &fn, const string &ln, char mi, const string &t) :
+                               firstName(fn), lastName(ln), middleInitial(mi), title(t)
+{
+}
+
+// We must write the copy constructor, since refCount (an atomic) can not be copied -- and should not be
+Person::PersonImpl::PersonImpl(const PersonImpl &p) : firstName(p.firstName), lastName(p.lastName),
+                                                      middleInitial(p.middleInitial), title(p.title)
+{
+}
+
+void Person::PersonImpl::ModifyTitle(const string &newTitle)
+{
+    title = newTitle;
+}
+
+void Person::PersonImpl::Print() const
+{
+    cout << title << " " << firstName << " ";
+    cout << middleInitial << ". ";
+    cout << lastName << endl;
+}
+
+void Person::PersonImpl::IsA() const
+{
+    cout << "Person" << endl;
+}
+
+void Person::PersonImpl::Greeting(const string &msg) const
+{
+    cout << msg << endl;
+}
+
+
+// Person member functions
+
+Person::Person() : pImpl(new PersonImpl())
+{
+}
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t) : pImpl(new PersonImpl(fn, ln, mi, t))
+{
+}
+
+// copy constructor -- share p's PersonImpl
+Person::Person(const Person &p) noexcept : pImpl(p.pImpl)
+{
+    if (pImpl)   // a moved-from p has no PersonImpl to share
+        pImpl->refCount.fetch_add(1, std::memory_order_relaxed);   // we already hold a share (via p), so no ordering needed
+}
+
+Person::Person(Person &&p) noexcept : pImpl(p.pImpl)
+{
+    p.pImpl = nullptr;
+}
+
+Person::~Person()
+{
+    Release();
+}
+
+// The last Person to release a PersonImpl deletes it. acq_rel: every other Person's use of the PersonImpl
+// happens-before the delete.
+void Person::Release() noexcept
+{
+    if (pImpl != nullptr && pImpl->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete pImpl;
+    pImpl = nullptr;
+}
+
+Person::PersonImpl *Person::Unshare()
+{
+    if (pImpl->refCount.load(std::memory_order_acquire) > 1)
+    {
+        PersonImpl *copy = new PersonImpl(*pImpl);   // copy first: if this throws, nothing has changed
+        Release();
+        pImpl = copy;
+    }
+    return pImpl;
+}
+
+const string &Person::GetFirstName() const
+{
+    return pImpl->GetFirstName();
+}
+
+const string &Person::GetLastName() const
+{
+    return pImpl->GetLastName();
+}
+
+const string &Person::GetTitle() const
+{
+    return pImpl->GetTitle();
+}
+
+char Person::GetMiddleInitial() const
+{
+    return pImpl->GetMiddleInitial();
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+    Unshare()->ModifyTitle(newTitle);  // delegate to (our own copy of the) implementation
+}
+
+void Person::Print() const
+{
+    pImpl->Print();   // delegate to implementation
+}
+
+void Person::IsA() const
+{
+    pImpl->IsA();   // delegate to implementation
+}
+
+void Person::Greeting(const string &msg) const
+{
+    pImpl->Greeting(msg);    // delegate to implementation
+}
+
+Person &Person::operator=(const Person &p) noexcept
+{
+   if (pImpl != p.pImpl)   // (also covers assigning an object to itself)
+   {
+      if (p.pImpl)   // (a moved-from p has none)
+         p.pImpl->refCount.fetch_add(1, std::memory_order_relaxed);
+      Release();
+      pImpl = p.pImpl;
+   }
+   return *this;  // allow for cascaded assignments
+}
+
+Person &Person::operator=(Person &&p) noexcept
+{
+   if (this != &p)
+   {
+      Release();
+      pImpl = p.pImpl;
+      p.pImpl = nullptr;
+   }
+   return *this;
+}
@@ -0,0 +1,111 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate use of the "fast pImpl" pattern, and to benchmark it against the heap-allocated pImpl.
+// The driver works the same with either implementation of Person:
+// To compile (fast pImpl):  g++ -std=c++17 -O2 -c PersonImpl.cpp
+//                           g++ -std=c++17 -O2 -c Chp20-Ex4.cpp
+//                           g++ -o runme PersonImpl.o Chp20-Ex4.o   (executable is in 'runme')
+// To compile (heap pImpl, from Chapter20, for comparison):
+//                           g++ -std=c++17 -O2 -DHEAP_PIMPL -o runme-heap Chp20-Ex4.cpp ../PersonImpl.cpp
+// Add -flto to each command to let the compiler inline the (out-of-line) access functions across files.
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#ifdef HEAP_PIMPL
+#include "../Person.h"
+constexpr const char *VARIANT = "heap pImpl";
+#else
+#include "Person.h"
+constexpr const char *VARIANT = "fast pImpl";
+#endif
+
+using std::cout;   // preferred to: using namespace std;
+using std::endl;
+using std::vector;
+
+constexpr int MAX = 3;
+
+// Count heap allocations, so that the benchmark can show how many each operation makes
+namespace
+{
+    long allocations = 0;
+}
+
+void *operator new(std::size_t size)
+{
+    allocations++;
+    if (void *p = std::malloc(size > 0 ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+// Benchmark: construct, copy, access and grow (a vector without reserve()) numPersons Persons
+void Benchmark(int numPersons)
+{
+    using Clock = std::chrono::steady_clock;
+    auto report = [numPersons](const char *label, Clock::time_point start, long allocs, int rounds = 1) {
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (double(numPersons) * rounds);
+        cout << "  " << std::left << std::setw(12) << label << std::right << std::setw(8) << ns << " ns per Person, "
+             << std::setw(4) << double(allocs) / (double(numPersons) * rounds) << " allocations per Person" << endl;
+    };
+    cout << std::fixed << std::setprecision(2);
+
+    vector<Person> people;
+    people.reserve(numPersons);
+    long before = allocations;
+    auto start = Clock::now();
+    for (int i = 0; i < numPersons; i++)
+        people.emplace_back("Gabby", "Doone", 'A', "Dr.");
+    report("construct:", start, allocations - before);
+
+    before = allocations;
+    start = Clock::now();
+    vector<Person> copies(people);
+    report("copy:", start, allocations - before - 1);   // less the vector's own array
+
+    const int rounds = 10;
+    size_t checksum = 0;
+    start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (const auto &p : people)
+            checksum += p.GetLastName().size() + p.GetMiddleInitial();
+    report("access:", start, 0, rounds);
+
+    vector<Person> grown;   // as the vector grows, it moves its Persons if moving cannot throw (else it copies them)
+    before = allocations;
+    start = Clock::now();
+    for (int i = 0; i < numPersons; i++)
+        grown.push_back(Person("Zack", "Moon", 'R', "Dr."));
+    report("grow:", start, allocations - before);
+
+    cout.unsetf(std::ios::fixed);
+    cout << std::setprecision(6) << "  sizeof(Person): " << sizeof(Person) << " (checksum " << checksum + copies.size() << ")" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    Person people[MAX] = { Person("Elle", "LeBrun", 'R', "Ms."), Person("Zack", "Moon", 'R', "Dr."),
+                           Person("Gabby", "Doone", 'A', "Dr.") };
+
+    for (const auto &individual : people)
+       individual.Print();
+
+    int numPersons = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    cout << endl << "Benchmark (" << VARIANT << "): " << numPersons << " Persons" << endl;
+    Benchmark(numPersons);
+
+    return 0;
+}
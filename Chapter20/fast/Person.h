@@ -0,0 +1,43 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: Person class header file for the "fast pImpl" pattern: the PersonImpl object lives in aligned storage
+// inside each Person, rather than on the heap. The header still reveals nothing of PersonImpl but its size and
+// alignment bounds (checked with static_assert in PersonImpl.cpp), so clients need not recompile when PersonImpl's
+// members change -- unless it outgrows IMPLSIZE.
+
+#ifndef _PERSON_H
+#define _PERSON_H
+#include <cstddef>
+
+using std::string;
+
+class Person
+{
+private:
+    class PersonImpl;  // forward declaration to nested class
+    static constexpr std::size_t IMPLSIZE = 128;   // room for PersonImpl, with some to spare for later growth
+    static constexpr std::size_t IMPLALIGN = alignof(std::max_align_t);
+    alignas(IMPLALIGN) unsigned char storage[IMPLSIZE];   // the PersonImpl object is constructed in place here
+    PersonImpl *Impl() noexcept;
+    const PersonImpl *Impl() const noexcept;
+protected:
+    void ModifyTitle(const string &);
+public:
+    Person();   // default constructor
+    Person(const string &, const string &, char, const string &);
+    Person(const Person &);  // copy constructor
+    Person(Person &&) noexcept;  // move constructor -- no allocation
+    virtual ~Person();  // virtual destructor
+    // Access functions are not inline (which hides the implementation); with link-time optimization (-flto), the
+    // compiler may nonetheless inline them into callers, as each is a simple load from the PersonImpl
+    const string &GetFirstName() const;
+    const string &GetLastName() const;
+    const string &GetTitle() const;
+    char GetMiddleInitial() const;
+    virtual void Print() const;
+    virtual void IsA() const;
+    virtual void Greeting(const string &) const;
+    Person &operator=(const Person &);  // overloaded assignment operator prototype
+    Person &operator=(Person &&) noexcept;  // move assignment -- no allocation
+};
+
+#endif
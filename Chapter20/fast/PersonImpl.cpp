@@ -0,0 +1,166 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate the "fast pImpl" pattern: the PersonImpl object is constructed within the Person itself
+// (in its aligned storage member), so creating, copying or moving a Person makes no separate heap allocation for it.
+
+#include <iostream>
+#include <iomanip>
+#include <new>
+#include <utility>
+#include "Person.h"
+
+using std::cout;   // preferred to: using namespace std;
+using std::endl;
+using std::string;
+
+// Nested class definition supports implementation
+class Person::PersonImpl
+{
+private:
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+public:
+    PersonImpl() = default;   // default constructor
+    PersonImpl(const string &, const string &, char, const string &);
+    PersonImpl(const PersonImpl &) = default;  // copy constructor
+    PersonImpl(PersonImpl &&) noexcept = default;  // move constructor (string's moves do not throw)
+    virtual ~PersonImpl() = default;  // virtual destructor
+
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+    void ModifyTitle(const string &);
+
+    virtual void Print() const;
+    virtual void IsA() const;
+    virtual void Greeting(const string &) const;
+
+    PersonImpl &operator=(const PersonImpl &) = default;  // overloaded assignment operator
+    PersonImpl &operator=(PersonImpl &&) noexcept = default;  // move assignment
+};
+
+// Nested class member functions
+
+Person::PersonImpl::PersonImpl(const string &fn, const string &ln, char mi, const string &t) :
+                               firstName(fn), lastName(ln), middleInitial(mi), title(t)
+{
+}
+
+void Person::PersonImpl::ModifyTitle(const string &newTitle)
+{
+    title = newTitle;
+}
+
+void Person::PersonImpl::Print() const
+{
+    cout << title << " " << firstName << " ";
+    cout << middleInitial << ". ";
+    cout << lastName << endl;
+}
+
+void Person::PersonImpl::IsA() const
+{
+    cout << "Person" << endl;
+}
+
+void Person::PersonImpl::Greeting(const string &msg) const
+{
+    cout << msg << endl;
+}
+
+
+// Person member functions
+
+// Here (and only here) is PersonImpl a complete type, so here is where the storage in Person.h is checked against it
+Person::PersonImpl *Person::Impl() noexcept
+{
+    static_assert(sizeof(PersonImpl) <= IMPLSIZE, "Person::IMPLSIZE is too small for PersonImpl; increase it in Person.h");
+    static_assert(IMPLALIGN % alignof(PersonImpl) == 0, "Person::IMPLALIGN is not a multiple of PersonImpl's alignment");
+    return std::launder(reinterpret_cast<PersonImpl *>(storage));
+}
+
+const Person::PersonImpl *Person::Impl() const noexcept
+{
+    return std::launder(reinterpret_cast<const PersonImpl *>(storage));
+}
+
+Person::Person()
+{
+    new (storage) PersonImpl();   // placement new: construct the PersonImpl in Person's own storage
+}
+
+Person::Person(const string &fn, const string &ln, char mi, const string &t)
+{
+    new (storage) PersonImpl(fn, ln, mi, t);
+}
+
+// copy constructor -- copy construct the nested object in place (no allocation, beyond what copying strings requires)
+Person::Person(const Person &p)
+{
+    new (storage) PersonImpl(*p.Impl());
+}
+
+// move constructor -- the strings' buffers move from p to this Person; p is left valid (with empty strings)
+Person::Person(Person &&p) noexcept
+{
+    new (storage) PersonImpl(std::move(*p.Impl()));
+}
+
+Person::~Person()
+{
+    Impl()->~PersonImpl();   // explicitly destruct the nested object (its storage goes away with the Person)
+}
+
+const string &Person::GetFirstName() const
+{
+    return Impl()->GetFirstName();
+}
+
+const string &Person::GetLastName() const
+{
+    return Impl()->GetLastName();
+}
+
+const string &Person::GetTitle() const
+{
+    return Impl()->GetTitle();
+}
+
+char Person::GetMiddleInitial() const
+{
+    return Impl()->GetMiddleInitial();
+}
+
+void Person::ModifyTitle(const string &newTitle)
+{
+    Impl()->ModifyTitle(newTitle);  // delegate to implementation
+}
+
+void Person::Print() const
+{
+    Impl()->Print();   // delegate to implementation
+}
+
+void Person::IsA() const
+{
+    Impl()->IsA();   // delegate to implementation
+}
+
+void Person::Greeting(const string &msg) const
+{
+    Impl()->Greeting(msg);    // delegate to implementation
+}
+
+Person &Person::operator=(const Person &p)
+{
+   *Impl() = *p.Impl();   // call op= on impl piece
+   return *this;  // allow for cascaded assignments
+}
+
+Person &Person::operator=(Person &&p) noexcept
+{
+   *Impl() = std::move(*p.Impl());   // call move op= on impl piece
+   return *this;
+}
@@ -18,6 +18,7 @@ public:
     Person();   // default constructor
     Person(const string &, const string &, char, const string &);  
     Person(const Person &);  // copy constructor
+    Person(Person &&) noexcept;  // move constructor -- takes over the PersonImpl; the moved-from Person may only be assigned to or destroyed
     virtual ~Person();  // virtual destructor
     const string &GetFirstName() const; // { return firstName; }  
     const string &GetLastName() const; // { return lastName; }    
@@ -27,6 +28,7 @@ public:
     virtual void IsA() const;  
     virtual void Greeting(const string &) const;
     Person &operator=(const Person &);  // overloaded assignment operator prototype
+    Person &operator=(Person &&) noexcept;  // move assignment
 };
 
 #endif
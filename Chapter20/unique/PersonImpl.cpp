@@ -22,8 +22,8 @@ private:
 public:
     PersonImpl() = default;   // default constructor
     PersonImpl(const string &, const string &, char, const string &);  
-    // NOt necessary to prototype default copy constructor
-    // PersonImpl(const PersonImpl &) = default;  // copy constructor
+    // Since we write operator= below, the implicit copy constructor is deprecated; so ask for the default explicitly
+    PersonImpl(const PersonImpl &) = default;  // copy constructor
     virtual ~PersonImpl() = default;  // virtual destructor
 
     const string &GetFirstName() const { return firstName; }  
@@ -116,13 +116,17 @@ Person::Person(const string &fn, const string &ln, char mi, const string &t) : p
 }
 
 // copy constructor -- in member init list, call PersonImpl copy constructor with new nested object creation
-Person::Person(const Person &p): pImpl(new PersonImpl(*(p.pImpl)))
+Person::Person(const Person &p): pImpl(p.pImpl ? new PersonImpl(*(p.pImpl)) : nullptr)   // a moved-from p has no PersonImpl
 {
     // No Person data members to copy from pers except deep copy in *(p.pImpl)
     // line below is an alternative to initialization in member initialization list
     // pImpl = new PersonImpl(*(p.pImpl));  // call PersonImpl copy constructor with new nested object creation
 }
 
+// move constructor -- the unique pointer is moved, so no PersonImpl is allocated or copied
+// (defined here, rather than defaulted in Person.h, as PersonImpl must be a complete type)
+Person::Person(Person &&) noexcept = default;
+
 // Note: Person destructor no longer needs to delete pImpl member
 // and hence this simply can be the default destructor! Prototyped with virtual, but set with =default in implementation file
 Person::~Person() = default;   // delete on pImpl no longer required
@@ -171,8 +175,15 @@ Person &Person::operator=(const Person &p)
 {
    // no data members, other than pImpl, in Person to do a deep assignment
    // note: p.pImpl is a pointer; must dereference with * to get a referencable object
-   pImpl->operator=(*(p.pImpl));   // call op= on impl piece
+   if (!p.pImpl)
+      pImpl.reset();   // p was moved from; so, in effect, is this Person now
+   else if (pImpl)
+      pImpl->operator=(*(p.pImpl));   // call op= on impl piece
+   else
+      pImpl.reset(new PersonImpl(*(p.pImpl)));   // this Person was moved from; give it a PersonImpl again
    return *this;  // allow for cascaded assignments
 }
 
+Person &Person::operator=(Person &&) noexcept = default;   // move assignment: move the unique pointer
+
 
@@ -0,0 +1,359 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate a bounds-safe vector: checked in debug and sanitizer builds, plain indexing in release builds
+// Chp21-Ex4.cpp uses vector<Student> with auto iterators for safety -- yet vector's operator[] does not check its
+// index (only at() does), and nothing detects use of an iterator invalidated by push_back(), erase(), and the like.
+// CheckedVector<T> has vector's interface (in part); when CHECKED_VECTOR is 1, operator[], front(), back() and
+// pop_back() check bounds (throwing out_of_range), and each iterator carries the container's generation -- a count
+// bumped by every operation that may invalidate iterators -- so that using a stale iterator throws logic_error.
+// When CHECKED_VECTOR is 0, each operation is an inline call of the vector's own, and iterator is vector's iterator:
+// the compiled code is that of vector<T> (compare, e.g., the loops in g++ -O2 -DNDEBUG -S output).
+// CHECKED_VECTOR defaults to 1 unless NDEBUG is defined, and to 1 in AddressSanitizer and ThreadSanitizer builds.
+// Compile with: g++ -std=c++17 -O2 -DNDEBUG Chp21-Ex10.cpp   (release: unchecked)
+//               g++ -std=c++17 -O2 Chp21-Ex10.cpp            (checked; or add -fsanitize=address)
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <iterator>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+using std::cout;   // preferred to: using namespace std;
+using std::endl;
+using std::setprecision;
+using std::string;
+using std::to_string;
+using std::vector;
+
+#ifndef CHECKED_VECTOR
+#  if !defined(NDEBUG) || defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#    define CHECKED_VECTOR 1
+#  elif defined(__has_feature)
+#    if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+#      define CHECKED_VECTOR 1
+#    endif
+#  endif
+#  ifndef CHECKED_VECTOR
+#    define CHECKED_VECTOR 0
+#  endif
+#endif
+
+template <class T>
+class CheckedVector
+{
+private:
+    vector<T> elements;
+#if CHECKED_VECTOR
+    unsigned long generation = 0;
+    void Invalidate() { generation++; }
+    void CheckIndex(size_t i) const
+    {
+        if (i >= elements.size())
+            throw std::out_of_range("CheckedVector: index " + to_string(i) + " with size " + to_string(elements.size()));
+    }
+    void InvalidateIfFull() { if (elements.size() == elements.capacity()) Invalidate(); }   // the next insertion reallocates
+
+    template <class Owner, class Element>
+    class Iterator
+    {
+    private:
+        Owner *owner = nullptr;
+        size_t index = 0;
+        unsigned long generation = 0;
+        friend class CheckedVector;
+        template <class, class> friend class Iterator;
+        Iterator(Owner *o, size_t i) : owner(o), index(i), generation(o->generation) { }
+        void Check() const
+        {
+            if (owner == nullptr || generation != owner->generation)
+                throw std::logic_error("CheckedVector: use of an invalidated iterator");
+        }
+        void CheckDereference(ptrdiff_t n = 0) const
+        {
+            Check();
+            owner->CheckIndex(index + n);
+        }
+        void CheckSameOwner(const Iterator &iter) const
+        {
+            Check();
+            iter.Check();
+            if (owner != iter.owner)
+                throw std::logic_error("CheckedVector: comparing iterators of different containers");
+        }
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = ptrdiff_t;
+        using pointer = Element *;
+        using reference = Element &;
+        Iterator() = default;
+        template <class O, class E>   // iterator converts to const_iterator
+        Iterator(const Iterator<O, E> &iter) : owner(iter.owner), index(iter.index), generation(iter.generation) { }
+        reference operator*() const { CheckDereference(); return owner->elements[index]; }
+        pointer operator->() const { CheckDereference(); return &owner->elements[index]; }
+        reference operator[](difference_type n) const { CheckDereference(n); return owner->elements[index + n]; }
+        Iterator &operator++() { Check(); ++index; return *this; }
+        Iterator operator++(int) { Iterator old = *this; ++*this; return old; }
+        Iterator &operator--() { Check(); --index; return *this; }
+        Iterator operator--(int) { Iterator old = *this; --*this; return old; }
+        Iterator &operator+=(difference_type n) { Check(); index += n; return *this; }
+        Iterator &operator-=(difference_type n) { Check(); index -= n; return *this; }
+        Iterator operator+(difference_type n) const { Iterator i = *this; return i += n; }
+        Iterator operator-(difference_type n) const { Iterator i = *this; return i -= n; }
+        friend Iterator operator+(difference_type n, const Iterator &iter) { return iter + n; }
+        difference_type operator-(const Iterator &iter) const { CheckSameOwner(iter); return index - iter.index; }
+        bool operator==(const Iterator &iter) const { CheckSameOwner(iter); return index == iter.index; }
+        bool operator!=(const Iterator &iter) const { return !(*this == iter); }
+        bool operator<(const Iterator &iter) const { CheckSameOwner(iter); return index < iter.index; }
+        bool operator>(const Iterator &iter) const { return iter < *this; }
+        bool operator<=(const Iterator &iter) const { return !(iter < *this); }
+        bool operator>=(const Iterator &iter) const { return !(*this < iter); }
+    };
+public:
+    using iterator = Iterator<CheckedVector, T>;
+    using const_iterator = Iterator<const CheckedVector, const T>;
+#else
+public:
+    using iterator = typename vector<T>::iterator;
+    using const_iterator = typename vector<T>::const_iterator;
+#endif
+    using value_type = T;
+    using size_type = size_t;
+
+    CheckedVector() = default;
+    CheckedVector(std::initializer_list<T> init) : elements(init) { }
+    explicit CheckedVector(size_t n, const T &value = T()) : elements(n, value) { }
+    CheckedVector(const CheckedVector &) = default;
+    CheckedVector(CheckedVector &&) = default;
+#if CHECKED_VECTOR
+    // Assignment replaces the elements: iterators to both sides are invalidated (a moved-from vector is emptied)
+    CheckedVector &operator=(const CheckedVector &v) { elements = v.elements; Invalidate(); return *this; }
+    CheckedVector &operator=(CheckedVector &&v) { elements = std::move(v.elements); Invalidate(); v.Invalidate(); return *this; }
+#else
+    CheckedVector &operator=(const CheckedVector &) = default;
+    CheckedVector &operator=(CheckedVector &&) = default;
+#endif
+
+    size_t size() const { return elements.size(); }
+    size_t capacity() const { return elements.capacity(); }
+    bool empty() const { return elements.empty(); }
+    T *data() { return elements.data(); }
+    const T *data() const { return elements.data(); }
+    T &at(size_t i) { return elements.at(i); }   // checked in every build, as for vector
+    const T &at(size_t i) const { return elements.at(i); }
+
+#if CHECKED_VECTOR
+    T &operator[](size_t i) { CheckIndex(i); return elements[i]; }
+    const T &operator[](size_t i) const { CheckIndex(i); return elements[i]; }
+    T &front() { CheckIndex(0); return elements.front(); }
+    const T &front() const { CheckIndex(0); return elements.front(); }
+    T &back() { CheckIndex(0); return elements.back(); }
+    const T &back() const { CheckIndex(0); return elements.back(); }
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, elements.size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, elements.size()); }
+    void reserve(size_t n) { if (n > elements.capacity()) Invalidate(); elements.reserve(n); }
+    // An insertion at the end invalidates end(), and every iterator if it reallocates. For simplicity, we invalidate
+    // every iterator in both cases: a loop which appends while iterating should re-obtain its iterators anyway.
+    void push_back(const T &value) { InvalidateIfFull(); elements.push_back(value); Invalidate(); }
+    void push_back(T &&value) { InvalidateIfFull(); elements.push_back(std::move(value)); Invalidate(); }
+    template <class... Args>
+    T &emplace_back(Args &&...args) { elements.emplace_back(std::forward<Args>(args)...); Invalidate(); return elements.back(); }
+    void pop_back() { CheckIndex(0); elements.pop_back(); Invalidate(); }
+    void clear() { elements.clear(); Invalidate(); }
+    void resize(size_t n) { elements.resize(n); Invalidate(); }
+    iterator erase(const_iterator pos)
+    {
+        pos.CheckDereference();
+        if (pos.owner != this)
+            throw std::logic_error("CheckedVector: erase() with another container's iterator");
+        elements.erase(elements.begin() + pos.index);
+        Invalidate();
+        return iterator(this, pos.index);   // the element after the one erased, under the new generation
+    }
+#else
+    T &operator[](size_t i) { return elements[i]; }
+    const T &operator[](size_t i) const { return elements[i]; }
+    T &front() { return elements.front(); }
+    const T &front() const { return elements.front(); }
+    T &back() { return elements.back(); }
+    const T &back() const { return elements.back(); }
+    iterator begin() { return elements.begin(); }
+    iterator end() { return elements.end(); }
+    const_iterator begin() const { return elements.begin(); }
+    const_iterator end() const { return elements.end(); }
+    void reserve(size_t n) { elements.reserve(n); }
+    void push_back(const T &value) { elements.push_back(value); }
+    void push_back(T &&value) { elements.push_back(std::move(value)); }
+    template <class... Args>
+    T &emplace_back(Args &&...args) { return elements.emplace_back(std::forward<Args>(args)...); }
+    void pop_back() { elements.pop_back(); }
+    void clear() { elements.clear(); }
+    void resize(size_t n) { elements.resize(n); }
+    iterator erase(const_iterator pos) { return elements.erase(pos); }
+#endif
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+};
+
+#if !CHECKED_VECTOR
+static_assert(sizeof(CheckedVector<int>) == sizeof(vector<int>), "an unchecked CheckedVector is just a vector");
+#endif
+
+
+// Person and Student, as in Chp21-Ex4.cpp (abbreviated)
+class Person
+{
+private:
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+protected:
+    void ModifyTitle(const string &newTitle) { title = newTitle; }
+public:
+    Person() = default;   // default constructor
+    Person(const string &fn, const string &ln, char mi, const string &t) :
+           firstName(fn), lastName(ln), middleInitial(mi), title(t) { }
+    virtual ~Person() = default;  // virtual destructor
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+    virtual void Print() const;
+};
+
+void Person::Print() const
+{
+    cout << title << " " << firstName << " ";
+    cout << middleInitial << ". " << lastName << endl;
+}
+
+class Student : public Person
+{
+private:
+    float gpa = 0.0;
+    string currentCourse;
+    string studentId;
+public:
+    Student() = default;
+    Student(const string &fn, const string &ln, char mi, const string &t, float avg, const string &course,
+            const string &id) : Person(fn, ln, mi, t), gpa(avg), currentCourse(course), studentId(id) { }
+    void EarnPhD() { ModifyTitle("Dr."); }
+    float GetGpa() const { return gpa; }
+    const string &GetCurrentCourse() const { return currentCourse; }
+    const string &GetStudentId() const { return studentId; }
+    void Print() const override;
+};
+
+void Student::Print() const
+{
+    cout << GetTitle() << " " << GetFirstName() << " ";
+    cout << GetMiddleInitial() << ". " << GetLastName();
+    cout << " with id: " << studentId << " GPA: ";
+    cout << setprecision(3) << " " << gpa;
+    cout << " Course: " << currentCourse << endl;
+}
+
+
+// Benchmark: the same loops over a batch of Students -- by index, by iterator, and with range-for -- on a
+// vector<Student> and a CheckedVector<Student>, in whichever mode this program was compiled
+template <class Batch>
+double SumGpas(const Batch &batch, int rounds, int style, double &sum)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        float total = 0;
+        if (style == 0)
+            for (size_t i = 0; i < batch.size(); i++)
+                total += batch[i].GetGpa();
+        else if (style == 1)
+            for (auto iter = batch.begin(); iter != batch.end(); ++iter)
+                total += iter->GetGpa();
+        else
+            for (const auto &student : batch)
+                total += student.GetGpa();
+        sum += total;
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+           (double(rounds) * batch.size());
+}
+
+void Benchmark(int batchSize, int rounds)
+{
+    vector<Student> plain;
+    CheckedVector<Student> checked;
+    plain.reserve(batchSize);
+    checked.reserve(batchSize);
+    for (int i = 0; i < batchSize; i++)
+    {
+        plain.emplace_back("Hana", "Sato", 'U', "Miss", float(2.0 + (i % 20) / 10.0), "C++", to_string(i) + "PSU");
+        checked.emplace_back("Hana", "Sato", 'U', "Miss", float(2.0 + (i % 20) / 10.0), "C++", to_string(i) + "PSU");
+    }
+    double sum = 0;
+    const char *styles[3] = { "operator[]", "iterator", "range-for" };
+    cout << std::fixed << std::setprecision(3);
+    for (int style = 0; style < 3; style++)
+    {
+        double plainNs = SumGpas(plain, rounds, style, sum);
+        double checkedNs = SumGpas(checked, rounds, style, sum);
+        cout << "  " << std::left << std::setw(11) << styles[style] << std::right << " vector<Student> " << plainNs
+             << " ns/element, CheckedVector<Student> " << checkedNs << " ns/element" << endl;
+    }
+    cout.unsetf(std::ios::fixed);
+    cout << setprecision(6) << "  (checksum " << sum << ")" << endl;
+}
+
+
+int main(int argc, char *argv[])
+{
+    CheckedVector<Student> studentBody;
+
+    studentBody.push_back(Student("Hana", "Sato", 'U', "Miss", 3.8, "C++", "178PSU"));
+    studentBody.push_back(Student("Sam", "Kato", 'B', "Mr.", 3.5, "C++", "272PSU"));
+    studentBody.push_back(Student("Giselle", "LeBrun", 'R', "Ms.", 3.4, "C++", "299TU"));
+
+    for (size_t i = 0; i < studentBody.size(); i++)
+        studentBody[i].Print();
+
+    cout << "Everyone to earn a PhD" << endl;
+    for (auto iter = studentBody.begin(); iter != studentBody.end(); ++iter)
+        (*iter).EarnPhD();
+
+    for (const auto &student : studentBody)
+        student.Print();
+
+#if CHECKED_VECTOR
+    cout << "Checked build: errors are detected" << endl;
+    try
+    {
+        studentBody[3].Print();   // one past the end
+    }
+    catch (const std::out_of_range &e)
+    {
+        cout << "  " << e.what() << endl;
+    }
+    try
+    {
+        auto first = studentBody.begin();
+        studentBody.push_back(Student("Ling", "Mau", 'I', "Ms.", 3.9, "C++", "123TU"));   // may reallocate
+        first->Print();
+    }
+    catch (const std::logic_error &e)
+    {
+        cout << "  " << e.what() << endl;
+    }
+#else
+    cout << "Release build: CheckedVector does no checks" << endl;
+#endif
+
+    int batchSize = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 200;
+    cout << endl << "Benchmark: " << rounds << " passes over " << batchSize << " Students" << endl;
+    Benchmark(batchSize, rounds);
+    return 0;
+}
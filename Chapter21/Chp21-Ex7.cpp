@@ -0,0 +1,402 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate intrusive reference counting, as an alternative to shared_ptr and weak_ptr (Chp21-Ex2.cpp, Chp21-Ex3.cpp)
+// A shared_ptr is two pointers -- to the Person, and to a separate control block holding the use and weak counts
+// (make_shared allocates both together). Every copy atomically increments the use count; every destruction atomically
+// decrements it. Here, a Person mixes in its own count (RefCounted), so an IntrusivePtr is a single pointer. The count
+// may be atomic (for Persons shared across threads) or not (for Persons used by one thread, with no atomic operations
+// at all). Weak references are uncommon, so rather than every object paying for a weak count, a side table holds a small
+// record for each object that actually has weak references; one bit of the object's count says to consult it.
+// Compile with: g++ -std=c++17 -O2 -pthread Chp21-Ex7.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+using std::cout;   // preferred to: using namespace std;
+using std::endl;
+using std::string;
+using std::vector;
+using std::shared_ptr;
+using std::atomic;
+using std::mutex;
+using std::lock_guard;
+
+// Count the bytes requested from the heap, so that the benchmark can report the footprint of each Person
+namespace
+{
+    atomic<size_t> heapBytes(0);
+}
+
+void *operator new(std::size_t size)
+{
+    heapBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void *p = std::malloc(size > 0 ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+
+class Person
+{
+private:
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+public:
+    Person() = default;   // default constructor
+    Person(const string &fn, const string &ln, char mi, const string &t) :
+           firstName(fn), lastName(ln), middleInitial(mi), title(t) { }
+    virtual ~Person() = default;  // virtual destructor
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+    void ModifyTitle(const string &newTitle) { title = newTitle; }
+    void Print() const { cout << title << " " << firstName << " " << lastName << endl; }
+};
+
+
+// Counting policies: the same operations on a plain or an atomic count
+class NonAtomicCount
+{
+private:
+    unsigned count;
+public:
+    explicit NonAtomicCount(unsigned n) : count(n) { }
+    unsigned Load() const { return count; }
+    unsigned FetchAdd(unsigned n) { unsigned old = count; count += n; return old; }
+    unsigned FetchSub(unsigned n) { unsigned old = count; count -= n; return old; }
+    unsigned FetchOr(unsigned bits) { unsigned old = count; count |= bits; return old; }
+    bool CompareExchange(unsigned &expected, unsigned desired)
+    {
+        if (count != expected) { expected = count; return false; }
+        count = desired;
+        return true;
+    }
+};
+
+class AtomicCount
+{
+private:
+    atomic<unsigned> count;
+public:
+    explicit AtomicCount(unsigned n) : count(n) { }
+    unsigned Load() const { return count.load(std::memory_order_relaxed); }
+    // A new reference is always made from an existing one, so an increment needs no ordering (as for shared_ptr)
+    unsigned FetchAdd(unsigned n) { return count.fetch_add(n, std::memory_order_relaxed); }
+    // A decrement must order this thread's uses of the object before another thread's deletion of it
+    unsigned FetchSub(unsigned n) { return count.fetch_sub(n, std::memory_order_acq_rel); }
+    unsigned FetchOr(unsigned bits) { return count.fetch_or(bits, std::memory_order_relaxed); }
+    bool CompareExchange(unsigned &expected, unsigned desired)
+    {
+        return count.compare_exchange_weak(expected, desired, std::memory_order_relaxed);
+    }
+};
+
+
+// The weak reference side table. An object's record is made when its first weak reference is made, and is marked
+// expired (and removed from the table) when the object is destroyed; the record itself lasts until the last weak
+// reference to it is gone. One mutex guards the table and all the records -- weak references are the rare case.
+struct WeakRecord
+{
+    void *object = nullptr;   // nullptr once the object is destroyed
+    long weakCount = 0;
+};
+
+class WeakTable
+{
+private:
+    static mutex &Lock() { static mutex lock; return lock; }   // constructed on first use
+    static std::unordered_map<const void *, WeakRecord *> &Records()
+    {
+        static std::unordered_map<const void *, WeakRecord *> records;
+        return records;
+    }
+public:
+    static WeakRecord *Acquire(void *object);              // find or make object's record, adding a weak reference
+    static WeakRecord *Acquire(WeakRecord *record);        // add a weak reference to an existing record
+    static void Release(WeakRecord *record);               // the record is deleted with its last weak reference
+    static void Expire(const void *object);                // object is being destroyed: no further lock() may succeed
+    template <class Function> static auto Locked(Function f) { lock_guard<mutex> guard(Lock()); return f(); }
+    static size_t Size() { lock_guard<mutex> guard(Lock()); return Records().size(); }
+};
+
+WeakRecord *WeakTable::Acquire(void *object)
+{
+    lock_guard<mutex> guard(Lock());
+    WeakRecord *&record = Records()[object];
+    if (record == nullptr)
+    {
+        record = new WeakRecord;
+        record->object = object;
+    }
+    record->weakCount++;
+    return record;
+}
+
+WeakRecord *WeakTable::Acquire(WeakRecord *record)
+{
+    lock_guard<mutex> guard(Lock());
+    record->weakCount++;
+    return record;
+}
+
+void WeakTable::Release(WeakRecord *record)
+{
+    lock_guard<mutex> guard(Lock());
+    if (--record->weakCount == 0)
+    {
+        if (record->object != nullptr)
+            Records().erase(record->object);
+        delete record;
+    }
+}
+
+void WeakTable::Expire(const void *object)
+{
+    lock_guard<mutex> guard(Lock());
+    auto iter = Records().find(object);
+    if (iter != Records().end())
+    {
+        iter->second->object = nullptr;
+        Records().erase(iter);
+    }
+}
+
+
+// The mix-in: Derived is the class mixing in its own count (CRTP), Count is NonAtomicCount or AtomicCount.
+// The high bit of the count records that the object may have weak references (so that destruction consults the table).
+template <class Derived, class Count = AtomicCount>
+class RefCounted
+{
+private:
+    static constexpr unsigned HAS_WEAK = 1u << 31;
+    static constexpr unsigned COUNT_MASK = HAS_WEAK - 1;
+    mutable Count refCount{0};
+    template <class T> friend class IntrusivePtr;
+    template <class T> friend class IntrusiveWeakPtr;
+    void AddRef() const { refCount.FetchAdd(1); }
+    void Release() const
+    {
+        unsigned old = refCount.FetchSub(1);
+        if ((old & COUNT_MASK) == 1)   // that was the last reference
+        {
+            if (old & HAS_WEAK)
+                WeakTable::Expire(this);
+            delete static_cast<const Derived *>(this);
+        }
+    }
+    bool TryAddRef() const   // for a weak reference's lock(): succeeds only if some strong reference remains
+    {
+        unsigned count = refCount.Load();
+        while ((count & COUNT_MASK) != 0)
+            if (refCount.CompareExchange(count, count + 1))
+                return true;
+        return false;
+    }
+    WeakRecord *MakeWeak() const
+    {
+        refCount.FetchOr(HAS_WEAK);
+        return WeakTable::Acquire(const_cast<void *>(static_cast<const void *>(this)));
+    }
+protected:
+    RefCounted() = default;
+    RefCounted(const RefCounted &) { }   // a copy starts with no references of its own
+    RefCounted &operator=(const RefCounted &) { return *this; }
+    ~RefCounted() = default;   // not virtual: Release() deletes through Derived *
+public:
+    unsigned UseCount() const { return refCount.Load() & COUNT_MASK; }
+};
+
+
+template <class T>
+class IntrusivePtr
+{
+private:
+    T *pointer = nullptr;  // in-class initialization
+    template <class U> friend class IntrusiveWeakPtr;
+    struct Adopt { };
+    IntrusivePtr(T *p, Adopt) : pointer(p) { }   // takes over a reference already counted (by TryAddRef())
+public:
+    IntrusivePtr() = default;
+    explicit IntrusivePtr(T *p) : pointer(p) { if (pointer) pointer->AddRef(); }
+    IntrusivePtr(const IntrusivePtr &ip) : pointer(ip.pointer) { if (pointer) pointer->AddRef(); }
+    IntrusivePtr(IntrusivePtr &&ip) noexcept : pointer(ip.pointer) { ip.pointer = nullptr; }
+    ~IntrusivePtr() { if (pointer) pointer->Release(); }
+    IntrusivePtr &operator=(IntrusivePtr ip) noexcept { std::swap(pointer, ip.pointer); return *this; }  // copy or move, then swap
+    T *Get() const { return pointer; }
+    T *operator->() const { return pointer; }
+    T &operator*() const { return *pointer; }
+    explicit operator bool() const { return pointer != nullptr; }
+    unsigned UseCount() const { return pointer ? pointer->UseCount() : 0; }
+};
+
+template <class T, class... Args>
+IntrusivePtr<T> MakeIntrusive(Args &&...args)
+{
+    return IntrusivePtr<T>(new T(std::forward<Args>(args)...));
+}
+
+template <class T>
+class IntrusiveWeakPtr
+{
+private:
+    WeakRecord *record = nullptr;
+public:
+    IntrusiveWeakPtr() = default;
+    IntrusiveWeakPtr(const IntrusivePtr<T> &ip) : record(ip ? ip->MakeWeak() : nullptr) { }
+    IntrusiveWeakPtr(const IntrusiveWeakPtr &wp) : record(wp.record ? WeakTable::Acquire(wp.record) : nullptr) { }
+    IntrusiveWeakPtr(IntrusiveWeakPtr &&wp) noexcept : record(wp.record) { wp.record = nullptr; }
+    ~IntrusiveWeakPtr() { if (record) WeakTable::Release(record); }
+    IntrusiveWeakPtr &operator=(IntrusiveWeakPtr wp) noexcept { std::swap(record, wp.record); return *this; }
+    // Holding the table's lock, the object cannot finish being destroyed: Expire() waits for the lock
+    IntrusivePtr<T> Lock() const
+    {
+        if (record == nullptr)
+            return IntrusivePtr<T>();
+        return WeakTable::Locked([this]() {
+            T *object = static_cast<T *>(static_cast<RefCounted<T, typename T::CountType> *>(record->object));
+            if (object == nullptr || !object->TryAddRef())
+                return IntrusivePtr<T>();
+            return IntrusivePtr<T>(object, typename IntrusivePtr<T>::Adopt());
+        });
+    }
+    bool Expired() const { return !Lock(); }
+};
+
+
+// A Person shared by reference counts of its own: atomic, to share between threads, or not (one thread only)
+template <class Count>
+class CountedPerson: public Person, public RefCounted<CountedPerson<Count>, Count>
+{
+public:
+    using CountType = Count;
+    using Person::Person;   // inherit Person's constructors
+};
+
+using SharedPerson = CountedPerson<AtomicCount>;
+using LocalPerson = CountedPerson<NonAtomicCount>;
+
+static_assert(sizeof(IntrusivePtr<SharedPerson>) * 2 == sizeof(shared_ptr<Person>), "IntrusivePtr is half a shared_ptr");
+
+
+// Benchmarks: copy, use and destroy a pointer in a tight loop, single-threaded and with several threads sharing the
+// same Person; then the heap footprint of many Persons
+template <class Function>
+double NsPerOp(long n, Function f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+}
+
+template <class Pointer>
+double CopyDestroy(const Pointer &p, long n, int numThreads)
+{
+    atomic<long> checksum(0);
+    double ns = NsPerOp(n * numThreads, [&]() {
+        vector<std::thread> threads;
+        for (int t = 0; t < numThreads; t++)
+            threads.emplace_back([&]() {
+                long sum = 0;
+                for (long i = 0; i < n; i++)
+                {
+                    Pointer copy(p);
+                    sum += copy->GetMiddleInitial();
+                }
+                checksum += sum;
+            });
+        for (auto &th : threads)
+            th.join();
+    });
+    if (checksum != n * numThreads * p->GetMiddleInitial())
+        cout << "(checksum mismatch)" << endl;
+    return ns * numThreads;   // per copy, per thread: the cost each thread sees
+}
+
+void Benchmark(long n, int population)
+{
+    cout << std::fixed << std::setprecision(2);
+    auto local = MakeIntrusive<LocalPerson>("Gabby", "Doone", 'A', "Miss");
+    auto shared = MakeIntrusive<SharedPerson>("Gabby", "Doone", 'A', "Miss");
+    auto made = std::make_shared<Person>("Gabby", "Doone", 'A', "Miss");
+
+    cout << "  Copy, use, destroy (1 thread):  non-atomic IntrusivePtr " << CopyDestroy(local, n, 1)
+         << " ns, atomic IntrusivePtr " << CopyDestroy(shared, n, 1) << " ns, shared_ptr " << CopyDestroy(made, n, 1) << " ns" << endl;
+    int numThreads = 4;
+    cout << "  Copy, use, destroy (" << numThreads << " threads, one Person): atomic IntrusivePtr "
+         << CopyDestroy(shared, n / numThreads, numThreads) << " ns, shared_ptr "
+         << CopyDestroy(made, n / numThreads, numThreads) << " ns" << endl;
+
+    vector<IntrusivePtr<SharedPerson>> intrusive;
+    vector<shared_ptr<Person>> sharedPtrs;
+    intrusive.reserve(population);
+    sharedPtrs.reserve(population);
+    size_t before = heapBytes;
+    for (int i = 0; i < population; i++)
+        intrusive.push_back(MakeIntrusive<SharedPerson>("Gabby", "Doone", 'A', "Miss"));
+    double intrusiveBytes = double(heapBytes - before) / population + sizeof(IntrusivePtr<SharedPerson>);
+    before = heapBytes;
+    for (int i = 0; i < population; i++)
+        sharedPtrs.push_back(std::make_shared<Person>("Gabby", "Doone", 'A', "Miss"));
+    double sharedBytes = double(heapBytes - before) / population + sizeof(shared_ptr<Person>);
+    cout << "  Footprint of " << population << " Persons, each held by one pointer: IntrusivePtr " << intrusiveBytes
+         << " bytes each (sizeof Person " << sizeof(Person) << "), make_shared " << sharedBytes << " bytes each" << endl;
+
+    vector<IntrusiveWeakPtr<SharedPerson>> watchers;
+    watchers.reserve(population / 100);
+    for (int i = 0; i < population / 100; i++)
+        watchers.emplace_back(intrusive[i]);
+    cout << "  Weak references to 1% of them: " << WeakTable::Size() << " side table records" << endl;
+    cout.unsetf(std::ios::fixed);
+    cout << std::setprecision(6);
+}
+
+
+int main(int argc, char *argv[])
+{
+    IntrusivePtr<SharedPerson> pers1 = MakeIntrusive<SharedPerson>("Gabby", "Doone", 'A', "Miss");
+    IntrusivePtr<SharedPerson> pers2 = pers1;   // pers2 refers to the same Person as pers1
+
+    pers1->Print();
+    pers2->ModifyTitle("Dr.");
+    pers1->Print();
+    cout << "Number of references: " << pers1.UseCount() << " (sizeof IntrusivePtr " << sizeof(pers1)
+         << ", shared_ptr " << sizeof(shared_ptr<Person>) << ")" << endl;
+
+    IntrusiveWeakPtr<SharedPerson> wpers1(pers1);   // the first weak reference makes the Person's side table record
+    if (IntrusivePtr<SharedPerson> pers3 = wpers1.Lock())
+        cout << "Locked; # references: " << pers3.UseCount() << endl;
+    pers1 = IntrusivePtr<SharedPerson>();
+    pers2 = IntrusivePtr<SharedPerson>();   // the last reference: the Person is deleted
+    cout << "After releasing both, the weak reference is " << (wpers1.Expired() ? "expired" : "still valid") << endl;
+
+    LocalPerson onStack("Renee", "Alexander", 'K', "Dr.");   // a copy of a RefCounted object starts with no references
+    IntrusivePtr<LocalPerson> local = MakeIntrusive<LocalPerson>(onStack);
+    local->Print();
+
+    long n = argc > 1 ? std::atol(argv[1]) : 20000000;
+    int population = argc > 2 ? std::atoi(argv[2]) : 1000000;
+    cout << endl << "Benchmark: " << n << " copies; " << population << " Persons" << endl;
+    Benchmark(n, population);
+    return 0;
+}
@@ -0,0 +1,382 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate biased (and deferred) reference counting, for Persons shared by many threads
+// Every copy or destruction of a shared_ptr (Chp21-Ex2.cpp) is an atomic read-modify-write of the use count. When
+// many threads copy the same shared_ptr, each of those operations must take the count's cache line from whichever
+// core had it last. Yet most references to an object are made by the thread that created it. So here, each object
+// has two counts: a biased count, used only by its owner (the creating thread) with ordinary, non-atomic arithmetic,
+// and an atomic shared count, used by every other thread. The object is deleted when the two together reach zero:
+// when the owner's count reaches zero, it merges the two; if other threads' releases drive the shared count below
+// zero (references the owner made were released elsewhere), the object is queued for its owner to merge (Poll()).
+// Optionally, a thread may defer its releases of others' objects (SetDeferred()): it keeps a small per-thread tally
+// of released references, reuses them for its next copies, and returns the remainder in one atomic operation per
+// object when its tally fills, when it calls Flush(), or when it exits.
+// Compile with: g++ -std=c++17 -O2 -pthread Chp21-Ex8.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <chrono>
+#include <cstdlib>
+
+using std::cout;   // preferred to: using namespace std;
+using std::endl;
+using std::string;
+using std::vector;
+using std::shared_ptr;
+using std::atomic;
+using std::mutex;
+using std::lock_guard;
+using std::thread;
+
+class Person
+{
+private:
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+public:
+    Person() = default;   // default constructor
+    Person(const string &fn, const string &ln, char mi, const string &t) :
+           firstName(fn), lastName(ln), middleInitial(mi), title(t) { }
+    virtual ~Person() = default;  // virtual destructor
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+    void ModifyTitle(const string &newTitle) { title = newTitle; }
+    void Print() const { cout << title << " " << firstName << " " << lastName << endl; }
+};
+
+
+class BiasedCounted;
+
+// Each thread which creates a BiasedCounted object has a queue, for objects it must merge. Queues are kept for the
+// life of the program (after a thread exits, its objects' merges are done by the thread which would have queued them).
+struct OwnerQueue
+{
+    mutex lock;
+    vector<BiasedCounted *> queued;
+    bool exited = false;
+};
+
+class BiasedRC
+{
+public:
+    static void SetDeferred(bool deferred) { State().deferred = deferred; }   // for this thread
+    static void Flush();   // return this thread's deferred releases
+    static void Poll();    // merge this thread's queued objects (the owner should call this now and then)
+private:
+    static constexpr size_t MAX_PENDING = 32;
+    struct ThreadState
+    {
+        OwnerQueue *queue = nullptr;
+        bool deferred = false;
+        vector<std::pair<BiasedCounted *, long>> pending;   // deferred releases, per object
+        ~ThreadState();
+    };
+    friend class BiasedCounted;
+    static ThreadState &State() { thread_local ThreadState state; return state; }
+    static OwnerQueue *Queue();
+    static void Enqueue(BiasedCounted *);
+};
+
+// The mix-in. The shared count and two flags are packed into one atomic word, so that each change to them is a single
+// atomic operation: MERGED (the biased count has been folded in) and QUEUED (the object is waiting in its owner's queue).
+// The object is deleted by whichever operation leaves the word MERGED, with a zero count, and not QUEUED.
+class BiasedCounted
+{
+private:
+    static constexpr long MERGED = 1, QUEUED = 2, ONE = 4;
+    OwnerQueue *const owner;    // the creating thread's queue, which also identifies the owner
+    long biased = 1;            // used only by the owner -- or, once it has exited, under owner->lock
+    bool ownerMerged = false;   // ditto
+    atomic<long> shared{0};     // (count * ONE) | flags; the count may be negative
+    template <class T> friend class BiasedPtr;
+    friend class BiasedRC;
+    bool OwnedHere() const { return owner == BiasedRC::Queue() && !ownerMerged; }
+    void AddRef();
+    void Release();
+    void SharedRelease(long n);
+    void Merge();
+protected:
+    BiasedCounted() : owner(BiasedRC::Queue()) { }
+    BiasedCounted(const BiasedCounted &) : BiasedCounted() { }   // a copy starts with its own references
+    BiasedCounted &operator=(const BiasedCounted &) { return *this; }
+public:
+    virtual ~BiasedCounted() = default;
+    long UseCount() const { return (ownerMerged ? 0 : biased) + (shared.load() >> 2); }   // meaningful on the owner only
+};
+
+void BiasedCounted::AddRef()
+{
+    if (OwnedHere())
+    {
+        biased++;   // the common case: no atomic operation
+        return;
+    }
+    BiasedRC::ThreadState &state = BiasedRC::State();
+    if (state.deferred)
+        for (auto iter = state.pending.rbegin(); iter != state.pending.rend(); ++iter)
+            if (iter->first == this && iter->second > 0)
+            {
+                iter->second--;   // reuse a reference released (but not yet returned) by this thread
+                return;
+            }
+    shared.fetch_add(ONE, std::memory_order_relaxed);
+}
+
+void BiasedCounted::Release()
+{
+    if (OwnedHere())
+    {
+        if (--biased > 0)
+            return;
+        ownerMerged = true;   // the owner holds no more references: fold its (zero) count in, and count atomically from now on
+        long old = shared.load(std::memory_order_relaxed);
+        while (!shared.compare_exchange_weak(old, old | MERGED, std::memory_order_acq_rel))
+            ;
+        if ((old | MERGED) == MERGED)
+            delete this;
+        return;
+    }
+    BiasedRC::ThreadState &state = BiasedRC::State();
+    if (state.deferred)
+    {
+        for (auto iter = state.pending.rbegin(); iter != state.pending.rend(); ++iter)
+            if (iter->first == this)
+            {
+                iter->second++;
+                return;
+            }
+        state.pending.emplace_back(this, 1);
+        if (state.pending.size() > BiasedRC::MAX_PENDING)
+            BiasedRC::Flush();
+        return;
+    }
+    SharedRelease(1);
+}
+
+// A non-owner's n releases. If they take the shared count below zero (and the object is not yet merged or queued),
+// the owner's references must have been passed to other threads and released there: queue the object for a merge.
+void BiasedCounted::SharedRelease(long n)
+{
+    long old = shared.load(std::memory_order_relaxed), updated = 0;
+    bool enqueue = false;
+    do
+    {
+        updated = old - n * ONE;
+        enqueue = !(old & (MERGED | QUEUED)) && updated < 0;
+        if (enqueue)
+            updated |= QUEUED;
+    } while (!shared.compare_exchange_weak(old, updated, std::memory_order_acq_rel));
+    if (enqueue)
+        BiasedRC::Enqueue(this);
+    else if (updated == MERGED)
+        delete this;
+}
+
+// Fold the biased count into the shared count, and take the object out of the queue. Called by the owner from Poll(),
+// or under owner->lock once the owner has exited.
+void BiasedCounted::Merge()
+{
+    long old = shared.load(std::memory_order_relaxed), updated = 0;
+    do
+    {
+        updated = old & ~QUEUED;
+        if (!(old & MERGED))
+            updated = (updated + (ownerMerged ? 0 : biased) * ONE) | MERGED;
+    } while (!shared.compare_exchange_weak(old, updated, std::memory_order_acq_rel));
+    ownerMerged = true;
+    if (updated == MERGED)
+        delete this;
+}
+
+OwnerQueue *BiasedRC::Queue()
+{
+    ThreadState &state = State();
+    if (state.queue == nullptr)
+    {
+        static mutex lock;
+        static std::deque<OwnerQueue> queues;   // a deque never moves its elements
+        lock_guard<mutex> guard(lock);
+        state.queue = &queues.emplace_back();
+    }
+    return state.queue;
+}
+
+void BiasedRC::Enqueue(BiasedCounted *object)
+{
+    lock_guard<mutex> guard(object->owner->lock);
+    if (object->owner->exited)
+        object->Merge();   // no owner to do it
+    else
+        object->owner->queued.push_back(object);
+}
+
+void BiasedRC::Poll()
+{
+    OwnerQueue *queue = Queue();
+    vector<BiasedCounted *> queued;
+    {
+        lock_guard<mutex> guard(queue->lock);
+        queued.swap(queue->queued);
+    }
+    for (BiasedCounted *object : queued)
+        object->Merge();
+}
+
+void BiasedRC::Flush()
+{
+    vector<std::pair<BiasedCounted *, long>> pending;
+    pending.swap(State().pending);
+    for (auto &p : pending)
+        if (p.second > 0)
+            p.first->SharedRelease(p.second);
+}
+
+BiasedRC::ThreadState::~ThreadState()   // the thread is exiting
+{
+    Flush();
+    if (queue != nullptr)
+    {
+        lock_guard<mutex> guard(queue->lock);
+        for (BiasedCounted *object : queue->queued)
+            object->Merge();
+        queue->queued.clear();
+        queue->exited = true;
+    }
+}
+
+
+template <class T>
+class BiasedPtr
+{
+private:
+    T *pointer = nullptr;  // in-class initialization
+    template <class U, class... Args> friend BiasedPtr<U> MakeBiased(Args &&...);
+    explicit BiasedPtr(T *p) : pointer(p) { }   // adopts the creator's reference (the initial biased count of 1)
+public:
+    BiasedPtr() = default;
+    BiasedPtr(const BiasedPtr &bp) : pointer(bp.pointer) { if (pointer) pointer->AddRef(); }
+    BiasedPtr(BiasedPtr &&bp) noexcept : pointer(bp.pointer) { bp.pointer = nullptr; }
+    ~BiasedPtr() { if (pointer) pointer->Release(); }
+    BiasedPtr &operator=(BiasedPtr bp) noexcept { std::swap(pointer, bp.pointer); return *this; }   // copy or move, then swap
+    T *Get() const { return pointer; }
+    T *operator->() const { return pointer; }
+    T &operator*() const { return *pointer; }
+    explicit operator bool() const { return pointer != nullptr; }
+};
+
+// Objects are made only this way, so that the creating thread -- the owner -- holds the first reference
+template <class T, class... Args>
+BiasedPtr<T> MakeBiased(Args &&...args)
+{
+    return BiasedPtr<T>(new T(std::forward<Args>(args)...));
+}
+
+atomic<long> liveBiasedPersons(0);
+
+class BiasedPerson: public Person, public BiasedCounted
+{
+public:
+    BiasedPerson(const string &fn, const string &ln, char mi, const string &t) : Person(fn, ln, mi, t) { liveBiasedPersons++; }
+    ~BiasedPerson() override { liveBiasedPersons--; }
+};
+
+
+// Benchmarks: numThreads threads each copy (and destroy) a pointer to the same Person, made by the main thread
+template <class Pointer>
+double CopiesPerSecond(const Pointer &hot, int numThreads, long copiesPerThread, bool deferred)
+{
+    atomic<long> checksum(0);
+    vector<thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < numThreads; t++)
+        threads.emplace_back([&]() {
+            BiasedRC::SetDeferred(deferred);
+            long sum = 0;
+            for (long i = 0; i < copiesPerThread; i++)
+            {
+                Pointer copy(hot);
+                sum += copy->GetMiddleInitial();
+            }
+            BiasedRC::Flush();
+            checksum += sum;
+        });
+    for (auto &th : threads)
+        th.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (checksum != numThreads * copiesPerThread * hot->GetMiddleInitial())
+        cout << "(checksum mismatch)" << endl;
+    return numThreads * copiesPerThread / seconds / 1e6;
+}
+
+void Benchmark(long totalCopies)
+{
+    cout << std::fixed << std::setprecision(1);
+    {
+        auto biased = MakeBiased<BiasedPerson>("Gabby", "Doone", 'A', "Miss");
+        auto made = std::make_shared<Person>("Gabby", "Doone", 'A', "Miss");
+        long sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (long i = 0; i < totalCopies; i++) { BiasedPtr<BiasedPerson> copy(biased); sum += copy->GetMiddleInitial(); }
+        double biasedRate = totalCopies / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / 1e6;
+        start = std::chrono::steady_clock::now();
+        for (long i = 0; i < totalCopies; i++) { shared_ptr<Person> copy(made); sum += copy->GetMiddleInitial(); }
+        double sharedRate = totalCopies / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / 1e6;
+        cout << "  Owner thread copying its own Person: BiasedPtr " << biasedRate << ", shared_ptr " << sharedRate
+             << " M copies/sec" << (sum == 0 ? " " : "") << endl;
+
+        cout << "  Many threads copying one Person (M copies/sec, all threads together):" << endl;
+        cout << "    threads    shared_ptr     BiasedPtr   BiasedPtr, deferred" << endl;
+        for (int numThreads : { 1, 2, 4, 8, 16, 32, 64 })
+        {
+            long perThread = totalCopies / numThreads;
+            cout << "    " << std::setw(7) << numThreads
+                 << std::setw(14) << CopiesPerSecond(made, numThreads, perThread, false)
+                 << std::setw(14) << CopiesPerSecond(biased, numThreads, perThread, false)
+                 << std::setw(22) << CopiesPerSecond(biased, numThreads, perThread, true) << endl;
+        }
+    }
+    cout.unsetf(std::ios::fixed);
+    cout << std::setprecision(6);
+    BiasedRC::Poll();
+    cout << "  BiasedPersons still alive: " << liveBiasedPersons << endl;
+}
+
+
+int main(int argc, char *argv[])
+{
+    BiasedPtr<BiasedPerson> pers1 = MakeBiased<BiasedPerson>("Gabby", "Doone", 'A', "Miss");
+    BiasedPtr<BiasedPerson> pers2 = pers1;   // the owner's copy: a non-atomic increment
+    pers1->Print();
+    pers2->ModifyTitle("Dr.");
+    pers1->Print();
+    cout << "Number of references: " << pers1->UseCount() << endl;
+
+    // Hand the owner's references to other threads, which release them: the shared count goes negative, and the
+    // Person is queued for the owner to merge the two counts -- after which it is deleted once all are released
+    vector<BiasedPtr<BiasedPerson>> handOff(4, pers1);
+    pers1 = BiasedPtr<BiasedPerson>();
+    pers2 = BiasedPtr<BiasedPerson>();
+    vector<thread> threads;
+    for (auto &p : handOff)
+        threads.emplace_back([p = std::move(p)]() mutable { p = BiasedPtr<BiasedPerson>(); });
+    for (auto &th : threads)
+        th.join();
+    cout << "After the other threads release their references: " << liveBiasedPersons << " BiasedPerson alive; ";
+    BiasedRC::Poll();
+    cout << "after the owner polls: " << liveBiasedPersons << endl;
+
+    long totalCopies = argc > 1 ? std::atol(argv[1]) : 20000000;
+    cout << endl << "Benchmark: " << totalCopies << " copies at each thread count" << endl;
+    Benchmark(totalCopies);
+    return liveBiasedPersons == 0 ? 0 : 1;
+}
@@ -0,0 +1,367 @@
+// (c) Dorothy R. Kirk. All Rights Reserved.
+// Purpose: To illustrate epoch-based reclamation, for a directory of Persons read by many threads and updated by few
+// In Chp21-Ex3.cpp, a reader reaches a Person (which might be deleted meanwhile) through weak_ptr::lock(): an atomic
+// read-modify-write to take a reference, and another to drop it -- on a count shared with every other reader of that
+// Person. Here, a reader instead announces that it is reading (Epochs::Guard): one store to its own slot, and a fence.
+// Within the Guard, it reads plain Person *'s. A writer never deletes a Person a reader may still hold; it replaces it
+// in the directory and retires it. Retired Persons are deleted once every reader has moved past the epoch in which they
+// were retired (the global epoch advances only when all active readers have seen the current one, so after two
+// advances no reader can still hold a pointer it read before the Person was retired).
+// Compile with: g++ -std=c++17 -O2 -pthread Chp21-Ex9.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+
+using std::cout;   // preferred to: using namespace std;
+using std::endl;
+using std::string;
+using std::to_string;
+using std::vector;
+using std::shared_ptr;
+using std::weak_ptr;
+using std::atomic;
+using std::mutex;
+using std::lock_guard;
+using std::thread;
+
+atomic<long> livePersons(0);   // so that the program can check that every retired Person is deleted (once)
+
+class Person
+{
+private:
+    string firstName;
+    string lastName;
+    char middleInitial = '\0';  // in-class initialization -- value to be used in default constructor
+    string title;  // Mr., Ms., Mrs., Miss, Dr., etc.
+public:
+    Person() { livePersons++; }   // default constructor
+    Person(const string &fn, const string &ln, char mi, const string &t) :
+           firstName(fn), lastName(ln), middleInitial(mi), title(t) { livePersons++; }
+    Person(const Person &p) : firstName(p.firstName), lastName(p.lastName), middleInitial(p.middleInitial),
+                              title(p.title) { livePersons++; }
+    Person &operator=(const Person &) = default;
+    virtual ~Person() { livePersons--; }  // virtual destructor
+    const string &GetFirstName() const { return firstName; }
+    const string &GetLastName() const { return lastName; }
+    const string &GetTitle() const { return title; }
+    char GetMiddleInitial() const { return middleInitial; }
+    void ModifyTitle(const string &newTitle) { title = newTitle; }
+    void Print() const { cout << title << " " << firstName << " " << lastName << endl; }
+};
+
+
+// The reclamation domain. Each thread which reads or retires takes a slot (on first use; released when it exits).
+// A slot's epoch is 0 while its thread is not reading, else the global epoch its thread saw on entering its Guard.
+class Epochs
+{
+private:
+    static constexpr int MAX_THREADS = 128;
+    static constexpr size_t RETIRE_BATCH = 64;   // try to advance the epoch and reclaim after this many retirements
+    struct Retired
+    {
+        void *object;
+        void (*destroy)(void *);
+        unsigned long epoch;   // the global epoch when it was retired
+    };
+    struct alignas(64) Slot   // a cache line each, so that readers' announcements do not contend
+    {
+        atomic<unsigned long> epoch{0};
+        atomic<bool> inUse{false};
+        int nesting = 0;            // these are used only by the slot's thread
+        vector<Retired> retired;
+    };
+    struct ThreadSlot   // this thread's slot; released when the thread exits
+    {
+        Slot *slot = nullptr;
+        ~ThreadSlot();
+    };
+    static atomic<unsigned long> globalEpoch;
+    static Slot slots[MAX_THREADS];
+    static mutex orphanLock;
+    static vector<Retired> orphans;   // retired by threads which have since exited
+    static Slot &MySlot();
+    static bool TryAdvance();
+    static void Reclaim(vector<Retired> &, unsigned long epoch);
+public:
+    class Guard   // while a Guard exists, no Person read from the directory will be deleted
+    {
+    public:
+        Guard();
+        ~Guard();
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+    };
+    template <class T> static void Retire(T *object)   // delete object once no Guard which could have seen it remains
+    {
+        Retire(object, [](void *p) { delete static_cast<T *>(p); });
+    }
+    static void Retire(void *object, void (*destroy)(void *));
+    static void Drain();   // delete everything retired; call only when no other thread is reading or retiring
+};
+
+atomic<unsigned long> Epochs::globalEpoch(1);
+Epochs::Slot Epochs::slots[MAX_THREADS];
+mutex Epochs::orphanLock;
+vector<Epochs::Retired> Epochs::orphans;
+
+Epochs::Slot &Epochs::MySlot()
+{
+    thread_local ThreadSlot mine;
+    if (mine.slot == nullptr)
+    {
+        for (Slot &s : slots)
+            if (!s.inUse.load(std::memory_order_relaxed) && !s.inUse.exchange(true, std::memory_order_acquire))
+            {
+                mine.slot = &s;
+                return s;
+            }
+        throw std::runtime_error("Epochs: more than MAX_THREADS threads");
+    }
+    return *mine.slot;
+}
+
+Epochs::ThreadSlot::~ThreadSlot()
+{
+    if (slot == nullptr)
+        return;
+    {
+        lock_guard<mutex> guard(orphanLock);
+        orphans.insert(orphans.end(), slot->retired.begin(), slot->retired.end());
+    }
+    slot->retired.clear();
+    slot->inUse.store(false, std::memory_order_release);
+}
+
+Epochs::Guard::Guard()
+{
+    Slot &slot = MySlot();
+    if (slot.nesting++ == 0)
+    {
+        slot.epoch.store(globalEpoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);   // announce before reading any Person *
+    }
+}
+
+Epochs::Guard::~Guard()
+{
+    Slot &slot = MySlot();
+    if (--slot.nesting == 0)
+        slot.epoch.store(0, std::memory_order_release);   // all this thread's reads are done
+}
+
+// The global epoch may advance only when every thread that is reading has seen the current epoch
+bool Epochs::TryAdvance()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    unsigned long current = globalEpoch.load(std::memory_order_relaxed);
+    for (Slot &s : slots)
+    {
+        if (!s.inUse.load(std::memory_order_acquire))
+            continue;
+        unsigned long e = s.epoch.load(std::memory_order_acquire);
+        if (e != 0 && e != current)
+            return false;
+    }
+    return globalEpoch.compare_exchange_strong(current, current + 1, std::memory_order_acq_rel);
+}
+
+void Epochs::Reclaim(vector<Retired> &retired, unsigned long epoch)
+{
+    size_t kept = 0;
+    for (Retired &r : retired)
+    {
+        if (r.epoch + 2 <= epoch)
+            r.destroy(r.object);
+        else
+            retired[kept++] = r;
+    }
+    retired.resize(kept);
+}
+
+void Epochs::Retire(void *object, void (*destroy)(void *))
+{
+    Slot &slot = MySlot();
+    std::atomic_thread_fence(std::memory_order_seq_cst);   // the object's removal comes before the epoch we record
+    slot.retired.push_back({ object, destroy, globalEpoch.load(std::memory_order_relaxed) });
+    if (slot.retired.size() < RETIRE_BATCH)
+        return;
+    TryAdvance();
+    unsigned long epoch = globalEpoch.load(std::memory_order_acquire);
+    Reclaim(slot.retired, epoch);
+    lock_guard<mutex> guard(orphanLock);
+    Reclaim(orphans, epoch);
+}
+
+void Epochs::Drain()
+{
+    Slot &slot = MySlot();
+    for (Retired &r : slot.retired)
+        r.destroy(r.object);
+    slot.retired.clear();
+    lock_guard<mutex> guard(orphanLock);
+    for (Retired &r : orphans)
+        r.destroy(r.object);
+    orphans.clear();
+}
+
+
+// The directory: a fixed number of entries, each replaced (never modified in place) by a writer
+class PersonDirectory
+{
+private:
+    vector<atomic<Person *>> entries;
+    mutex writeLock;   // writers are serialized; readers never take it
+public:
+    explicit PersonDirectory(int size) : entries(size)
+    {
+        for (int i = 0; i < size; i++)
+            entries[i].store(new Person("Gabby", "Doone" + to_string(i), 'A', "Miss"), std::memory_order_relaxed);
+    }
+    ~PersonDirectory() { for (auto &e : entries) delete e.load(); }
+    PersonDirectory(const PersonDirectory &) = delete;
+    PersonDirectory &operator=(const PersonDirectory &) = delete;
+    int Size() const { return int(entries.size()); }
+    // The caller must hold an Epochs::Guard for as long as it uses the returned Person
+    const Person *Find(int id) const { return entries[id].load(std::memory_order_acquire); }
+    void ModifyTitle(int id, const string &title)
+    {
+        lock_guard<mutex> guard(writeLock);
+        Person *old = entries[id].load(std::memory_order_relaxed);
+        Person *updated = new Person(*old);
+        updated->ModifyTitle(title);
+        entries[id].store(updated, std::memory_order_release);
+        Epochs::Retire(old);   // readers may still be using old
+    }
+};
+
+// For comparison: the same directory of shared_ptrs, read and replaced with the atomic shared_ptr functions
+class SharedDirectory
+{
+private:
+    vector<shared_ptr<const Person>> entries;
+public:
+    explicit SharedDirectory(int size)
+    {
+        for (int i = 0; i < size; i++)
+            entries.push_back(std::make_shared<const Person>("Gabby", "Doone" + to_string(i), 'A', "Miss"));
+    }
+    int Size() const { return int(entries.size()); }
+    shared_ptr<const Person> Find(int id) const { return std::atomic_load(&entries[id]); }
+    void ModifyTitle(int id, const string &title)
+    {
+        auto updated = std::make_shared<Person>(*std::atomic_load(&entries[id]));
+        updated->ModifyTitle(title);
+        std::atomic_store(&entries[id], shared_ptr<const Person>(std::move(updated)));
+    }
+};
+
+
+// Benchmark: numReaders threads each look up readsPerThread random entries and read a title; optionally, one writer
+// replaces random entries for as long as the readers run. Reports millions of reads per second, all readers together.
+template <class Read, class Write>
+double ReadsPerSecond(int numReaders, long readsPerThread, int size, Read read, Write write, long *writes)
+{
+    atomic<int> readersDone(0);
+    atomic<long> checksum(0);
+    vector<thread> threads;
+    if (writes != nullptr)
+        threads.emplace_back([&]() {
+            unsigned long x = 12345;
+            long n = 0;
+            while (readersDone.load(std::memory_order_relaxed) < numReaders)
+            {
+                x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+                write(int(x % size), n++ % 2 ? "Dr." : "Ms.");
+            }
+            *writes = n;
+        });
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < numReaders; t++)
+        threads.emplace_back([&, t]() {
+            unsigned long x = 88172645463325252ul + t;
+            long sum = 0;
+            for (long i = 0; i < readsPerThread; i++)
+            {
+                x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+                sum += read(int(x % size));
+            }
+            checksum += sum;
+            readersDone++;
+        });
+    for (auto &th : threads)
+        th.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return numReaders * readsPerThread / seconds / 1e6;
+}
+
+void Benchmark(long readsPerThread, int size)
+{
+    PersonDirectory directory(size);
+    SharedDirectory shared(size);
+    vector<shared_ptr<Person>> owners;   // Chp21-Ex3.cpp's pattern: readers hold weak_ptrs, and lock() them
+    vector<weak_ptr<Person>> weak;
+    for (int i = 0; i < size; i++)
+    {
+        owners.push_back(std::make_shared<Person>("Gabby", "Doone" + to_string(i), 'A', "Miss"));
+        weak.push_back(owners.back());
+    }
+
+    auto epochRead = [&](int id) { Epochs::Guard guard; return long(directory.Find(id)->GetTitle().size()); };
+    auto sharedRead = [&](int id) { return long(shared.Find(id)->GetTitle().size()); };
+    auto weakRead = [&](int id) { shared_ptr<Person> p = weak[id].lock(); return p ? long(p->GetTitle().size()) : 0L; };
+    auto epochWrite = [&](int id, const char *t) { directory.ModifyTitle(id, t); };
+    auto sharedWrite = [&](int id, const char *t) { shared.ModifyTitle(id, t); };
+    auto noWrite = [](int, const char *) { };
+
+    cout << std::fixed << std::setprecision(1);
+    cout << "  Readers only (M reads/sec, all readers together):" << endl;
+    cout << "    readers   Epochs::Guard   atomic_load(shared_ptr)   weak_ptr::lock()" << endl;
+    for (int numReaders : { 1, 2, 4, 8, 16 })
+        cout << "    " << std::setw(7) << numReaders
+             << std::setw(16) << ReadsPerSecond(numReaders, readsPerThread, size, epochRead, noWrite, nullptr)
+             << std::setw(26) << ReadsPerSecond(numReaders, readsPerThread, size, sharedRead, noWrite, nullptr)
+             << std::setw(19) << ReadsPerSecond(numReaders, readsPerThread, size, weakRead, noWrite, nullptr) << endl;
+    cout << "  Readers with one writer replacing entries (M reads/sec; writes made meanwhile):" << endl;
+    cout << "    readers   Epochs::Guard            atomic_load(shared_ptr)" << endl;
+    for (int numReaders : { 1, 2, 4, 8, 16 })
+    {
+        long epochWrites = 0, sharedWrites = 0;
+        double epochRate = ReadsPerSecond(numReaders, readsPerThread, size, epochRead, epochWrite, &epochWrites);
+        double sharedRate = ReadsPerSecond(numReaders, readsPerThread, size, sharedRead, sharedWrite, &sharedWrites);
+        cout << "    " << std::setw(7) << numReaders << std::setw(16) << epochRate << " (" << std::setw(7) << epochWrites
+             << ")" << std::setw(15) << sharedRate << " (" << std::setw(7) << sharedWrites << ")" << endl;
+    }
+    cout.unsetf(std::ios::fixed);
+    cout << std::setprecision(6);
+}
+
+
+int main(int argc, char *argv[])
+{
+    PersonDirectory directory(4);
+    {
+        Epochs::Guard guard;   // while reading: pers1 remains valid, though a writer may replace it
+        const Person *pers1 = directory.Find(2);
+        directory.ModifyTitle(2, "Dr.");   // the old Person is retired, not deleted
+        pers1->Print();
+        directory.Find(2)->Print();
+    }
+    Epochs::Drain();
+    cout << "Persons alive after draining: " << livePersons << " (the directory's 4)" << endl;
+
+    long readsPerThread = argc > 1 ? std::atol(argv[1]) : 2000000;
+    int size = argc > 2 ? std::atoi(argv[2]) : 1000;
+    cout << endl << "Benchmark: " << readsPerThread << " reads per reader, from " << size << " Persons" << endl;
+    Benchmark(readsPerThread, size);
+    Epochs::Drain();   // the benchmark's threads have all exited, leaving what they retired to this thread
+    cout << "Persons alive after draining: " << livePersons << endl;
+    return livePersons == 4 ? 0 : 1;
+}